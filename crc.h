@@ -0,0 +1,31 @@
+#ifndef _CRC_H_
+#define _CRC_H_
+
+#include "ptypes.h"
+
+// Table-driven CRCs, one table lookup per byte so they can be updated from an ISR.
+// CRC-8: polynomial 0x07, initial value 0x00, no final XOR.
+// CRC-16-CCITT: polynomial 0x1021, initial value 0xFFFF, MSB first, no final XOR.
+// CRC-32 (IEEE 802.3): reflected polynomial 0xEDB88320, initial value 0xFFFFFFFF, final XOR 0xFFFFFFFF.
+// 1. Start with CRC8_INIT/CRC16_INIT/CRC32_INIT,
+// 2. Feed every byte through CRC8_UPDATE/CRC16_UPDATE/CRC32_UPDATE,
+// 3. The result is the CRC-8 and CRC-16 as is, and the CRC-32 after CRC32_FINAL.
+
+#define CRC8_INIT		(0x00)
+#define CRC16_INIT		(0xFFFF)
+#define CRC32_INIT		(0xFFFFFFFF)
+
+extern const UINT8	crc8_table[256];
+extern const UINT16	crc16_table[256];
+extern const UINT32	crc32_table[256];
+
+#define CRC8_UPDATE(crc, byte)	(crc8_table[((crc) ^ (byte)) & 0xFF])
+#define CRC16_UPDATE(crc, byte)	((UINT16)(((crc) << 8) ^ crc16_table[(((crc) >> 8) ^ (byte)) & 0xFF]))
+#define CRC32_UPDATE(crc, byte)	((UINT32)(((crc) >> 8) ^ crc32_table[((crc) ^ (byte)) & 0xFF]))
+#define CRC32_FINAL(crc)	((UINT32)((crc) ^ 0xFFFFFFFF))
+
+extern UINT8	CRC8_Compute(const UINT8 *buffer, UINT32 length);
+extern UINT16	CRC16_Compute(const UINT8 *buffer, UINT32 length);
+extern UINT32	CRC32_Compute(const UINT8 *buffer, UINT32 length);
+
+#endif
@@ -1,38 +1,113 @@
-#include "debug.h"
-
-UINT8	debug_buffer[DEBUG_BUFFER_LENGTH];
-UINT8	debug_buffer_initial_byte = DEBUG_BUFFER_INITIAL_BYTE;
-int	debug_buffer_index = 0;
-
-void DEBUG_ClearBuffer(UINT8 initial_byte)
-{
-	int i;
-	
-	debug_buffer_initial_byte = initial_byte;
-	
-	for(i = 0; i < DEBUG_BUFFER_LENGTH; i++)
-	{
-		debug_buffer[i] = debug_buffer_initial_byte;
-	}
-}
-
-void DEBUG_SaveToBuffer(UINT8 byte)
-{
-	debug_buffer[debug_buffer_index] = byte;
-	debug_buffer_index += 1;
-	debug_buffer_index %= DEBUG_BUFFER_LENGTH;
-}
-
-void DEBUG_ReturnBuffer(UINT8 *ordered_buffer)
-{
-	int i, j;
-	
-	j = debug_buffer_index;
-	
-	for(i = 0; i < DEBUG_BUFFER_LENGTH; i++)
-	{
-		ordered_buffer[i] = debug_buffer[j];
-		j += 1;
-		j %= DEBUG_BUFFER_LENGTH;
-	}
-}
+#include "debug.h"
+
+#ifdef LPC_DEFERRED_DECODE
+#include "interrupt.h"
+#endif
+
+DEBUG_RECORD	debug_buffer[DEBUG_BUFFER_LENGTH];
+volatile UINT16	debug_buffer_head = 0;		// Advanced by the producer only
+volatile UINT16	debug_buffer_tail = 0;		// Advanced by the consumer only
+UINT32		debug_buffer_dropped = 0;
+
+volatile UINT32	debug_clock = 0;
+
+void DEBUG_ClearBuffer(void)
+{
+	debug_buffer_tail = debug_buffer_head;
+	debug_buffer_dropped = 0;
+}
+
+void DEBUG_Trace(UINT8 event, UINT8 state, UINT16 address, UINT32 data)
+{
+	UINT16 head;
+	DEBUG_RECORD *record;
+#ifdef LPC_DEFERRED_DECODE
+	INTERRUPT_MASK interrupt_states;
+	
+	/* The bottom half traces from the main loop, keep the LCLK interrupt (the other producer) out while pushing */
+	interrupt_states = GetInterruptRegister();
+	DisableInterruptRegister(INTR_GPIO);
+#endif
+	
+	head = debug_buffer_head;
+	
+#ifdef DEBUG_SEQUENCE_TIMESTAMP
+	debug_clock += 1;
+#endif
+	
+	/* Full, keep the older records (the consumer owns them) and count the loss */
+	if((UINT16)(head - debug_buffer_tail) == DEBUG_BUFFER_LENGTH)
+	{
+		debug_buffer_dropped += 1;
+	}
+	else
+	{
+		record = &debug_buffer[head & DEBUG_BUFFER_MASK];
+		
+		record->timestamp = DEBUG_TIMESTAMP();
+		record->data = data;
+		record->address = address;
+		record->event = event;
+		record->state = state;
+		
+		/* Publish the record after it has been written */
+		debug_buffer_head = head + 1;
+	}
+	
+#ifdef LPC_DEFERRED_DECODE
+	EnableInterruptRegister(interrupt_states);
+#endif
+}
+
+UINT16 DEBUG_PeekBuffer(DEBUG_RECORD **first, UINT16 *first_count, DEBUG_RECORD **second, UINT16 *second_count)
+{
+	UINT16 tail = debug_buffer_tail;
+	UINT16 count = (UINT16)(debug_buffer_head - tail);
+	UINT16 index = tail & DEBUG_BUFFER_MASK;
+	
+	(*first) = &debug_buffer[index];
+	(*first_count) = ((index + count) > DEBUG_BUFFER_LENGTH) ? (DEBUG_BUFFER_LENGTH - index) : count;
+	
+	(*second) = &debug_buffer[0];
+	(*second_count) = count - (*first_count);
+	
+	return count;
+}
+
+void DEBUG_ReleaseBuffer(UINT16 count)
+{
+	debug_buffer_tail += count;
+}
+
+UINT16 DEBUG_ReturnBuffer(DEBUG_RECORD *ordered_buffer, UINT16 capacity)
+{
+	DEBUG_RECORD *first;
+	DEBUG_RECORD *second;
+	UINT16 first_count;
+	UINT16 second_count;
+	UINT16 i;
+	
+	DEBUG_PeekBuffer(&first, &first_count, &second, &second_count);
+	
+	if(first_count > capacity) first_count = capacity;
+	if(second_count > (capacity - first_count)) second_count = capacity - first_count;
+	
+	for(i = 0; i < first_count; i++)
+	{
+		ordered_buffer[i] = first[i];
+	}
+	
+	for(i = 0; i < second_count; i++)
+	{
+		ordered_buffer[first_count + i] = second[i];
+	}
+	
+	DEBUG_ReleaseBuffer(first_count + second_count);
+	
+	return first_count + second_count;
+}
+
+UINT32 DEBUG_Dropped(void)
+{
+	return debug_buffer_dropped;
+}
@@ -1,19 +1,101 @@
-#ifndef _DEBUG_H_
-#define _DEBUG_H_
-
-#include "ptypes.h"
-
-#define DEBUG_BUFFER_INITIAL_BYTE (0xFF)
-#define DEBUG_BUFFER_LENGTH       (100)
-
-// Circular array used to buffer debugging information.
-// 1. Initialize the buffer using DEBUG_ClearBuffer,
-// 2. Push a byte onto the buffer using DEBUG_SaveToBuffer,
-// 3. Allocate a block of memory, pass it to DEBUG_ReturnBuffer.
-// DEBUG_ReturnBuffer will write the last DEBUG_BUFFER_LENGTH bytes saved into ordered_buffer.
-
-extern void     DEBUG_ClearBuffer(UINT8 initial_byte);
-extern void     DEBUG_SaveToBuffer(UINT8 byte);
-extern void     DEBUG_ReturnBuffer(UINT8* ordered_buffer);
-
-#endif
+#ifndef _DEBUG_H_
+#define _DEBUG_H_
+
+#include "ptypes.h"
+
+#define DEBUG_BUFFER_LENGTH       (64)		// Records, must be a power of two
+#define DEBUG_BUFFER_MASK         (DEBUG_BUFFER_LENGTH - 1)
+
+// Trace levels, select one with -DDEBUG_LEVEL=n, the trace points above it expand to nothing.
+
+#define DEBUG_LEVEL_OFF           (0)
+#define DEBUG_LEVEL_MESSAGE       (1)		// Message protocol events and aborts, a few per message
+#define DEBUG_LEVEL_CYCLE         (2)		// Every I/O cycle dispatched to a device
+#define DEBUG_LEVEL_EDGE          (3)		// Every LCLK edge, for bring-up only
+
+#ifndef DEBUG_LEVEL
+#define DEBUG_LEVEL               DEBUG_LEVEL_MESSAGE
+#endif
+
+typedef enum {
+	DEBUG_EVENT_EDGE          = 0,		// state: decoder state, data: sampled GPIO value
+	DEBUG_EVENT_IO_READ       = 1,		// state: LPC_IO_READ_RESULT
+	DEBUG_EVENT_IO_WRITE      = 2,
+	DEBUG_EVENT_ABORT         = 3,		// state: decoder state the host aborted
+	DEBUG_EVENT_MSG_LENGTH    = 4,		// state: TRUE if a slot was claimed, data: length
+	DEBUG_EVENT_MSG_CHECK     = 5,		// state: TRUE if it passed, data: checksum or CRC from the host
+	DEBUG_EVENT_MSG_ACK       = 6,		// state: page, data: ACK read by the host
+	DEBUG_EVENT_MSG_COMMIT    = 7,		// state: queue depth, data: length
+	DEBUG_EVENT_REPLY_ACK     = 8,		// state: page, data: ACK written by the host
+	DEBUG_EVENT_RESET         = 9,		// state: decoder state LRESET interrupted
+	DEBUG_EVENT_IO_READ_ABORT = 10		// I/O read the host aborted after the device answered it
+} DEBUG_EVENT;
+
+// Fixed size trace record, 12 bytes, dumped as is (little endian on the target)
+
+typedef struct {
+	UINT32	timestamp;			// DEBUG_TIMESTAMP() when the record was pushed
+	UINT32	data;
+	UINT16	address;
+	UINT8	event;				// DEBUG_EVENT
+	UINT8	state;
+} DEBUG_RECORD;
+
+// Timestamps: a target may define DEBUG_TIMESTAMP as a free running timer. Otherwise they count LCLK edges at
+// DEBUG_LEVEL_EDGE (DEBUG_TICK in LPC_ISR and GPIO_LPCHandler), and below it, where counting every edge would cost
+// more than the records themselves, they number the records pushed (a gap shows the dropped ones).
+
+extern volatile UINT32	debug_clock;
+
+#ifndef DEBUG_TIMESTAMP
+#define DEBUG_TIMESTAMP()         (debug_clock)
+#if DEBUG_LEVEL >= DEBUG_LEVEL_EDGE
+#define DEBUG_TICK()              (debug_clock += 1)
+#else
+#define DEBUG_SEQUENCE_TIMESTAMP
+#endif
+#endif
+
+#ifndef DEBUG_TICK
+#define DEBUG_TICK()              ((void)0)
+#endif
+
+#if DEBUG_LEVEL > DEBUG_LEVEL_OFF
+#define DEBUG_TRACE_MESSAGE(event, state, address, data)	DEBUG_Trace((event), (UINT8)(state), (UINT16)(address), (UINT32)(data))
+#else
+#define DEBUG_TRACE_MESSAGE(event, state, address, data)
+#endif
+
+#if DEBUG_LEVEL >= DEBUG_LEVEL_CYCLE
+#define DEBUG_TRACE_CYCLE(event, state, address, data)		DEBUG_Trace((event), (UINT8)(state), (UINT16)(address), (UINT32)(data))
+#else
+#define DEBUG_TRACE_CYCLE(event, state, address, data)
+#endif
+
+#if DEBUG_LEVEL >= DEBUG_LEVEL_EDGE
+#define DEBUG_TRACE_EDGE(event, state, address, data)		DEBUG_Trace((event), (UINT8)(state), (UINT16)(address), (UINT32)(data))
+#else
+#define DEBUG_TRACE_EDGE(event, state, address, data)
+#endif
+
+// Single producer (the LCLK interrupt), single consumer (the main loop) ring of trace records. With -DLPC_DEFERRED_DECODE
+// the bottom half pushes from the main loop as well, DEBUG_Trace then masks the GPIO interrupt around every push.
+// 1. Initialize the ring using DEBUG_ClearBuffer,
+// 2. Push records with the DEBUG_TRACE_* macros of the enabled levels, records are dropped while the ring is full,
+// 3. Drain them with DEBUG_PeekBuffer, which returns the oldest records as up to two contiguous segments
+//    (the second one starts at the beginning of the ring), and DEBUG_ReleaseBuffer once they have been copied,
+//    or with DEBUG_ReturnBuffer, which copies up to capacity records in order and releases them.
+// There is one ring (and one debug_clock) per program, not per LPC_CONTEXT: the records carry no port, and two ports
+// decoding on different threads would both produce into it. Build multi-port programs (host/lpc_multi.c) with
+// -DDEBUG_LEVEL=0, or trace a single port.
+
+extern void     DEBUG_ClearBuffer(void);
+extern void     DEBUG_Trace(UINT8 event, UINT8 state, UINT16 address, UINT32 data);
+
+extern UINT16   DEBUG_PeekBuffer(DEBUG_RECORD **first, UINT16 *first_count, DEBUG_RECORD **second, UINT16 *second_count);
+extern void     DEBUG_ReleaseBuffer(UINT16 count);
+extern UINT16   DEBUG_ReturnBuffer(DEBUG_RECORD *ordered_buffer, UINT16 capacity);
+
+extern UINT32   DEBUG_Dropped(void);
+
+#endif
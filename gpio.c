@@ -1,66 +1,205 @@
-#include "lpc.h"
-#include "gpio.h"
-#include "lpc.h"
-#include "interrupt.h"
-
-#include "ptypes.h"
-
-/*************************************/
-/* ##### ##### Registers ##### ##### */
-/*************************************/
-
-#define GPIO_BASE_REGISTER	(0x20400)
-
-volatile UINT16 * const gpio_dir_register				= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x00);
-volatile UINT16 * const gpio_dir_clear_register				= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x04);
-
-volatile UINT16 * const gpio_data_register				= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x08);
-volatile UINT16 * const gpio_data_clear_register			= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x0C);
-
-volatile UINT16 * const gpio_interrupt_enable_register			= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x10);
-volatile UINT16 * const gpio_interrupt_disable_register			= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x14);
-
-volatile UINT16 * const gpio_interrupt_status_register			= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x18);
-volatile UINT16 * const gpio_interrupt_status_clear_register		= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x1C);
-
-volatile UINT16 * const gpio_interrupt_trigger_mode_register		= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x20);
-volatile UINT16 * const gpio_interrupt_trigger_mode_clear_register	= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x24);
-
-volatile UINT16 * const gpio_interrupt_active_mode_register			= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x28);
-volatile UINT16 * const gpio_interrupt_active_mode_clear_register	= (volatile UINT16 *)(GPIO_BASE_REGISTER + 0x2C);
-
-/*************************************/
-/* ##### ##### Functions ##### ##### */
-/*************************************/
-
-extern void LPC_ISR(void);
-extern void LPC_Initialize(void);
-
-void GPIO_ISR(void)
-{
-	/* ### Invoke Subroutine ### */
-	
-	LPC_ISR(); // and others...
-	
-	/* Clear the entire GPIO status register so that the interrupt is not handled again */
-	*gpio_interrupt_status_clear_register = GPIO_MASK;
-}
-
-void GPIO_Initialize(void)
-{
-	INTERRUPT_MASK interrupt_states;
-	
-	/* Disable all interrupts... */
-	interrupt_states = GetInterruptRegister();
-	DisableInterruptRegister(ALL_INTERRUPTS_32);
-	
-	/* Replace the old (bootloader) Interrupt Service Routine... */
-	((P_ISR_FUNCTION *)ISR_ENTRY_TABLE_LOCATION)[10] = GPIO_ISR;
-	
-	/* Restore previous interrupt states... */
-	EnableInterruptRegister(interrupt_states);
-	
-	/* ### Initialize Subroutines ### */
-	
-	LPC_Initialize(); // and others...
-}
+#include "lpc.h"
+#include "gpio.h"
+#include "interrupt.h"
+#include "debug.h"
+
+#include "ptypes.h"
+
+/*************************************/
+/* ##### ##### Registers ##### ##### */
+/*************************************/
+
+#ifdef LPC_EMULATOR
+
+#define GPIO_BASE_REGISTER	((volatile UINT8 *)gpio_emulated_registers)
+
+/* The bootloader ISR entry table is emulated as well */
+extern P_ISR_FUNCTION gpio_emulated_isr_table[];
+
+#undef ISR_ENTRY_TABLE_LOCATION
+#define ISR_ENTRY_TABLE_LOCATION	(gpio_emulated_isr_table)
+
+#else
+
+#define GPIO_BASE_REGISTER	(0x20400)
+
+#endif
+
+volatile UINT8 * const gpio_bank					= (volatile UINT8 *)(GPIO_BASE_REGISTER);
+
+volatile UINT16 * const gpio_dir_register				= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_DIR_OFFSET);
+volatile UINT16 * const gpio_dir_clear_register				= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_DIR_CLEAR_OFFSET);
+
+volatile UINT16 * const gpio_data_register				= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_DATA_OFFSET);
+volatile UINT16 * const gpio_data_clear_register			= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_DATA_CLEAR_OFFSET);
+
+volatile UINT16 * const gpio_interrupt_enable_register			= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_INTERRUPT_ENABLE_OFFSET);
+volatile UINT16 * const gpio_interrupt_disable_register			= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_INTERRUPT_DISABLE_OFFSET);
+
+volatile UINT16 * const gpio_interrupt_status_register			= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_INTERRUPT_STATUS_OFFSET);
+volatile UINT16 * const gpio_interrupt_status_clear_register		= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_INTERRUPT_STATUS_CLEAR_OFFSET);
+
+volatile UINT16 * const gpio_interrupt_trigger_mode_register		= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_INTERRUPT_TRIGGER_MODE_OFFSET);
+volatile UINT16 * const gpio_interrupt_trigger_mode_clear_register	= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_INTERRUPT_TRIGGER_MODE_CLEAR_OFFSET);
+
+volatile UINT16 * const gpio_interrupt_active_mode_register			= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_INTERRUPT_ACTIVE_MODE_OFFSET);
+volatile UINT16 * const gpio_interrupt_active_mode_clear_register	= (volatile UINT16 *)(GPIO_BASE_REGISTER + GPIO_INTERRUPT_ACTIVE_MODE_CLEAR_OFFSET);
+
+#ifdef GPIO_COUNT_ACCESSES
+GPIO_ACCESSES	gpio_accesses;
+#endif
+
+/*********************************/
+/* ##### ##### Ports ##### ##### */
+/*********************************/
+
+// The signals are on the pins of the pin map (LPC_PIN_* in lpc.h), on the reference board LAD0-LAD3 on GPIO 3:0,
+// LFRAME on GPIO 4, LRESET on GPIO 5, LCLK on GPIO 6
+
+const LPC_PINS	lpc_port_pins = { (volatile UINT8 *)(GPIO_BASE_REGISTER) };
+
+LPC_CONTEXT	lpc_port;
+LPC_MESSAGES	lpc_port_messages;
+
+/**************************************/
+/* ##### ##### Dispatcher ##### ##### */
+/**************************************/
+
+typedef struct {
+	GPIO_HANDLER	handler;
+	void *		context;
+	UINT8		priority;
+} GPIO_PIN_HANDLER;
+
+GPIO_DISPATCH_STATS	gpio_dispatch_stats;
+
+GPIO_PORT		gpio_dispatch_port = { (volatile UINT8 *)(GPIO_BASE_REGISTER) };
+
+GPIO_PIN_HANDLER	gpio_handlers[GPIO_PINS];
+UINT8			gpio_dispatch_order[GPIO_PINS];		// Pins with a handler, in the order GPIO_ISR serves them
+UINT16			gpio_dispatch_pins;			// Pins with a handler
+
+BOOL GPIO_SetHandler(UINT8 pin, UINT8 priority, GPIO_HANDLER handler, void *context)
+{
+	INTERRUPT_MASK interrupt_states;
+	UINT16 pins = 0;
+	UINT8 count = 0;
+	UINT8 i;
+	UINT8 j;
+	
+	if(pin >= GPIO_PINS) return FALSE;
+	
+	/* Never let GPIO_ISR see a half updated table */
+	interrupt_states = GetInterruptRegister();
+	DisableInterruptRegister(ALL_INTERRUPTS_32);
+	
+	gpio_handlers[pin].handler = handler;
+	gpio_handlers[pin].context = context;
+	gpio_handlers[pin].priority = priority;
+	
+	/* Insert the pins in priority order, a pin goes after the lower pins of the same priority */
+	for(i = 0; i < GPIO_PINS; i++)
+	{
+		if(gpio_handlers[i].handler == NULL) continue;
+		
+		for(j = count; (j > 0) && (gpio_handlers[gpio_dispatch_order[j - 1]].priority > gpio_handlers[i].priority); j--)
+		{
+			gpio_dispatch_order[j] = gpio_dispatch_order[j - 1];
+		}
+		
+		gpio_dispatch_order[j] = i;
+		pins |= (UINT16)(1 << i);
+		count += 1;
+	}
+	
+	gpio_dispatch_pins = pins;
+	
+	EnableInterruptRegister(interrupt_states);
+	
+	return TRUE;
+}
+
+/* LCLK edge of the board's port, GPIO_ISR has already checked and acknowledged its status */
+void GPIO_LPCHandler(void *context)
+{
+	DEBUG_TICK();
+	
+	LPC_HandleCycle((LPC_CONTEXT *)context);
+}
+
+/*************************************/
+/* ##### ##### Functions ##### ##### */
+/*************************************/
+
+void GPIO_ISR(void)
+{
+	UINT16 status;
+	UINT16 unclaimed;
+	UINT16 pin_mask;
+	UINT8 pin;
+	UINT8 i;
+	BOOL again = FALSE;
+	
+	while((status = (GPIO_Load(&gpio_dispatch_port, GPIO_INTERRUPT_STATUS_OFFSET) & GPIO_MASK)) != 0)
+	{
+		if(again) gpio_dispatch_stats.reentries += 1;
+		again = TRUE;
+		
+		/* Acknowledge before serving, so that an edge during a handler is pending again for the next pass */
+		GPIO_Acknowledge(&gpio_dispatch_port, status);
+		
+		for(unclaimed = status & ~gpio_dispatch_pins; unclaimed; unclaimed &= (UINT16)(unclaimed - 1))
+		{
+			gpio_dispatch_stats.lost += 1;
+		}
+		
+		status &= gpio_dispatch_pins;
+		
+		/* ### Invoke Subroutines ### */
+		
+		for(i = 0; status; i++)
+		{
+			pin = gpio_dispatch_order[i];
+			pin_mask = (UINT16)(1 << pin);
+			
+			if(status & pin_mask)
+			{
+				status &= ~pin_mask;
+				
+				gpio_handlers[pin].handler(gpio_handlers[pin].context);
+			}
+		}
+	}
+}
+
+void GPIO_Initialize(void)
+{
+	INTERRUPT_MASK interrupt_states;
+	UINT8 pin;
+	
+	/* Disable all interrupts... */
+	interrupt_states = GetInterruptRegister();
+	DisableInterruptRegister(ALL_INTERRUPTS_32);
+	
+	/* Start with an empty handler table... */
+	for(pin = 0; pin < GPIO_PINS; pin++)
+	{
+		gpio_handlers[pin].handler = NULL;
+	}
+	
+	gpio_dispatch_pins = 0;
+	gpio_dispatch_stats.reentries = 0;
+	gpio_dispatch_stats.lost = 0;
+	
+	/* Replace the old (bootloader) Interrupt Service Routine with the dispatcher... */
+	((P_ISR_FUNCTION *)ISR_ENTRY_TABLE_LOCATION)[10] = GPIO_ISR;
+	
+	/* Restore previous interrupt states... */
+	EnableInterruptRegister(interrupt_states);
+	
+	/* ### Initialize Subroutines ### */
+	
+	GPIO_SetHandler(LPC_PIN_LCLK, GPIO_PRIORITY_LPC, GPIO_LPCHandler, &lpc_port); // and others...
+	
+	LPC_Initialize(&lpc_port, &lpc_port_pins, &lpc_port_messages);
+}
@@ -1,47 +1,106 @@
-#ifndef __GPIO_H_
-#define __GPIO_H_
-
-#include "ptypes.h"
-
-#define GPIO_MASK	(0x7FFF)
-
-/****************************************/
-/* ##### ##### Binary Tools ##### ##### */
-/****************************************/
-
-#define IS_LOW(bit)	((bit) == 0)
-#define IS_HIGH(bit)	((bit) != 0)
-
-/*************************************/
-/* ##### ##### Registers ##### ##### */
-/*************************************/
-
-extern volatile UINT16 * const gpio_dir_register;
-extern volatile UINT16 * const gpio_dir_clear_register;
-
-extern volatile UINT16 * const gpio_data_register;
-extern volatile UINT16 * const gpio_data_clear_register;
-
-extern volatile UINT16 * const gpio_interrupt_enable_register;
-extern volatile UINT16 * const gpio_interrupt_disable_register;
-
-extern volatile UINT16 * const gpio_interrupt_status_register;
-extern volatile UINT16 * const gpio_interrupt_status_clear_register;
-
-extern volatile UINT16 * const gpio_interrupt_trigger_mode_register;
-extern volatile UINT16 * const gpio_interrupt_trigger_mode_clear_register;
-
-extern volatile UINT16 * const gpio_interrupt_active_mode_register;
-extern volatile UINT16 * const gpio_interrupt_active_mode_clear_register;
-
-/*************************************/
-/* ##### ##### Prototype ##### ##### */
-/*************************************/
-
-extern void GPIO_Initialize(void);
-extern void GPIO_ISR(void);
-
-extern void LPC_Initialize(void);
-extern void LPC_ISR(void);
-
-#endif
+#ifndef __GPIO_H_
+#define __GPIO_H_
+
+#include "ptypes.h"
+#include "gpio_backend.h"
+#include "lpc.h"
+
+#define GPIO_MASK	(0x7FFF)
+
+/****************************************/
+/* ##### ##### Binary Tools ##### ##### */
+/****************************************/
+
+#define IS_LOW(bit)	((bit) == 0)
+#define IS_HIGH(bit)	((bit) != 0)
+
+/*************************************/
+/* ##### ##### Registers ##### ##### */
+/*************************************/
+
+/* Register offsets and the backends the LPC core drives its pins through, see gpio_backend.h */
+
+extern volatile UINT8 * const gpio_bank;
+
+extern volatile UINT16 * const gpio_dir_register;
+extern volatile UINT16 * const gpio_dir_clear_register;
+
+extern volatile UINT16 * const gpio_data_register;
+extern volatile UINT16 * const gpio_data_clear_register;
+
+extern volatile UINT16 * const gpio_interrupt_enable_register;
+extern volatile UINT16 * const gpio_interrupt_disable_register;
+
+extern volatile UINT16 * const gpio_interrupt_status_register;
+extern volatile UINT16 * const gpio_interrupt_status_clear_register;
+
+extern volatile UINT16 * const gpio_interrupt_trigger_mode_register;
+extern volatile UINT16 * const gpio_interrupt_trigger_mode_clear_register;
+
+extern volatile UINT16 * const gpio_interrupt_active_mode_register;
+extern volatile UINT16 * const gpio_interrupt_active_mode_clear_register;
+
+#ifdef LPC_EMULATOR
+/* On the host the register bank is plain memory owned by the emulator (see host/lpc_emulator.c),
+ * registers are 16-bit wide and spaced 4 bytes apart just like on the ASIC, followed by the masked data register.
+ */
+#define GPIO_REGISTER_BANK_SIZE	(0x34)
+
+#define GPIO_MASKED_REGISTER(bank)	(*(volatile UINT32 *)((bank) + GPIO_MASKED_DATA_OFFSET))
+
+extern volatile UINT16 gpio_emulated_registers[GPIO_REGISTER_BANK_SIZE / sizeof(UINT16)];
+#endif
+
+/*************************************/
+/* ##### ##### Prototype ##### ##### */
+/*************************************/
+
+extern void GPIO_Initialize(void);
+extern void GPIO_ISR(void);
+extern void GPIO_LPCHandler(void *context);
+
+/**************************************/
+/* ##### ##### Dispatcher ##### ##### */
+/**************************************/
+
+/* ### GPIO Interrupt Dispatcher ###
+ *
+ * GPIO_ISR owns the GPIO vector and serves every pin of the bank from a table of handlers, one per pin. Each pass
+ * loads the interrupt status, acknowledges exactly the pins it found and then calls their handlers, the lowest
+ * priority value first (equal priorities in pin order). An edge that arrives while the handlers run sets its bit
+ * again and is served by the next pass, GPIO_ISR only returns once the status register reads empty.
+ *
+ * A pin with its interrupt enabled but no handler would keep the vector pending, its edges are acknowledged and counted
+ * as lost. The pin's trigger mode and interrupt enable stay with the code that registers the handler.
+ */
+
+#define GPIO_PINS		(15)
+
+#define GPIO_PRIORITY_LPC	(0)		// LCLK edges have to be answered within the clock
+#define GPIO_PRIORITY_DEFAULT	(128)
+
+typedef void (*GPIO_HANDLER)(void *context);
+
+typedef struct {
+	UINT32	reentries;	// Passes after the first, edges that arrived while the handlers ran
+	UINT32	lost;		// Edges on pins without a handler, acknowledged without being served
+} GPIO_DISPATCH_STATS;
+
+extern GPIO_DISPATCH_STATS	gpio_dispatch_stats;
+
+/* Serve the edges of pin with handler(context) from GPIO_ISR, NULL removes the handler.
+ * Returns FALSE for a pin outside the bank.
+ */
+extern BOOL GPIO_SetHandler(UINT8 pin, UINT8 priority, GPIO_HANDLER handler, void *context);
+
+/*********************************/
+/* ##### ##### Ports ##### ##### */
+/*********************************/
+
+// The LPC port of the board, set up by GPIO_Initialize, GPIO_ISR serves its LCLK pin
+
+extern const LPC_PINS	lpc_port_pins;
+extern LPC_CONTEXT	lpc_port;
+extern LPC_MESSAGES	lpc_port_messages;
+
+#endif
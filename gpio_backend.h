@@ -0,0 +1,197 @@
+#ifndef __GPIO_BACKEND_H_
+#define __GPIO_BACKEND_H_
+
+#include "ptypes.h"
+
+/*************************************/
+/* ##### ##### Registers ##### ##### */
+/*************************************/
+
+/* Offsets of the registers from the base of a bank, ports on other banks (see LPC_PINS) use the same layout */
+#define GPIO_DIR_OFFSET				(0x00)
+#define GPIO_DIR_CLEAR_OFFSET			(0x04)
+#define GPIO_DATA_OFFSET			(0x08)
+#define GPIO_DATA_CLEAR_OFFSET			(0x0C)
+#define GPIO_INTERRUPT_ENABLE_OFFSET		(0x10)
+#define GPIO_INTERRUPT_DISABLE_OFFSET		(0x14)
+#define GPIO_INTERRUPT_STATUS_OFFSET		(0x18)
+#define GPIO_INTERRUPT_STATUS_CLEAR_OFFSET	(0x1C)
+#define GPIO_INTERRUPT_TRIGGER_MODE_OFFSET	(0x20)
+#define GPIO_INTERRUPT_TRIGGER_MODE_CLEAR_OFFSET	(0x24)
+#define GPIO_INTERRUPT_ACTIVE_MODE_OFFSET	(0x28)
+#define GPIO_INTERRUPT_ACTIVE_MODE_CLEAR_OFFSET	(0x2C)
+
+/* Emulated banks only: masked data register, a 32-bit store of (pins << 16) | levels drives the pins in one access */
+#define GPIO_MASKED_DATA_OFFSET			(0x30)
+
+#define GPIO_REGISTER(bank, offset)		(*(volatile UINT16 *)((bank) + (offset)))
+
+/***********************************/
+/* ##### ##### Backend ##### ##### */
+/***********************************/
+
+/* ### GPIO Backends ###
+ *
+ * The LPC core reaches its pins only through a GPIO_PORT and the functions below, the backend is chosen at build time:
+ *
+ * - direct (default): every call is a store to the bank. GPIO_WritePins stores the pins going low to the clear register,
+ *   then the pins going high to the data (set) register, a half with no pins in it is skipped, so 0000b and 1111b are
+ *   a single store. Other values take two, between them the pins are at old & new (never the 1111b of an idle or
+ *   aborted bus): both stores are done on the falling LCLK edge, well before the host samples LAD on the rising one.
+ * - -DGPIO_SHADOW_BACKEND: the port keeps a copy of its output and direction latches. GPIO_WritePins only updates
+ *   the copy, GPIO_Flush (once per LCLK edge, see LPC_HandleCycle) stores the pins that changed, falling ones first
+ *   like the direct backend: nothing while the slave repeats a wait sync, one store when they only rise or only fall. GPIO_Drive flushes before it turns the pins
+ *   around, so they come up with the new levels, and direction stores are skipped when nothing changes.
+ * - -DGPIO_EMULATED_BACKEND (host only, -DLPC_EMULATOR): GPIO_WritePins is one store to the masked data register of
+ *   the emulated bank, the model of a part with a masked write port. The ASIC has no such register.
+ *
+ * Build with -DGPIO_COUNT_ACCESSES to count the loads and stores to the banks in gpio_accesses.
+ */
+
+#if defined(GPIO_SHADOW_BACKEND) && defined(GPIO_EMULATED_BACKEND)
+#error "Select one GPIO backend"
+#endif
+
+#if defined(GPIO_EMULATED_BACKEND) && !defined(LPC_EMULATOR)
+#error "The emulated GPIO backend needs the host emulator (LPC_EMULATOR)"
+#endif
+
+#ifdef GPIO_COUNT_ACCESSES
+typedef struct {
+	UINT32	loads;
+	UINT32	stores;
+} GPIO_ACCESSES;
+
+extern GPIO_ACCESSES	gpio_accesses;
+
+#define GPIO_COUNT(access)	(gpio_accesses.access += 1)
+#else
+#define GPIO_COUNT(access)
+#endif
+
+typedef struct {
+	volatile UINT8 *	bank;
+#ifdef GPIO_SHADOW_BACKEND
+	UINT16			output;		// Output latch as stored in the bank
+	UINT16			pending;	// Output latch once the port is flushed
+	UINT16			dir;		// Direction latch as stored in the bank
+#endif
+} GPIO_PORT;
+
+static __inline UINT16
+GPIO_Load(GPIO_PORT *port, UINT32 offset)
+{
+	GPIO_COUNT(loads);
+
+	return GPIO_REGISTER(port->bank, offset);
+}
+
+static __inline void
+GPIO_Store(GPIO_PORT *port, UINT32 offset, UINT16 value)
+{
+	GPIO_COUNT(stores);
+
+	GPIO_REGISTER(port->bank, offset) = value;
+}
+
+static __inline UINT16
+GPIO_ReadPins(GPIO_PORT *port)
+{
+	return GPIO_Load(port, GPIO_DATA_OFFSET);
+}
+
+static __inline void
+GPIO_Flush(GPIO_PORT *port)
+{
+#ifdef GPIO_SHADOW_BACKEND
+	UINT16 rising = port->pending & ~port->output;
+	UINT16 falling = port->output & ~port->pending;
+
+	if(falling) GPIO_Store(port, GPIO_DATA_CLEAR_OFFSET, falling);
+	if(rising) GPIO_Store(port, GPIO_DATA_OFFSET, rising);
+
+	port->output = port->pending;
+#else
+	(void)port;
+#endif
+}
+
+/* Clear the interrupt status of pins, the others stay pending. The emulated bank only folds the status clear register
+ * in after the ISR, so on the host the status a later load of the same ISR reads is cleared here, as the ASIC does.
+ */
+static __inline void
+GPIO_Acknowledge(GPIO_PORT *port, UINT16 pins)
+{
+	GPIO_Store(port, GPIO_INTERRUPT_STATUS_CLEAR_OFFSET, pins);
+
+#ifdef LPC_EMULATOR
+	GPIO_REGISTER(port->bank, GPIO_INTERRUPT_STATUS_OFFSET) &= ~pins;
+#endif
+}
+
+/* Drive levels on the output latch of pins, the other pins of the bank keep theirs */
+static __inline void
+GPIO_WritePins(GPIO_PORT *port, UINT16 pins, UINT16 levels)
+{
+#if defined(GPIO_SHADOW_BACKEND)
+	port->pending = (port->pending & ~pins) | (levels & pins);
+#elif defined(GPIO_EMULATED_BACKEND)
+	GPIO_COUNT(stores);
+
+	*(volatile UINT32 *)(port->bank + GPIO_MASKED_DATA_OFFSET) = ((UINT32)pins << 16) | (levels & pins);
+#else
+	UINT16 high = levels & pins;
+	UINT16 low = pins & ~levels;
+
+	if(low) GPIO_Store(port, GPIO_DATA_CLEAR_OFFSET, low);
+	if(high) GPIO_Store(port, GPIO_DATA_OFFSET, high);
+#endif
+}
+
+/* Enable the output drivers of pins */
+static __inline void
+GPIO_Drive(GPIO_PORT *port, UINT16 pins)
+{
+#ifdef GPIO_SHADOW_BACKEND
+	GPIO_Flush(port);
+
+	if(pins & ~port->dir) GPIO_Store(port, GPIO_DIR_OFFSET, pins & ~port->dir);
+
+	port->dir |= pins;
+#else
+	GPIO_Store(port, GPIO_DIR_OFFSET, pins);
+#endif
+}
+
+/* Float pins, they are inputs again */
+static __inline void
+GPIO_Release(GPIO_PORT *port, UINT16 pins)
+{
+#ifdef GPIO_SHADOW_BACKEND
+	if(pins & port->dir) GPIO_Store(port, GPIO_DIR_CLEAR_OFFSET, pins & port->dir);
+
+	port->dir &= ~pins;
+#else
+	GPIO_Store(port, GPIO_DIR_CLEAR_OFFSET, pins);
+#endif
+}
+
+/* Take over the pins of a bank the port drives: they start out as inputs with their output latch high, which also
+ * brings the shadow backend's copy of the latches in line with the bank.
+ */
+static __inline void
+GPIO_Attach(GPIO_PORT *port, volatile UINT8 *bank, UINT16 pins)
+{
+	port->bank = bank;
+
+	GPIO_Store(port, GPIO_DIR_CLEAR_OFFSET, pins);
+	GPIO_Store(port, GPIO_DATA_OFFSET, pins);
+
+#ifdef GPIO_SHADOW_BACKEND
+	port->output = pins;
+	port->pending = pins;
+	port->dir = 0;
+#endif
+}
+
+#endif
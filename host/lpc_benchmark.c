@@ -0,0 +1,2111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lpc_emulator.h"
+#include "gpio.h"
+#include "lpc.h"
+#include "crc.h"
+#include "lz.h"
+#include "debug.h"
+#include "lpc_master.h"
+#include "interrupt.h"
+
+/* ### LPC Slave Benchmark ###
+ *
+ * Drives the unmodified slave (gpio.c, lpc.c, lpc_io_transmission.c) through the emulated bus and reports:
+ * - ns per LCLK edge (time spent per GPIO_ISR invocation, bus emulation included),
+ * - ns per edge for each bus phase (ISR only, includes the clock_gettime overhead of the profiler),
+ * - complete I/O write and read cycles per second,
+ * - edges per second of LPC_HandleCycle alone, replaying recorded samples without the bus emulation,
+ * - loads and stores to the GPIO bank per I/O write, I/O read and ignored cycle (built with -DGPIO_COUNT_ACCESSES),
+ * - bus clocks per byte and bytes per second moving a 256 byte payload with I/O reads vs Firmware Memory MSIZE bursts,
+ * - bus clocks and round trips per second echoing 255 byte messages with I/O data cycles (one address per byte,
+ *   or string I/O on the FIFO port) vs 32-bit DMA cycles,
+ * - sustained messages per second (at a 33 MHz LCLK) through the message queue for several application latencies,
+ *   with the host waiting for each reply before sending the next message vs keeping BENCHMARK_QUEUE_WINDOW messages in flight,
+ * - ns per message the application spends answering with the copying API vs the zero-copy lease API,
+ * - ns per data byte of the I/O write handler (run from the ISR at SYNC) for each integrity mode, checksum vs CRC-16 vs CRC-32,
+ * - bus clocks per byte echoing a 4 KB payload as one paged large message vs 255 byte messages split by the application,
+ * - bus clocks per 255 byte message sent over a noisy bus (corrupted data bytes), resending the whole message (CRC-16)
+ *   vs only the blocks listed in the NAK bitmap (CRC-8 per block),
+ * - round trip latency and payload bytes per second of the master library (lpc_master.h) over the loopback transport,
+ *   on a clean and a noisy bus,
+ * - effective bytes per second of sample payloads sent as they are vs LZ compressed,
+ * - ns per I/O dispatch through the device registry,
+ * - bus clocks and ISR time per cycle to other devices' addresses, answered vs ignored by positive decode,
+ * - LCLKs until the slave floats LAD after a host abort or LRESET in the middle of a read, and whether the exchange
+ *   that follows succeeds,
+ * - whether the deferred decoder dispatches the rest of a cycle after its sample ring overran (-DLPC_DEFERRED_DECODE),
+ * - edges of another GPIO user on the vector served alongside LCLK, re-entries and lost edges of the dispatcher,
+ * - the instrumentation counters read over the bus (built with -DLPC_INSTRUMENT),
+ * - ns per trace record and trace records per message at the DEBUG_LEVEL built.
+ *
+ * Build with -DLPC_TABLE_DECODER or -DLPC_DEFERRED_DECODE to benchmark the other decoders instead of the switch decoder,
+ * the deferred decoder's bottom half runs after every LCLK period (and after every replayed cycle pair).
+ * -DGPIO_SHADOW_BACKEND or -DGPIO_EMULATED_BACKEND select the other GPIO backends.
+ *
+ * Usage: lpc_benchmark [cycles] [trace dump, see lpc_trace.c]
+ */
+
+#define BENCHMARK_DEFAULT_CYCLES	(1000000)
+#define BENCHMARK_REPLAY_LENGTH		(64)
+
+#define BENCHMARK_BULK_LENGTH		(256)
+#define BENCHMARK_FWH_BASE		(0xFFFFF00)
+#define BENCHMARK_DMA_CHANNEL		(1)
+
+#define BENCHMARK_REPLY_LENGTH		(255)
+#define BENCHMARK_QUEUE_MESSAGE_LENGTH	(32)
+#define BENCHMARK_QUEUE_WINDOW		(4)		// MSG_QUEUE_LENGTH
+#define BENCHMARK_LCLK_HZ		(33e6)
+#define BENCHMARK_LARGE_LENGTH		(4096)
+#define BENCHMARK_COMPRESS_LENGTH	(4096)
+#define BENCHMARK_DEVICE_BASE		(0x02E0)	// Scratch registers next to the message protocol
+#define BENCHMARK_DEVICE_LENGTH		(8)
+#define BENCHMARK_RECOVERY_LENGTH	(16)
+#define BENCHMARK_RESET_CLOCKS		(8)		// LCLKs LRESET is held low
+#define BENCHMARK_DISPATCH_NESTED	(4)
+
+// Message protocol address map, see lpc_io_transmission.c
+
+#define MSG_ADDR_OF_LENGTH		(0x100)
+#define MSG_ADDR_OF_CHECKSUM		(0x101)
+#define MSG_ADDR_OF_ACK			(0x102)
+#define MSG_ADDR_OF_INTEGRITY		(0x103)
+#define MSG_ADDR_OF_CRC			(0x104)
+#define MSG_ADDR_OF_LENGTH_HIGH		(0x108)
+#define MSG_ADDR_OF_PAGE		(0x109)
+#define MSG_ADDR_OF_NAK			(0x10A)
+#define MSG_ADDR_OF_FIFO		(0x10B)
+#define MSG_ADDR_OF_FIFO_POINTER	(0x10C)
+#define MSG_ADDR_OF_BLOCK_CHECK		(0x110)
+
+#define MSG_LENGTH_COMPRESSED		(0x80)
+
+#define MSG_BLOCK_LENGTH		(32)
+
+#define ACK_PASS			(0xA0)
+
+extern void LPC_HandleIOWrite(LPC_CONTEXT *lpc, UINT16 address, UINT8 data);
+
+#ifdef LPC_DEFERRED_DECODE
+// Bottom half of the board's port, run by the emulated main loop
+static void BENCHMARK_ProcessSamples(void)
+{
+	LPC_ProcessSamples(&lpc_port);
+}
+#endif
+
+static double BENCHMARK_Seconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + ((double)now.tv_nsec / 1e9);
+}
+
+static void BENCHMARK_Report(const char *name, double seconds)
+{
+	printf("%-10s %10llu cycles %12llu edges %10.1f ns/edge %12.0f cycles/s %6llu aborts %6llu contentions\n",
+		name,
+		(unsigned long long)lpcemu_stats.cycles,
+		(unsigned long long)lpcemu_stats.edges,
+		(seconds * 1e9) / (double)lpcemu_stats.edges,
+		(double)lpcemu_stats.cycles / seconds,
+		(unsigned long long)lpcemu_stats.aborts,
+		(unsigned long long)lpcemu_stats.contentions);
+}
+
+static UINT8 BENCHMARK_Checksum(const UINT8 *message, UINT16 length)
+{
+	UINT8 checksum = 0;
+	UINT16 i;
+
+	for(i = 0; i < length; i++)
+	{
+		checksum += message[i];
+	}
+
+	return checksum;
+}
+
+/* Send a message with message[i] = i and echo it, so I/O reads of address i return i until the reply is acknowledged */
+static void BENCHMARK_QueueReply(void)
+{
+	UINT8 message[BENCHMARK_REPLY_LENGTH];
+	UINT8 length;
+	UINT8 ack;
+	int i;
+
+	LPCEMU_IOWrite(MSG_ADDR_OF_LENGTH, BENCHMARK_REPLY_LENGTH);
+
+	for(i = 0; i < BENCHMARK_REPLY_LENGTH; i++)
+	{
+		message[i] = (UINT8)i;
+		LPCEMU_IOWrite((UINT16)i, message[i]);
+	}
+
+	LPCEMU_IOWrite(MSG_ADDR_OF_CHECKSUM, BENCHMARK_Checksum(message, BENCHMARK_REPLY_LENGTH));
+	LPCEMU_IORead(MSG_ADDR_OF_ACK, &ack);
+
+	if((ack != ACK_PASS) || !LPC_GetIOMessage(&lpc_port_messages, message, &length) || !LPC_SetIOMessage(&lpc_port_messages, message, length))
+	{
+		printf("reply: message not accepted\n");
+		exit(1);
+	}
+}
+
+/* ### Application Model ###
+ *
+ * Runs after every LCLK period: takes the oldest message, works on it for benchmark_latency clocks and echoes it.
+ */
+
+static long	benchmark_latency;
+static long	benchmark_busy = -1;
+static UINT8	benchmark_message[256];
+static UINT8	benchmark_message_length;
+
+static void BENCHMARK_Application(void)
+{
+#ifdef LPC_DEFERRED_DECODE
+	LPC_ProcessSamples(&lpc_port);
+#endif
+
+	if(benchmark_busy < 0)
+	{
+		if(!LPC_GetIOMessage(&lpc_port_messages, benchmark_message, &benchmark_message_length)) return;
+
+		benchmark_busy = benchmark_latency;
+	}
+
+	if(benchmark_busy > 0)
+	{
+		benchmark_busy -= 1;
+
+		return;
+	}
+
+	if(LPC_SetIOMessage(&lpc_port_messages, benchmark_message, benchmark_message_length))
+	{
+		benchmark_busy = -1;
+	}
+}
+
+static void BENCHMARK_Queue(long count)
+{
+	static const long latencies[] = { 0, 500, 2000, 8000 };
+	UINT8 sent[BENCHMARK_QUEUE_MESSAGE_LENGTH];
+	UINT8 received[256];
+	UINT8 length;
+	UINT8 ack;
+	UINT8 checksum;
+	LPC_QUEUE_STATS stats;
+	long messages_sent;
+	long messages_received;
+	long window;
+	int latency;
+	int j;
+
+	for(j = 0; j < BENCHMARK_QUEUE_MESSAGE_LENGTH; j++)
+	{
+		sent[j] = (UINT8)(j * 3);
+	}
+
+	LPCEMU_SetBackground(BENCHMARK_Application);
+
+	printf("\n%-10s %8s %8s %12s %12s %8s %8s %8s\n", "queue", "latency", "window", "clocks/msg", "msgs/s", "rx_max", "rx_full", "aborts");
+
+	for(latency = 0; latency < (int)(sizeof(latencies) / sizeof(latencies[0])); latency++)
+	{
+		for(window = 1; window <= BENCHMARK_QUEUE_WINDOW; window += (BENCHMARK_QUEUE_WINDOW - 1))
+		{
+			benchmark_latency = latencies[latency];
+
+			LPC_GetQueueStats(&lpc_port_messages, &stats, TRUE);
+			LPCEMU_ClearStats();
+
+			messages_sent = 0;
+			messages_received = 0;
+
+			while(messages_received < count)
+			{
+				if((messages_sent < count) && ((messages_sent - messages_received) < window))
+				{
+					/* Host sends the next message, it is sent again if every slot was in use */
+					LPCEMU_IOWrite(MSG_ADDR_OF_LENGTH, BENCHMARK_QUEUE_MESSAGE_LENGTH);
+
+					for(j = 0; j < BENCHMARK_QUEUE_MESSAGE_LENGTH; j++)
+					{
+						LPCEMU_IOWrite((UINT16)j, sent[j]);
+					}
+
+					LPCEMU_IOWrite(MSG_ADDR_OF_CHECKSUM, BENCHMARK_Checksum(sent, BENCHMARK_QUEUE_MESSAGE_LENGTH));
+
+					if(LPCEMU_IORead(MSG_ADDR_OF_ACK, &ack) && (ack == ACK_PASS))
+					{
+						messages_sent += 1;
+					}
+				}
+				else
+				{
+					/* Host waits for the oldest reply, a wait longer than the host's long wait timeout is retried */
+					if(!LPCEMU_IORead(MSG_ADDR_OF_LENGTH, &length)) continue;
+
+					for(j = 0; j < length; j++)
+					{
+						LPCEMU_IORead((UINT16)j, &received[j]);
+					}
+
+					LPCEMU_IORead(MSG_ADDR_OF_CHECKSUM, &checksum);
+					LPCEMU_IOWrite(MSG_ADDR_OF_ACK, ACK_PASS);
+
+					if((length != BENCHMARK_QUEUE_MESSAGE_LENGTH) || (checksum != BENCHMARK_Checksum(received, length)) || memcmp(sent, received, length))
+					{
+						printf("queue: echo failed\n");
+						exit(1);
+					}
+
+					messages_received += 1;
+				}
+			}
+
+			LPC_GetQueueStats(&lpc_port_messages, &stats, TRUE);
+
+			printf("%-10s %8ld %8ld %12.0f %12.0f %8u %8lu %8llu\n", "",
+				benchmark_latency,
+				window,
+				(double)lpcemu_stats.edges / (double)count,
+				((double)count * BENCHMARK_LCLK_HZ) / (double)lpcemu_stats.edges,
+				(unsigned)stats.rx_depth_max,
+				(unsigned long)stats.rx_full,
+				(unsigned long long)lpcemu_stats.aborts);
+		}
+	}
+
+#ifdef LPC_DEFERRED_DECODE
+	LPCEMU_SetBackground(BENCHMARK_ProcessSamples);
+#else
+	LPCEMU_SetBackground(NULL);
+#endif
+}
+
+/* Application side cost of answering a 255 byte message with reply[i] = message[i] + 1,
+ * copying it out and back in (LPC_GetIOMessage/LPC_SetIOMessage) vs working on the leased buffers in place
+ */
+static void BENCHMARK_Lease(long count)
+{
+	UINT8 sent[BENCHMARK_REPLY_LENGTH];
+	UINT8 buffer[256];
+	UINT8 *message;
+	UINT8 *reply;
+	UINT16 message_length;
+	UINT8 length;
+	UINT8 ack;
+	long i;
+	int j;
+	int lease;
+	double start;
+	double seconds;
+
+	for(j = 0; j < BENCHMARK_REPLY_LENGTH; j++)
+	{
+		sent[j] = (UINT8)(j ^ 0xA5);
+	}
+
+	printf("\n%-10s %12s\n", "answer", "ns/msg");
+
+	for(lease = 0; lease <= 1; lease++)
+	{
+		seconds = 0;
+
+		for(i = 0; i < count; i++)
+		{
+			LPCEMU_IOWrite(MSG_ADDR_OF_LENGTH, BENCHMARK_REPLY_LENGTH);
+
+			for(j = 0; j < BENCHMARK_REPLY_LENGTH; j++)
+			{
+				LPCEMU_IOWrite((UINT16)j, sent[j]);
+			}
+
+			LPCEMU_IOWrite(MSG_ADDR_OF_CHECKSUM, BENCHMARK_Checksum(sent, BENCHMARK_REPLY_LENGTH));
+			LPCEMU_IORead(MSG_ADDR_OF_ACK, &ack);
+
+			start = BENCHMARK_Seconds();
+
+			if(lease)
+			{
+				message = LPC_LeaseIOMessage(&lpc_port_messages, &message_length);
+				reply = LPC_LeaseIOReply(&lpc_port_messages, message_length);
+
+				for(j = 0; j < message_length; j++)
+				{
+					reply[j] = message[j] + 1;
+				}
+
+				LPC_CommitIOReply(&lpc_port_messages, message_length);
+			}
+			else
+			{
+				LPC_GetIOMessage(&lpc_port_messages, buffer, &length);
+
+				for(j = 0; j < length; j++)
+				{
+					buffer[j] = buffer[j] + 1;
+				}
+
+				LPC_SetIOMessage(&lpc_port_messages, buffer, length);
+			}
+
+			seconds += BENCHMARK_Seconds() - start;
+
+			LPCEMU_IORead(MSG_ADDR_OF_LENGTH, &length);
+			LPCEMU_IORead(0x0000, &buffer[0]);
+			LPCEMU_IOWrite(MSG_ADDR_OF_ACK, ACK_PASS);
+
+			if((ack != ACK_PASS) || (length != BENCHMARK_REPLY_LENGTH) || (buffer[0] != (UINT8)(sent[0] + 1)))
+			{
+				printf("%s: answer failed\n", lease ? "lease" : "copy");
+				exit(1);
+			}
+		}
+
+		printf("%-10s %12.1f\n", lease ? "lease" : "copy", (seconds * 1e9) / (double)count);
+	}
+}
+
+/* Echo a message over the bus in the given integrity mode, the CRC is checked in both directions: the message is
+ * written in descending order once it was rejected, and a byte of the reply is read again. The block check values
+ * of the reply are checked as well, after the whole reply and after the first block was started again
+ */
+static void BENCHMARK_IntegrityEcho(UINT8 mode, const UINT8 *message, UINT8 length)
+{
+	UINT8 buffer[256];
+	UINT8 received[256];
+	UINT32 crc;
+	UINT32 read_crc = 0;
+	UINT32 reread_crc = 0;
+	UINT8 width = (mode == 2) ? 4 : 2;
+	UINT8 ack;
+	UINT8 bad_ack;
+	UINT8 data;
+	int bad_blocks = 0;
+	int j;
+
+	crc = (mode == 2) ? CRC32_Compute(message, length) : CRC16_Compute(message, length);
+
+	LPCEMU_IOWrite(MSG_ADDR_OF_INTEGRITY, mode);
+
+	/* A corrupted CRC is rejected */
+	LPCEMU_IOWrite(MSG_ADDR_OF_LENGTH, length);
+
+	for(j = 0; j < length; j++)
+	{
+		LPCEMU_IOWrite((UINT16)j, message[j]);
+	}
+
+	for(j = 0; j < width; j++)
+	{
+		LPCEMU_IOWrite((UINT16)(MSG_ADDR_OF_CRC + j), (UINT8)((crc ^ 0x100) >> (8 * j)));
+	}
+
+	LPCEMU_IORead(MSG_ADDR_OF_ACK, &bad_ack);
+
+	/* The correct one is accepted, whatever the order of the data bytes */
+	LPCEMU_IOWrite(MSG_ADDR_OF_LENGTH, length);
+
+	for(j = length - 1; j >= 0; j--)
+	{
+		LPCEMU_IOWrite((UINT16)j, message[j]);
+	}
+
+	for(j = 0; j < width; j++)
+	{
+		LPCEMU_IOWrite((UINT16)(MSG_ADDR_OF_CRC + j), (UINT8)(crc >> (8 * j)));
+	}
+
+	LPCEMU_IORead(MSG_ADDR_OF_ACK, &ack);
+
+	LPC_GetIOMessage(&lpc_port_messages, buffer, &length);
+	LPC_SetIOMessage(&lpc_port_messages, buffer, length);
+
+	LPCEMU_IORead(MSG_ADDR_OF_LENGTH, &length);
+
+	for(j = 0; j < length; j++)
+	{
+		LPCEMU_IORead((UINT16)j, &received[j]);
+	}
+
+	for(j = 0; j < width; j++)
+	{
+		LPCEMU_IORead((UINT16)(MSG_ADDR_OF_CRC + j), &data);
+		read_crc |= ((UINT32)data << (8 * j));
+	}
+
+	for(j = 0; j * MSG_BLOCK_LENGTH < length; j++)
+	{
+		LPCEMU_IORead((UINT16)(MSG_ADDR_OF_BLOCK_CHECK + j), &data);
+		if(data != CRC8_Compute(&message[j * MSG_BLOCK_LENGTH], ((j + 1) * MSG_BLOCK_LENGTH > length) ? (length - j * MSG_BLOCK_LENGTH) : MSG_BLOCK_LENGTH)) bad_blocks += 1;
+	}
+
+	LPCEMU_IORead(0x0000, &received[0]);
+	LPCEMU_IORead(MSG_ADDR_OF_BLOCK_CHECK, &data);
+	if(data != CRC8_Compute(message, (length > MSG_BLOCK_LENGTH) ? MSG_BLOCK_LENGTH : length)) bad_blocks += 1;
+
+	for(j = 0; j < width; j++)
+	{
+		LPCEMU_IORead((UINT16)(MSG_ADDR_OF_CRC + j), &data);
+		reread_crc |= ((UINT32)data << (8 * j));
+	}
+
+	LPCEMU_IOWrite(MSG_ADDR_OF_ACK, ACK_PASS);
+	LPCEMU_IOWrite(MSG_ADDR_OF_INTEGRITY, 0);
+
+	if((bad_ack == ACK_PASS) || (ack != ACK_PASS) || (read_crc != crc) || (reread_crc != crc) || bad_blocks
+	|| memcmp(message, received, length))
+	{
+		printf("integrity %u: echo failed\n", (unsigned)mode);
+		exit(1);
+	}
+}
+
+static void BENCHMARK_Integrity(long count)
+{
+	static const char *names[] = { "sum", "crc16", "crc32" };
+	UINT8 message[255];
+	UINT8 mode;
+	long i;
+	int j;
+	double start;
+	double seconds;
+
+	for(j = 0; j < 255; j++)
+	{
+		message[j] = (UINT8)((j * 31) ^ 0x3C);
+	}
+
+	printf("\n%-10s %12s\n", "integrity", "ns/byte");
+
+	for(mode = 0; mode <= 2; mode++)
+	{
+		if(mode != 0)
+		{
+			BENCHMARK_IntegrityEcho(mode, message, 255);
+		}
+
+		LPC_HandleIOWrite(&lpc_port, MSG_ADDR_OF_INTEGRITY, mode);
+		LPC_HandleIOWrite(&lpc_port, MSG_ADDR_OF_LENGTH, 255);
+
+		start = BENCHMARK_Seconds();
+
+		for(i = 0; i < count; i++)
+		{
+			/* Rewinds the integrity check, so every pass is the ascending one the ISR updates per byte */
+			LPC_HandleIOWrite(&lpc_port, MSG_ADDR_OF_PAGE, 0);
+
+			for(j = 0; j < 255; j++)
+			{
+				LPC_HandleIOWrite(&lpc_port, (UINT16)j, message[j]);
+			}
+		}
+
+		seconds = BENCHMARK_Seconds() - start;
+
+		printf("%-10s %12.2f\n", names[mode], (seconds * 1e9) / ((double)count * 255));
+	}
+
+	/* Drop the unfinished message and go back to the additive checksum */
+	LPC_HandleIOWrite(&lpc_port, MSG_ADDR_OF_INTEGRITY, 0);
+}
+
+/* Send length bytes as one message, in 256 byte pages if it is longer than 255 bytes, control is ORed into LENGTH_HIGH */
+static void BENCHMARK_SendMessage(const UINT8 *message, UINT16 length, UINT8 control)
+{
+	UINT16 page;
+	UINT16 page_length;
+	UINT16 j;
+	UINT8 ack;
+
+	if((length >= 256) || control) LPCEMU_IOWrite(MSG_ADDR_OF_LENGTH_HIGH, (UINT8)(length >> 8) | control);
+	LPCEMU_IOWrite(MSG_ADDR_OF_LENGTH, (UINT8)length);
+
+	for(page = 0; (page == 0) || ((page << 8) < length); page++)
+	{
+		page_length = ((length - (page << 8)) > 256) ? 256 : (length - (page << 8));
+
+		do
+		{
+			if(length >= 256) LPCEMU_IOWrite(MSG_ADDR_OF_PAGE, (UINT8)page);
+
+			for(j = 0; j < page_length; j++)
+			{
+				LPCEMU_IOWrite(j, message[(page << 8) + j]);
+			}
+
+			LPCEMU_IOWrite(MSG_ADDR_OF_CHECKSUM, BENCHMARK_Checksum(&message[page << 8], page_length));
+		}
+		while(!LPCEMU_IORead(MSG_ADDR_OF_ACK, &ack) || (ack != ACK_PASS));
+	}
+}
+
+/* Receive the oldest reply, in 256 byte pages if it is longer than 255 bytes, returns its length */
+static UINT16 BENCHMARK_ReceiveMessage(UINT8 *message)
+{
+	UINT16 length;
+	UINT16 page;
+	UINT16 page_length;
+	UINT16 j;
+	UINT8 data;
+	UINT8 checksum;
+
+	while(!LPCEMU_IORead(MSG_ADDR_OF_LENGTH, &data));
+	length = data;
+
+	LPCEMU_IORead(MSG_ADDR_OF_LENGTH_HIGH, &data);
+	length |= ((UINT16)data << 8);
+
+	for(page = 0; (page == 0) || ((page << 8) < length); page++)
+	{
+		page_length = ((length - (page << 8)) > 256) ? 256 : (length - (page << 8));
+
+		while(TRUE)
+		{
+			if(length >= 256) LPCEMU_IOWrite(MSG_ADDR_OF_PAGE, (UINT8)page);
+
+			for(j = 0; j < page_length; j++)
+			{
+				LPCEMU_IORead(j, &message[(page << 8) + j]);
+			}
+
+			LPCEMU_IORead(MSG_ADDR_OF_CHECKSUM, &checksum);
+
+			if(checksum == BENCHMARK_Checksum(&message[page << 8], page_length)) break;
+
+			LPCEMU_IOWrite(MSG_ADDR_OF_ACK, 0xAF);
+		}
+
+		LPCEMU_IOWrite(MSG_ADDR_OF_ACK, ACK_PASS);
+	}
+
+	return length;
+}
+
+static void BENCHMARK_Large(long count)
+{
+	static UINT8 large_rx[BENCHMARK_LARGE_LENGTH];
+	static UINT8 large_tx[BENCHMARK_LARGE_LENGTH];
+	static UINT8 sent[BENCHMARK_LARGE_LENGTH];
+	static UINT8 received[BENCHMARK_LARGE_LENGTH];
+	UINT8 *message;
+	UINT8 *reply;
+	UINT16 length;
+	UINT16 offset;
+	UINT16 slice;
+	long i;
+	int j;
+	int paged;
+
+	for(j = 0; j < BENCHMARK_LARGE_LENGTH; j++)
+	{
+		sent[j] = (UINT8)((j * 13) ^ (j >> 8));
+	}
+
+	LPC_SetIOLargeBuffers(&lpc_port_messages, large_rx, large_tx, BENCHMARK_LARGE_LENGTH);
+
+	printf("\n%-10s %12s %14s\n", "large", "clocks/byte", "bytes/s");
+
+	for(paged = 0; paged <= 1; paged++)
+	{
+		LPCEMU_ClearStats();
+
+		for(i = 0; i < count; i++)
+		{
+			for(offset = 0; offset < BENCHMARK_LARGE_LENGTH; offset += slice)
+			{
+				slice = paged ? BENCHMARK_LARGE_LENGTH : (((BENCHMARK_LARGE_LENGTH - offset) > 255) ? 255 : (BENCHMARK_LARGE_LENGTH - offset));
+
+				BENCHMARK_SendMessage(&sent[offset], slice, 0);
+
+				message = LPC_LeaseIOMessage(&lpc_port_messages, &length);
+				reply = LPC_LeaseIOReply(&lpc_port_messages, length);
+				memcpy(reply, message, length);
+				LPC_CommitIOReply(&lpc_port_messages, length);
+
+				if((BENCHMARK_ReceiveMessage(&received[offset]) != slice) || memcmp(&sent[offset], &received[offset], slice))
+				{
+					printf("%s: echo failed\n", paged ? "paged" : "split");
+					exit(1);
+				}
+			}
+		}
+
+		printf("%-10s %12.2f %14.0f\n", paged ? "paged" : "split",
+			(double)lpcemu_stats.edges / ((double)count * BENCHMARK_LARGE_LENGTH),
+			((double)count * BENCHMARK_LARGE_LENGTH * BENCHMARK_LCLK_HZ) / (double)lpcemu_stats.edges);
+	}
+
+	LPC_SetIOLargeBuffers(&lpc_port_messages, NULL, NULL, 0);
+}
+
+/* ### Compression ###
+ *
+ * Effective (uncompressed) bytes per second of one way transfers of sample payloads, sent as they are and
+ * compressed with LZ_Compress (sent as they are when that does not make them smaller). The slave expands them
+ * when they are leased, which costs CPU time but no bus clocks, so it is reported on its own.
+ */
+
+static UINT16 BENCHMARK_SamplePayload(int sample, UINT8 *payload)
+{
+	static const char *keys[] = { "baudrate", "parity", "stopbits", "timeout", "retries", "enabled" };
+	UINT16 length = 0;
+	int record;
+	int j;
+
+	switch(sample)
+	{
+		case 0: {
+
+			/* Telemetry: 16 byte records, a timestamp, slowly changing readings and flags */
+			for(record = 0; length < BENCHMARK_COMPRESS_LENGTH; record++)
+			{
+				payload[length++] = (UINT8)(record >> 0);
+				payload[length++] = (UINT8)(record >> 8);
+				payload[length++] = 0x00;
+				payload[length++] = 0x00;
+				payload[length++] = (UINT8)(0x40 + ((record >> 5) & 3));
+				payload[length++] = 0x0C;
+				payload[length++] = (UINT8)(0x80 + ((record * 7 >> 6) & 1));
+				payload[length++] = 0x01;
+
+				for(j = 0; j < 8; j++)
+				{
+					payload[length++] = (j < 2) ? 0x55 : 0x00;
+				}
+			}
+
+		} break;
+
+		case 1: {
+
+			/* Configuration text: key=value lines */
+			for(record = 0; length < BENCHMARK_COMPRESS_LENGTH - 32; record++)
+			{
+				length += (UINT16)sprintf((char *)&payload[length], "port%d.%s=%d\n", record / 6, keys[record % 6], (record % 6) * 1200);
+			}
+
+			while(length < BENCHMARK_COMPRESS_LENGTH) payload[length++] = 0;
+
+		} break;
+
+		default: {
+
+			/* Random bytes, incompressible */
+			for(length = 0; length < BENCHMARK_COMPRESS_LENGTH; length++)
+			{
+				payload[length] = (UINT8)(rand() >> 7);
+			}
+
+		} break;
+	}
+
+	return length;
+}
+
+static void BENCHMARK_Compression(long count)
+{
+	static const char *names[] = { "telemetry", "config", "random" };
+	static UINT8 large_rx[BENCHMARK_COMPRESS_LENGTH];
+	static UINT8 large_tx[BENCHMARK_COMPRESS_LENGTH];
+	static UINT8 expand[BENCHMARK_COMPRESS_LENGTH];
+	static UINT8 payload[BENCHMARK_COMPRESS_LENGTH];
+	static UINT8 packed[BENCHMARK_COMPRESS_LENGTH];
+	static UINT8 reply[256];
+	double raw_rate = 0.0;
+	double expand_seconds;
+	double start;
+	UINT32 packed_length;
+	UINT16 length;
+	UINT8 *message;
+	long i;
+	int sample;
+	int compressed;
+
+	LPC_SetIOLargeBuffers(&lpc_port_messages, large_rx, large_tx, BENCHMARK_COMPRESS_LENGTH);
+	LPC_SetIOExpandBuffer(&lpc_port_messages, expand, BENCHMARK_COMPRESS_LENGTH);
+
+	printf("\n%-10s %-5s %8s %14s %10s %14s\n", "compress", "", "bytes", "bytes/s", "speedup", "expand ns/B");
+
+	for(sample = 0; sample < 3; sample++)
+	{
+		length = BENCHMARK_SamplePayload(sample, payload);
+
+		packed_length = LZ_Compress(payload, length, packed, length - 1);
+
+		for(compressed = 0; compressed <= 1; compressed++)
+		{
+			LPCEMU_ClearStats();
+			expand_seconds = 0.0;
+
+			for(i = 0; i < count; i++)
+			{
+				if(compressed && (packed_length != LZ_ERROR))
+				{
+					BENCHMARK_SendMessage(packed, (UINT16)packed_length, MSG_LENGTH_COMPRESSED);
+				}
+				else
+				{
+					BENCHMARK_SendMessage(payload, length, 0);
+				}
+
+				start = BENCHMARK_Seconds();
+				message = LPC_LeaseIOMessage(&lpc_port_messages, &length);
+				expand_seconds += BENCHMARK_Seconds() - start;
+
+				if((message == NULL) || (length != BENCHMARK_COMPRESS_LENGTH) || memcmp(message, payload, length))
+				{
+					printf("%s: message corrupted\n", names[sample]);
+					exit(1);
+				}
+
+				LPC_LeaseIOReply(&lpc_port_messages, 0);
+				LPC_CommitIOReply(&lpc_port_messages, 0);
+
+				BENCHMARK_ReceiveMessage(reply);
+			}
+
+			if(!compressed) raw_rate = ((double)count * length * BENCHMARK_LCLK_HZ) / (double)lpcemu_stats.edges;
+
+			printf("%-10s %-5s %8u %14.0f %9.2fx %14.2f\n", names[sample], compressed ? "lz" : "raw",
+				(compressed && (packed_length != LZ_ERROR)) ? (unsigned)packed_length : (unsigned)length,
+				((double)count * length * BENCHMARK_LCLK_HZ) / (double)lpcemu_stats.edges,
+				(((double)count * length * BENCHMARK_LCLK_HZ) / (double)lpcemu_stats.edges) / raw_rate,
+				(expand_seconds * 1e9) / ((double)count * length));
+		}
+	}
+
+	LPC_SetIOExpandBuffer(&lpc_port_messages, NULL, 0);
+	LPC_SetIOLargeBuffers(&lpc_port_messages, NULL, NULL, 0);
+}
+
+/* ### I/O Devices ###
+ *
+ * A scratch register device next to the message protocol, and a write only counter registered over half of it,
+ * so writes to that half are counted while reads still return the scratch registers.
+ */
+
+static UINT8	benchmark_scratch[BENCHMARK_DEVICE_LENGTH];
+static UINT32	benchmark_counted;
+
+static LPC_IO_READ_RESULT BENCHMARK_ScratchRead(void *context, UINT16 address, UINT8 *data)
+{
+	(*data) = ((UINT8 *)context)[address];
+
+	return IO_READ_READY;
+}
+
+static void BENCHMARK_ScratchWrite(void *context, UINT16 address, UINT8 data)
+{
+	((UINT8 *)context)[address] = data;
+}
+
+static void BENCHMARK_CounterWrite(void *context, UINT16 address, UINT8 data)
+{
+	(*(UINT32 *)context) += 1;
+}
+
+static void BENCHMARK_Devices(long count)
+{
+	double start;
+	double seconds;
+	UINT8 data;
+	long i;
+	int j;
+
+	if(!LPC_RegisterIODevice(&lpc_port, BENCHMARK_DEVICE_BASE, BENCHMARK_DEVICE_LENGTH, BENCHMARK_ScratchRead, BENCHMARK_ScratchWrite, benchmark_scratch)
+	|| !LPC_RegisterIODevice(&lpc_port, BENCHMARK_DEVICE_BASE + 4, 4, NULL, BENCHMARK_CounterWrite, &benchmark_counted)
+	|| !LPC_SetDecodeWindow(&lpc_port, 1, BENCHMARK_DEVICE_BASE, BENCHMARK_DEVICE_LENGTH - 1))
+	{
+		printf("devices: registration failed\n");
+		exit(1);
+	}
+
+	for(j = 0; j < BENCHMARK_DEVICE_LENGTH; j++)
+	{
+		LPCEMU_IOWrite(BENCHMARK_DEVICE_BASE + j, (UINT8)(0x50 + j));
+	}
+
+	for(j = 0; j < BENCHMARK_DEVICE_LENGTH; j++)
+	{
+		/* The counter took the writes to the upper half, the scratch registers there were never written */
+		if(!LPCEMU_IORead(BENCHMARK_DEVICE_BASE + j, &data) || (data != ((j < 4) ? (UINT8)(0x50 + j) : 0)))
+		{
+			printf("devices: unexpected data 0x%02X at 0x%04X\n", data, BENCHMARK_DEVICE_BASE + j);
+			exit(1);
+		}
+	}
+
+	if(benchmark_counted != 4)
+	{
+		printf("devices: %lu counted writes\n", (unsigned long)benchmark_counted);
+		exit(1);
+	}
+
+	start = BENCHMARK_Seconds();
+
+	for(i = 0; i < count; i++)
+	{
+		LPC_HandleIOWrite(&lpc_port, (UINT16)(BENCHMARK_DEVICE_BASE + (i & 3)), (UINT8)i);
+	}
+
+	seconds = BENCHMARK_Seconds() - start;
+
+	printf("\n%-10s %12.2f ns/dispatch\n", "devices", (seconds * 1e9) / (double)count);
+}
+
+/* ### Decode Windows ###
+ *
+ * Cycles to other devices on the bus (here a UART at 0x03F8 and the PCI config address port at 0x0CF8) with
+ * positive decode, and with a window over the whole I/O space as if the slave answered every cycle.
+ */
+
+static void BENCHMARK_Decode(long count)
+{
+	static const UINT16 foreign[] = { 0x03F8, 0x03F9, 0x0CF8, 0x0CF9 };
+	LPC_DECODE_STATS stats;
+	UINT64 isr_ns;
+	long i;
+	int open;
+	int window;
+	int phase;
+
+	printf("\n%-10s %12s %12s %12s\n", "decode", "edges/cycle", "isr ns/edge", "aborts");
+
+	LPCEMU_SetProfiling(TRUE);
+
+	for(open = 1; open >= 0; open--)
+	{
+		if(open) LPC_SetDecodeWindow(&lpc_port, LPC_DECODE_WINDOWS - 1, 0x0000, 0xFFFF);
+
+		LPCEMU_ClearStats();
+
+		for(i = 0; i < count; i++)
+		{
+			LPCEMU_IOWrite(foreign[i & 3], (UINT8)i);
+		}
+
+		for(isr_ns = 0, phase = 0; phase < PHASE_COUNT; phase++)
+		{
+			isr_ns += lpcemu_stats.phase_ns[phase];
+		}
+
+		/* Unanswered cycles are aborted by the host, so they take more clocks but hardly any ISR time */
+		printf("%-10s %12.2f %12.1f %12llu\n", open ? "all" : "windows",
+			(double)lpcemu_stats.edges / (double)count,
+			(double)isr_ns / (double)lpcemu_stats.edges,
+			(unsigned long long)lpcemu_stats.aborts);
+
+		LPC_ClearDecodeWindow(&lpc_port, LPC_DECODE_WINDOWS - 1);
+	}
+
+	LPCEMU_SetProfiling(FALSE);
+
+	/* Mixed traffic: protocol, scratch device and foreign cycles */
+	LPC_GetDecodeStats(&lpc_port, &stats, TRUE);
+
+	for(i = 0; i < count; i++)
+	{
+		LPCEMU_IOWrite((UINT16)(i & 0x7F), (UINT8)i);
+		LPCEMU_IOWrite((UINT16)(BENCHMARK_DEVICE_BASE + (i & 3)), (UINT8)i);
+		LPCEMU_IOWrite(foreign[i & 3], (UINT8)i);
+	}
+
+	LPC_GetDecodeStats(&lpc_port, &stats, TRUE);
+
+	printf("\n%-10s %12s %12s   rejected at nibble 0-3: %lu %lu %lu %lu\n", "window", "hits", "misses",
+		(unsigned long)stats.rejected[0], (unsigned long)stats.rejected[1],
+		(unsigned long)stats.rejected[2], (unsigned long)stats.rejected[3]);
+
+	for(window = 0; window < 2; window++)
+	{
+		printf("%-10d %12lu %12lu\n", window, (unsigned long)stats.hits[window], (unsigned long)stats.misses[window]);
+	}
+}
+
+/* ### Abort and Reset Recovery ###
+ *
+ * A read is driven up to a point where the slave drives LAD (long wait syncs of a pending LENGTH read, or the data
+ * phase of a reply byte), then the host aborts the cycle (LFRAME low with 1111b for four clocks) or LRESET is held
+ * low for BENCHMARK_RESET_CLOCKS. Reports the LCLKs until the slave floated LAD (0 if it was not driving) and checks
+ * the first exchange after recovery: the aborted reply byte is read again and the checksum still has to match, a reset
+ * has to drop the queued reply and the half written message, so the next round trip returns the new message.
+ */
+
+// Drive an I/O read up to a few SYNC clocks (data = FALSE) or the first data nibble (data = TRUE), returns the last LAD sampled
+static UINT8 BENCHMARK_PartialRead(UINT16 address, BOOL data)
+{
+	UINT8 lad;
+	int i;
+
+	LPCEMU_Clock(FALSE, 0x0, TRUE, PHASE_START);
+	LPCEMU_Clock(TRUE, 0x0, TRUE, PHASE_CYCTYPE_AND_DIR);
+
+	for(i = 3; i >= 0; i--)
+	{
+		LPCEMU_Clock(TRUE, (address >> (4 * i)) & 0xF, TRUE, PHASE_ADDR);
+	}
+
+	LPCEMU_Clock(TRUE, 0xF, TRUE, PHASE_TAR);
+	lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+	for(i = 0; (i < 4) && (!data || (lad != 0x0)); i++)
+	{
+		lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_SYNC);
+	}
+
+	if(data && (lad == 0x0)) lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_DATA);
+
+	return lad;
+}
+
+// Abort the cycle or pulse LRESET, returns the LCLKs until the slave floated LAD
+static UINT32 BENCHMARK_Recover(BOOL reset)
+{
+	UINT32 clocks = 0;
+	UINT32 length = reset ? BENCHMARK_RESET_CLOCKS : 4;
+
+	LPCEMU_SetReset(reset);
+
+	while(LPCEMU_DrivenLAD() && (clocks < BENCHMARK_RECOVERY_LENGTH))
+	{
+		if(reset) LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_IDLE); else LPCEMU_Clock(FALSE, 0xF, TRUE, PHASE_ABORT);
+
+		clocks += 1;
+	}
+
+	for(; length > clocks; length--)
+	{
+		if(reset) LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_IDLE); else LPCEMU_Clock(FALSE, 0xF, TRUE, PHASE_ABORT);
+	}
+
+	LPCEMU_SetReset(FALSE);
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_IDLE);
+
+	return LPCEMU_DrivenLAD() ? BENCHMARK_RECOVERY_LENGTH : clocks;
+}
+
+// Send message, echo it from the application and read the reply back
+static BOOL BENCHMARK_RoundTrip(const UINT8 *message, UINT8 length)
+{
+	UINT8 received[256];
+	UINT8 received_length;
+
+	BENCHMARK_SendMessage(message, length, 0);
+
+	if(!LPC_GetIOMessage(&lpc_port_messages, received, &received_length)) return FALSE;
+	if(!LPC_SetIOMessage(&lpc_port_messages, received, received_length)) return FALSE;
+
+	return (BENCHMARK_ReceiveMessage(received) == length) && (memcmp(received, message, length) == 0);
+}
+
+static void BENCHMARK_Recovery(void)
+{
+	static const char *names[] = { "abort_sync", "abort_data", "reset_data", "reset_message" };
+	UINT8 message[BENCHMARK_QUEUE_MESSAGE_LENGTH];
+	UINT8 stale[BENCHMARK_QUEUE_MESSAGE_LENGTH];
+	UINT8 received[BENCHMARK_QUEUE_MESSAGE_LENGTH];
+	UINT8 length;
+	UINT8 checksum;
+	UINT8 lad;
+	UINT32 clocks;
+	BOOL ok;
+	int scenario;
+	int j;
+
+	printf("\n%-14s %8s %14s %8s\n", "recovery", "driving", "lclks to float", "after");
+
+	for(scenario = 0; scenario < 4; scenario++)
+	{
+		for(j = 0; j < BENCHMARK_QUEUE_MESSAGE_LENGTH; j++)
+		{
+			message[j] = (UINT8)((scenario * 37) + (j * 11));
+			stale[j] = (UINT8)~message[j];
+		}
+
+		lad = 0xFF;
+
+		switch(scenario)
+		{
+			case 0: /* Pending LENGTH read, the slave drives long waits */
+			{
+				lad = BENCHMARK_PartialRead(MSG_ADDR_OF_LENGTH, FALSE);
+
+			} break;
+
+			case 1: /* Reply byte 1 aborted after its first nibble */
+			case 2:
+			{
+				BENCHMARK_SendMessage(stale, BENCHMARK_QUEUE_MESSAGE_LENGTH, 0);
+				LPC_GetIOMessage(&lpc_port_messages, received, &length);
+				LPC_SetIOMessage(&lpc_port_messages, received, length);
+
+				LPCEMU_IORead(MSG_ADDR_OF_LENGTH, &length);
+				LPCEMU_IORead(0x0000, &received[0]);
+
+				lad = BENCHMARK_PartialRead(0x0001, TRUE);
+
+			} break;
+
+			case 3: /* Half of a message written */
+			{
+				LPCEMU_IOWrite(MSG_ADDR_OF_LENGTH, BENCHMARK_QUEUE_MESSAGE_LENGTH);
+
+				for(j = 0; j < (BENCHMARK_QUEUE_MESSAGE_LENGTH / 2); j++)
+				{
+					LPCEMU_IOWrite((UINT16)j, stale[j]);
+				}
+
+			} break;
+		}
+
+		clocks = BENCHMARK_Recover(scenario >= 2);
+
+		if(scenario == 1)
+		{
+			/* The host reads the rest of the reply again, the aborted byte must not be in the checksum twice */
+			for(j = 1; j < BENCHMARK_QUEUE_MESSAGE_LENGTH; j++)
+			{
+				LPCEMU_IORead((UINT16)j, &received[j]);
+			}
+
+			LPCEMU_IORead(MSG_ADDR_OF_CHECKSUM, &checksum);
+
+			ok = (checksum == BENCHMARK_Checksum(stale, BENCHMARK_QUEUE_MESSAGE_LENGTH))
+				&& (memcmp(received, stale, BENCHMARK_QUEUE_MESSAGE_LENGTH) == 0);
+
+			LPCEMU_IOWrite(MSG_ADDR_OF_ACK, ok ? ACK_PASS : 0xAF);
+		}
+		else
+		{
+			ok = TRUE;
+		}
+
+		ok = ok && BENCHMARK_RoundTrip(message, BENCHMARK_QUEUE_MESSAGE_LENGTH);
+
+		printf("%-14s %8s %14lu %8s\n", names[scenario], (lad == 0x6) ? "sync" : (scenario == 3) ? "-" : "data",
+			(unsigned long)clocks, ok ? "ok" : "FAILED");
+
+		if(!ok) exit(1);
+	}
+}
+
+#ifdef LPC_DEFERRED_DECODE
+
+/* ### Sample Ring Overrun ###
+ *
+ * The bottom half falls behind the top half by more than the sample ring in the middle of an I/O write to a foreign
+ * address (0xF202 = 0x4E). The samples left of that cycle (2 0 2 E 4) read like an I/O write to the counter device
+ * at BENCHMARK_DEVICE_BASE + 4, so the bottom half has to wait for the next LFRAME instead of decoding them.
+ */
+
+static void BENCHMARK_SampleOverrun(void)
+{
+	static const UINT8 tail[] = { 0x2, 0x0, 0x2, 0xE, 0x4 };
+	UINT32 overruns = lpc_port.sample_overruns;
+	UINT32 counted;
+	BOOL ok;
+	int i;
+
+	LPCEMU_SetBackground(NULL);
+	LPC_ProcessSamples(&lpc_port);
+
+	for(i = 0; i < LPC_SAMPLE_RING_LENGTH; i++)
+	{
+		LPCEMU_Clock(TRUE, 0xF, TRUE, PHASE_IDLE);
+	}
+
+	LPCEMU_Clock(FALSE, 0x0, TRUE, PHASE_START);
+	LPCEMU_Clock(TRUE, 0x2, TRUE, PHASE_CYCTYPE_AND_DIR);
+	LPCEMU_Clock(TRUE, 0xF, TRUE, PHASE_ADDR);
+
+	LPC_ProcessSamples(&lpc_port);
+
+	counted = benchmark_counted;
+
+	for(i = 0; i < (int)sizeof(tail); i++)
+	{
+		LPCEMU_Clock(TRUE, tail[i], TRUE, (i < 3) ? PHASE_ADDR : PHASE_DATA);
+	}
+
+	LPCEMU_Clock(TRUE, 0xF, TRUE, PHASE_TAR);
+
+	for(i = 0; i < 4; i++)
+	{
+		LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_IDLE);
+	}
+
+	LPC_ProcessSamples(&lpc_port);
+
+	ok = (lpc_port.sample_overruns == (overruns + 1)) && (benchmark_counted == counted);
+
+	/* Decoding resumes at the next cycle */
+	LPCEMU_SetBackground(BENCHMARK_ProcessSamples);
+	LPCEMU_IOWrite(BENCHMARK_DEVICE_BASE + 4, 0x00);
+
+	ok = ok && (benchmark_counted == (counted + 1));
+
+	printf("\n%-10s %10s %10s %8s\n", "samples", "overruns", "writes", "after");
+	printf("%-10s %10lu %10lu %8s\n", "mid_frame", (unsigned long)(lpc_port.sample_overruns - overruns),
+		(unsigned long)(benchmark_counted - counted - 1), ok ? "ok" : "FAILED");
+
+	if(!ok) exit(1);
+}
+
+#endif
+
+/* ### Shared GPIO Vector ###
+ *
+ * Another GPIO user with a handler on a pin outside the LPC pin map gets an edge after every LCLK period, pending
+ * together with the next LCLK edge, and every BENCHMARK_DISPATCH_NESTED-th call its handler sees another edge arrive
+ * while it runs (a re-entry). All of its edges have to reach the handler while I/O writes go through, then an edge on
+ * an enabled pin without a handler has to be acknowledged and counted as lost, and the bus has to keep working.
+ */
+
+static UINT16	benchmark_spare_pin;
+static UINT32	benchmark_spare_raised;
+static UINT32	benchmark_spare_served;
+
+static void BENCHMARK_SpareEdge(void *context)
+{
+	benchmark_spare_served += 1;
+
+	if((benchmark_spare_served % BENCHMARK_DISPATCH_NESTED) == 0)
+	{
+		benchmark_spare_raised += 1;
+		LPCEMU_RaiseInterrupt(benchmark_spare_pin);
+	}
+}
+
+static void BENCHMARK_SpareBackground(void)
+{
+#ifdef LPC_DEFERRED_DECODE
+	LPC_ProcessSamples(&lpc_port);
+#endif
+
+	benchmark_spare_raised += 1;
+	LPCEMU_RaiseInterrupt(benchmark_spare_pin);
+}
+
+static void BENCHMARK_Dispatch(long count)
+{
+	UINT16 spare = (UINT16)(GPIO_MASK & ~LPC_SCATTER_PINS(0x7F));
+	UINT16 unclaimed;
+	UINT8 message[BENCHMARK_QUEUE_MESSAGE_LENGTH];
+	UINT8 handled;
+	UINT8 pin;
+	UINT32 lost;
+	BOOL ok;
+	long i;
+
+	for(handled = 0; !(spare & (1 << handled)); handled++);
+
+	pin = handled;
+
+	benchmark_spare_pin = (UINT16)(1 << pin);
+	unclaimed = (UINT16)(spare & ~benchmark_spare_pin & -(spare & ~benchmark_spare_pin));
+	benchmark_spare_raised = 0;
+	benchmark_spare_served = 0;
+
+	for(i = 0; i < BENCHMARK_QUEUE_MESSAGE_LENGTH; i++)
+	{
+		message[i] = (UINT8)(i * 29);
+	}
+
+	GPIO_SetHandler(handled, GPIO_PRIORITY_DEFAULT, BENCHMARK_SpareEdge, NULL);
+
+	(*gpio_interrupt_trigger_mode_register) = benchmark_spare_pin | unclaimed;
+	(*gpio_interrupt_enable_register) = benchmark_spare_pin | unclaimed;
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_IDLE);
+
+	gpio_dispatch_stats.reentries = 0;
+	gpio_dispatch_stats.lost = 0;
+
+	LPCEMU_SetBackground(BENCHMARK_SpareBackground);
+
+	for(i = 0; i < count; i++)
+	{
+		LPCEMU_IOWrite((UINT16)(i & 0xFF), (UINT8)i);
+	}
+
+	ok = BENCHMARK_RoundTrip(message, BENCHMARK_QUEUE_MESSAGE_LENGTH);
+
+#ifdef LPC_DEFERRED_DECODE
+	LPCEMU_SetBackground(BENCHMARK_ProcessSamples);
+#else
+	LPCEMU_SetBackground(NULL);
+#endif
+
+	/* The last edge raised by the background task is still pending */
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_IDLE);
+
+	ok = ok && (benchmark_spare_served == benchmark_spare_raised);
+
+	printf("\n%-10s %12s %12s %12s %10s %6s %8s\n", "dispatch", "pin", "raised", "served", "reentries", "lost", "bus");
+	printf("%-10s %12d %12lu %12lu %10lu %6lu %8s\n", "shared", pin, (unsigned long)benchmark_spare_raised,
+		(unsigned long)benchmark_spare_served, (unsigned long)gpio_dispatch_stats.reentries,
+		(unsigned long)gpio_dispatch_stats.lost, ok ? "ok" : "FAILED");
+
+	if(!ok) exit(1);
+
+	/* Nobody serves the second pin */
+	lost = gpio_dispatch_stats.lost;
+
+	LPCEMU_RaiseInterrupt(unclaimed);
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_IDLE);
+
+	ok = (gpio_dispatch_stats.lost == lost + 1) && (GetInterruptSrcRegister() == 0)
+		&& BENCHMARK_RoundTrip(message, BENCHMARK_QUEUE_MESSAGE_LENGTH);
+
+	for(pin = 0; !(unclaimed & (1 << pin)); pin++);
+
+	printf("%-10s %12d %12d %12d %10lu %6lu %8s\n", "unclaimed", pin, 1, 0, (unsigned long)gpio_dispatch_stats.reentries,
+		(unsigned long)gpio_dispatch_stats.lost, ok ? "ok" : "FAILED");
+
+	if(!ok) exit(1);
+
+	(*gpio_interrupt_disable_register) = benchmark_spare_pin | unclaimed;
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_IDLE);
+
+	GPIO_SetHandler(handled, 0, NULL, NULL);
+}
+
+#ifdef LPC_INSTRUMENT
+
+/* ### Instrumentation Counters ###
+ *
+ * Read the counters over the bus like a host side monitor would, latching (and clearing) a snapshot first.
+ */
+
+static void BENCHMARK_Counters(void)
+{
+	static const char *names[] = {
+		"io_reads", "io_writes", "memory_cycles", "dma_cycles", "aborts", "short_waits", "long_waits",
+		"reads_retried", "reads_pending", "ignored", "acks_passed", "acks_failed", "replies_passed",
+		"replies_failed", "snapshots", "reads_aborted", "resets"
+	};
+	UINT32 counter;
+	UINT8 count;
+	UINT8 data;
+	int i;
+	int j;
+
+	LPCEMU_IOWrite(LPC_COUNTERS_BASE, 1);
+	LPCEMU_IORead(LPC_COUNTERS_BASE, &count);
+
+	printf("\n%-16s %12s\n", "counter", "value");
+
+	for(i = 0; (i < count) && (i < (int)(sizeof(names) / sizeof(names[0]))); i++)
+	{
+		for(counter = 0, j = 0; j < 4; j++)
+		{
+			LPCEMU_IORead((UINT16)(LPC_COUNTERS_BASE + 4 + (i * 4) + j), &data);
+			counter |= (UINT32)data << (j * 8);
+		}
+
+		printf("%-16s %12lu\n", names[i], (unsigned long)counter);
+	}
+}
+
+#endif
+
+/* ### Trace ###
+ *
+ * Cost of a trace record, and the records of a few short message exchanges drained after each one,
+ * dumped to a file for lpc_trace when a name is given.
+ */
+
+static void BENCHMARK_Trace(long count, const char *dump)
+{
+	static DEBUG_RECORD records[1024];
+	UINT8 message[8];
+	UINT8 reply[256];
+	UINT8 *leased;
+	UINT16 length;
+	UINT16 total = 0;
+	double start;
+	double seconds;
+	FILE *file;
+	long i;
+	int j;
+
+	DEBUG_ClearBuffer();
+
+	start = BENCHMARK_Seconds();
+
+	for(i = 0; i < count; i++)
+	{
+		DEBUG_Trace(DEBUG_EVENT_IO_WRITE, 0, (UINT16)i, (UINT32)i);
+
+		if((i & DEBUG_BUFFER_MASK) == DEBUG_BUFFER_MASK) DEBUG_ClearBuffer();
+	}
+
+	seconds = BENCHMARK_Seconds() - start;
+
+	DEBUG_ClearBuffer();
+
+	for(i = 0; i < 4; i++)
+	{
+		for(j = 0; j < (int)sizeof(message); j++)
+		{
+			message[j] = (UINT8)(i + j);
+		}
+
+		BENCHMARK_SendMessage(message, sizeof(message), 0);
+
+		leased = LPC_LeaseIOMessage(&lpc_port_messages, &length);
+		memcpy(LPC_LeaseIOReply(&lpc_port_messages, length), leased, length);
+		LPC_CommitIOReply(&lpc_port_messages, length);
+
+		BENCHMARK_ReceiveMessage(reply);
+
+		total += DEBUG_ReturnBuffer(&records[total], (UINT16)((sizeof(records) / sizeof(records[0])) - total));
+	}
+
+	printf("\n%-10s %12.1f ns/record %10.1f records/message %8lu dropped (level %d)\n", "trace",
+		(seconds * 1e9) / (double)count, (double)total / 4.0, (unsigned long)DEBUG_Dropped(), DEBUG_LEVEL);
+
+	if(dump != NULL)
+	{
+		file = fopen(dump, "wb");
+
+		if(file == NULL)
+		{
+			printf("trace: cannot write %s\n", dump);
+			exit(1);
+		}
+
+		fwrite(records, sizeof(DEBUG_RECORD), total, file);
+		fclose(file);
+	}
+}
+
+/* ### Noisy Bus ###
+ *
+ * The host corrupts every data byte it writes with probability benchmark_error_rate (deterministic sequence).
+ */
+
+static double		benchmark_error_rate;
+static unsigned long	benchmark_random = 1;
+
+static void BENCHMARK_NoisyWrite(UINT16 address, UINT8 data)
+{
+	benchmark_random = (benchmark_random * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+
+	if(((double)benchmark_random / 2147483648.0) < benchmark_error_rate) data ^= 0x10;
+
+	LPCEMU_IOWrite(address, data);
+}
+
+static void BENCHMARK_Retransmit(long count)
+{
+	static const double error_rates[] = { 0, 0.001, 0.005, 0.02 };
+	UINT8 message[255];
+	UINT8 *leased;
+	UINT16 leased_length;
+	UINT64 edges;
+	UINT64 baseline[2];
+	long undetected;
+	UINT16 crc16;
+	UINT8 ack;
+	UINT8 nak;
+	UINT8 length;
+	UINT8 block;
+	long i;
+	int j;
+	int rate;
+	int blocks;
+
+	for(j = 0; j < 255; j++)
+	{
+		message[j] = (UINT8)((j * 57) ^ 0xC3);
+	}
+
+	crc16 = CRC16_Compute(message, 255);
+
+	LPCEMU_IOWrite(MSG_ADDR_OF_INTEGRITY, 1);
+
+	printf("\n%-10s %10s %8s %12s %12s %10s\n", "retransmit", "error/byte", "mode", "clocks/msg", "extra", "undetected");
+
+	for(rate = 0; rate < (int)(sizeof(error_rates) / sizeof(error_rates[0])); rate++)
+	{
+		for(blocks = 0; blocks <= 1; blocks++)
+		{
+			benchmark_error_rate = error_rates[rate];
+			benchmark_random = 1;
+			edges = 0;
+			undetected = 0;
+
+			for(i = 0; i < count; i++)
+			{
+				LPCEMU_ClearStats();
+
+				LPCEMU_IOWrite(MSG_ADDR_OF_LENGTH, 255);
+
+				if(!blocks)
+				{
+					/* Whole message, resent until the CRC-16 passes */
+					do
+					{
+						for(j = 0; j < 255; j++)
+						{
+							BENCHMARK_NoisyWrite((UINT16)j, message[j]);
+						}
+
+						LPCEMU_IOWrite(MSG_ADDR_OF_CRC + 0, (UINT8)(crc16 >> 0));
+						LPCEMU_IOWrite(MSG_ADDR_OF_CRC + 1, (UINT8)(crc16 >> 8));
+						LPCEMU_IORead(MSG_ADDR_OF_ACK, &ack);
+					}
+					while(ack != ACK_PASS);
+				}
+				else
+				{
+					/* One check value per block, only the blocks in the NAK bitmap are resent */
+					nak = 0xFF;
+
+					do
+					{
+						for(block = 0; block < (255 + MSG_BLOCK_LENGTH - 1) / MSG_BLOCK_LENGTH; block++)
+						{
+							if(!(nak & (1 << block))) continue;
+
+							for(j = block * MSG_BLOCK_LENGTH; (j < (block + 1) * MSG_BLOCK_LENGTH) && (j < 255); j++)
+							{
+								BENCHMARK_NoisyWrite((UINT16)j, message[j]);
+							}
+
+							LPCEMU_IOWrite(MSG_ADDR_OF_BLOCK_CHECK + block,
+								CRC8_Compute(&message[block * MSG_BLOCK_LENGTH], ((block + 1) * MSG_BLOCK_LENGTH > 255) ? (255 - block * MSG_BLOCK_LENGTH) : MSG_BLOCK_LENGTH));
+						}
+
+						LPCEMU_IORead(MSG_ADDR_OF_NAK, &nak);
+					}
+					while(nak != 0);
+
+					LPCEMU_IORead(MSG_ADDR_OF_ACK, &ack);
+				}
+
+				edges += lpcemu_stats.edges;
+
+				/* The application answers with an empty reply (not counted) */
+				leased = LPC_LeaseIOMessage(&lpc_port_messages, &leased_length);
+
+				if((ack != ACK_PASS) || (leased == NULL) || (leased_length != 255))
+				{
+					printf("retransmit: message lost\n");
+					exit(1);
+				}
+
+				/* Corruption the check values did not catch */
+				if(memcmp(leased, message, 255)) undetected += 1;
+
+				LPC_LeaseIOReply(&lpc_port_messages, 0);
+				LPC_CommitIOReply(&lpc_port_messages, 0);
+
+				LPCEMU_IORead(MSG_ADDR_OF_LENGTH, &length);
+				LPCEMU_IOWrite(MSG_ADDR_OF_ACK, ACK_PASS);
+			}
+
+			if(rate == 0) baseline[blocks] = edges;
+
+			printf("%-10s %10.3f %8s %12.0f %12.0f %10ld\n", "",
+				benchmark_error_rate,
+				blocks ? "blocks" : "whole",
+				(double)edges / (double)count,
+				(double)(edges - baseline[blocks]) / (double)count,
+				undetected);
+		}
+	}
+
+	LPCEMU_IOWrite(MSG_ADDR_OF_INTEGRITY, 0);
+}
+
+/* ### Master Driver ###
+ *
+ * Round trips through the master library (lpc_master.h) over the loopback transport, the application echoes
+ * every message from the background task as soon as it arrives. Latency and payload bytes per second are bus time
+ * at a 33 MHz LCLK, one way payload per round trip. The noisy rows corrupt data bytes on the way to the slave,
+ * checked with CRC-16 (two corrupted bytes may cancel out in the checksum), the driver resends the pages answered
+ * with ACK_FAIL.
+ */
+
+static UINT8	benchmark_large_rx[BENCHMARK_LARGE_LENGTH];
+static UINT8	benchmark_large_tx[BENCHMARK_LARGE_LENGTH];
+
+static void BENCHMARK_Echo(void)
+{
+	UINT8 *message;
+	UINT8 *reply;
+	UINT16 length;
+
+#ifdef LPC_DEFERRED_DECODE
+	LPC_ProcessSamples(&lpc_port);
+#endif
+
+	message = LPC_LeaseIOMessage(&lpc_port_messages, &length);
+	if(message == NULL) return;
+
+	reply = LPC_LeaseIOReply(&lpc_port_messages, length);
+	if(reply == NULL) return;
+
+	memcpy(reply, message, length);
+	LPC_CommitIOReply(&lpc_port_messages, length);
+}
+
+static BOOL BENCHMARK_NoisyMasterWrite(void *context, UINT16 address, UINT8 data)
+{
+	benchmark_random = (benchmark_random * 1103515245UL + 12345UL) & 0x7FFFFFFFUL;
+
+	if((address < 0x100) && (((double)benchmark_random / 2147483648.0) < benchmark_error_rate)) data ^= 0x10;
+
+	return LPCEMU_IOWrite(address, data);
+}
+
+static void BENCHMARK_Master(long count)
+{
+	static const UINT16 lengths[] = { 1, 16, 64, 255, 1024, BENCHMARK_LARGE_LENGTH };
+	static UINT8 message[BENCHMARK_LARGE_LENGTH];
+	static UINT8 reply[BENCHMARK_LARGE_LENGTH];
+	LPCM_TRANSPORT transport;
+	LPCM_MASTER master;
+	LPCM_STATS stats;
+	UINT16 reply_length;
+	double start;
+	double seconds;
+	double clocks;
+	long trips;
+	long i;
+	int j;
+	int noisy;
+	int size;
+
+	for(j = 0; j < BENCHMARK_LARGE_LENGTH; j++)
+	{
+		message[j] = (UINT8)((j * 29) ^ (j >> 8));
+	}
+
+	LPC_SetIOLargeBuffers(&lpc_port_messages, benchmark_large_rx, benchmark_large_tx, BENCHMARK_LARGE_LENGTH);
+	LPCEMU_SetBackground(BENCHMARK_Echo);
+
+	printf("\n%-10s %8s %10s %14s %14s %10s\n", "master", "bytes", "error", "us/round trip", "bytes/s", "resent");
+
+	for(noisy = 0; noisy <= 1; noisy++)
+	{
+		LPCM_OpenLoopback(&transport);
+		if(noisy) transport.write = BENCHMARK_NoisyMasterWrite;
+
+		LPCM_Initialize(&master, &transport, 0x0000);
+		LPCM_SetIntegrity(&master, noisy ? LPCM_INTEGRITY_CRC16 : LPCM_INTEGRITY_SUM);
+		benchmark_error_rate = noisy ? 0.001 : 0;
+
+		for(size = 0; size < (int)(sizeof(lengths) / sizeof(lengths[0])); size++)
+		{
+			trips = (count * 256) / (lengths[size] + 64) + 1;
+
+			LPCEMU_ClearStats();
+			start = BENCHMARK_Seconds();
+
+			for(i = 0; i < trips; i++)
+			{
+				if(!LPCM_Transact(&master, message, lengths[size], reply, BENCHMARK_LARGE_LENGTH, &reply_length)
+					|| (reply_length != lengths[size]) || memcmp(message, reply, reply_length))
+				{
+					printf("master: round trip of %u bytes failed\n", (unsigned)lengths[size]);
+					exit(1);
+				}
+			}
+
+			seconds = BENCHMARK_Seconds() - start;
+			clocks = (double)lpcemu_stats.edges / (double)trips;
+
+			LPCM_GetStats(&master, &stats, TRUE);
+
+			printf("%-10s %8u %10.3f %14.2f %14.0f %10lu\n", "",
+				(unsigned)lengths[size],
+				benchmark_error_rate,
+				(clocks * 1e6) / BENCHMARK_LCLK_HZ,
+				((double)lengths[size] * BENCHMARK_LCLK_HZ) / clocks,
+				(unsigned long)stats.resent);
+		}
+
+		if(!noisy) printf("%-10s %10.1f ns/round trip emulated (%u bytes)\n", "", (seconds * 1e9) / (double)trips, (unsigned)lengths[size - 1]);
+
+		LPCM_SetIntegrity(&master, LPCM_INTEGRITY_SUM);
+		LPCM_Close(&transport);
+	}
+
+#ifdef LPC_DEFERRED_DECODE
+	LPCEMU_SetBackground(BENCHMARK_ProcessSamples);
+#else
+	LPCEMU_SetBackground(NULL);
+#endif
+	LPC_SetIOLargeBuffers(&lpc_port_messages, NULL, NULL, 0);
+}
+
+#if !defined(LPC_TABLE_DECODER) && !defined(LPC_DEFERRED_DECODE)
+
+static void BENCHMARK_Bulk(long transfers)
+{
+	static UINT8 memory[BENCHMARK_BULK_LENGTH];
+	static UINT8 payload[BENCHMARK_BULK_LENGTH];
+	long i;
+	int j;
+	double start;
+	double seconds;
+
+	for(j = 0; j < BENCHMARK_BULK_LENGTH; j++)
+	{
+		memory[j] = (UINT8)(j * 7);
+	}
+
+	LPC_SetFirmwareMemory(&lpc_port, 0x0, BENCHMARK_FWH_BASE, memory, BENCHMARK_BULK_LENGTH, FALSE);
+
+	printf("\n%-10s %12s %14s\n", "bulk", "clocks/byte", "bytes/s");
+
+	/* One I/O read per byte */
+
+	LPCEMU_ClearStats();
+	start = BENCHMARK_Seconds();
+
+	for(i = 0; i < transfers; i++)
+	{
+		for(j = 0; j < BENCHMARK_BULK_LENGTH; j++)
+		{
+			LPCEMU_IORead((UINT16)j, &payload[j]);
+		}
+	}
+
+	seconds = BENCHMARK_Seconds() - start;
+
+	printf("%-10s %12.2f %14.0f\n", "io_read",
+		(double)lpcemu_stats.edges / ((double)transfers * BENCHMARK_BULK_LENGTH),
+		((double)transfers * BENCHMARK_BULK_LENGTH) / seconds);
+
+	/* 128 byte Firmware Memory bursts */
+
+	LPCEMU_ClearStats();
+	start = BENCHMARK_Seconds();
+
+	for(i = 0; i < transfers; i++)
+	{
+		for(j = 0; j < BENCHMARK_BULK_LENGTH; j += 128)
+		{
+			LPCEMU_FirmwareRead(0x0, BENCHMARK_FWH_BASE + j, 0x7, &payload[j]);
+		}
+	}
+
+	seconds = BENCHMARK_Seconds() - start;
+
+	for(j = 0; j < BENCHMARK_BULK_LENGTH; j++)
+	{
+		if(payload[j] != memory[j])
+		{
+			printf("fwh_read: unexpected data 0x%02X at 0x%02X\n", payload[j], j);
+			exit(1);
+		}
+	}
+
+	printf("%-10s %12.2f %14.0f\n", "fwh_read",
+		(double)lpcemu_stats.edges / ((double)transfers * BENCHMARK_BULK_LENGTH),
+		((double)transfers * BENCHMARK_BULK_LENGTH) / seconds);
+
+	LPC_SetFirmwareMemory(&lpc_port, 0x0, 0, NULL, 0, FALSE);
+}
+
+#endif
+
+#ifdef GPIO_COUNT_ACCESSES
+
+/* ### GPIO Accesses ###
+ *
+ * Loads and stores of the slave to its GPIO bank per bus cycle (see gpio_backend.h), for the backend built. The reply
+ * queued for the I/O read benchmarks is read back, ignored cycles go to an address no decode window claims.
+ */
+
+#if defined(GPIO_SHADOW_BACKEND)
+#define BENCHMARK_GPIO_BACKEND		"shadow"
+#elif defined(GPIO_EMULATED_BACKEND)
+#define BENCHMARK_GPIO_BACKEND		"emulated"
+#else
+#define BENCHMARK_GPIO_BACKEND		"direct"
+#endif
+
+static void BENCHMARK_Accesses(long count)
+{
+	static const char *names[] = { "io_write", "io_read", "ignored" };
+	GPIO_ACCESSES start;
+	UINT64 edges;
+	UINT8 data;
+	long i;
+	int type;
+
+	printf("\n%-10s %12s %12s %12s   %s backend\n", "mmio", "edges/cycle", "loads/cycle", "stores/cycle", BENCHMARK_GPIO_BACKEND);
+
+	for(type = 0; type < 3; type++)
+	{
+		LPCEMU_ClearStats();
+		start = gpio_accesses;
+
+		for(i = 0; i < count; i++)
+		{
+			switch(type)
+			{
+				case 0: LPCEMU_IOWrite((UINT16)(i & 0xFF), (UINT8)i); break;
+				case 1: LPCEMU_IORead((UINT16)(i % BENCHMARK_REPLY_LENGTH), &data); break;
+				case 2: LPCEMU_IOWrite(0x03F8, (UINT8)i); break;
+			}
+		}
+
+		edges = lpcemu_stats.edges;
+
+		printf("%-10s %12.2f %12.2f %12.2f\n", names[type], (double)edges / (double)count,
+			(double)(gpio_accesses.loads - start.loads) / (double)count,
+			(double)(gpio_accesses.stores - start.stores) / (double)count);
+	}
+}
+
+#endif
+
+#define BENCHMARK_TRANSFER_IO		(0)	// One address per data byte
+#define BENCHMARK_TRANSFER_FIFO		(1)	// String I/O on the FIFO port
+#define BENCHMARK_TRANSFER_DMA		(2)	// 32-bit DMA cycles, switch decoder only
+
+static void BENCHMARK_Transfer(int mode, BOOL to_peripheral, UINT8 *message, UINT8 length)
+{
+	UINT8 i = 0;
+	BOOL dma = (mode == BENCHMARK_TRANSFER_DMA);
+	BOOL more;
+
+	if(mode == BENCHMARK_TRANSFER_FIFO)
+	{
+		if(to_peripheral)
+			LPCEMU_IOWriteString(MSG_ADDR_OF_FIFO, message, length);
+		else
+			LPCEMU_IOReadString(MSG_ADDR_OF_FIFO, message, length);
+
+		return;
+	}
+
+	if(dma)
+	{
+		for(; (length - i) >= 4; i += 4)
+		{
+			if(to_peripheral)
+				LPCEMU_DMARead(BENCHMARK_DMA_CHANNEL, FALSE, 0x3, &message[i], &more);
+			else
+				LPCEMU_DMAWrite(BENCHMARK_DMA_CHANNEL, FALSE, 0x3, &message[i], &more);
+		}
+	}
+
+	for(; i < length; i++)
+	{
+		if(dma && to_peripheral)
+			LPCEMU_DMARead(BENCHMARK_DMA_CHANNEL, FALSE, 0x0, &message[i], &more);
+		else if(dma)
+			LPCEMU_DMAWrite(BENCHMARK_DMA_CHANNEL, FALSE, 0x0, &message[i], &more);
+		else if(to_peripheral)
+			LPCEMU_IOWrite(i, message[i]);
+		else
+			LPCEMU_IORead(i, &message[i]);
+	}
+}
+
+/* One byte more than the message through the FIFO port in both directions: the extra write has to be dropped and the
+ * extra read refused (the host aborts it), with the stream pointer and the checksum as they were, then the exchange
+ * has to complete as if it had not happened.
+ */
+static void BENCHMARK_FifoOverrun(void)
+{
+	static const char *names[] = { "fifo_write", "fifo_read" };
+	UINT8 sent[BENCHMARK_REPLY_LENGTH + 1];
+	UINT8 received[BENCHMARK_REPLY_LENGTH + 1];
+	UINT8 pointer[2];
+	UINT8 checksum[2];
+	UINT8 length;
+	UINT8 ack;
+	UINT8 at[2];
+	BOOL kept[2];
+	BOOL ok[2];
+	int j;
+
+	for(j = 0; j <= BENCHMARK_REPLY_LENGTH; j++)
+	{
+		sent[j] = (UINT8)((j * 7) ^ 0xC3);
+	}
+
+	/* Host sends the message and one byte more */
+	LPCEMU_IOWrite(MSG_ADDR_OF_LENGTH, BENCHMARK_REPLY_LENGTH);
+	LPCEMU_IOWriteString(MSG_ADDR_OF_FIFO, sent, BENCHMARK_REPLY_LENGTH);
+	LPCEMU_IORead(MSG_ADDR_OF_FIFO_POINTER, &pointer[0]);
+	LPCEMU_IORead(MSG_ADDR_OF_CHECKSUM, &checksum[0]);
+	LPCEMU_IOWrite(MSG_ADDR_OF_FIFO, sent[BENCHMARK_REPLY_LENGTH]);
+	LPCEMU_IORead(MSG_ADDR_OF_FIFO_POINTER, &pointer[1]);
+	LPCEMU_IORead(MSG_ADDR_OF_CHECKSUM, &checksum[1]);
+	LPCEMU_IOWrite(MSG_ADDR_OF_CHECKSUM, BENCHMARK_Checksum(sent, BENCHMARK_REPLY_LENGTH));
+	LPCEMU_IORead(MSG_ADDR_OF_ACK, &ack);
+
+	ok[0] = (pointer[0] == BENCHMARK_REPLY_LENGTH) && (pointer[1] == pointer[0]) && (checksum[1] == checksum[0])
+		&& (ack == ACK_PASS)
+		&& LPC_GetIOMessage(&lpc_port_messages, received, &length)
+		&& (length == BENCHMARK_REPLY_LENGTH) && (memcmp(received, sent, length) == 0);
+
+	at[0] = pointer[1];
+	kept[0] = (checksum[1] == checksum[0]);
+
+	/* Host reads the echo and one byte more */
+	LPC_SetIOMessage(&lpc_port_messages, sent, BENCHMARK_REPLY_LENGTH);
+
+	LPCEMU_IORead(MSG_ADDR_OF_LENGTH, &length);
+	LPCEMU_IOReadString(MSG_ADDR_OF_FIFO, received, length);
+	LPCEMU_IORead(MSG_ADDR_OF_FIFO_POINTER, &pointer[0]);
+	LPCEMU_IORead(MSG_ADDR_OF_CHECKSUM, &checksum[0]);
+
+	ok[1] = !LPCEMU_IORead(MSG_ADDR_OF_FIFO, &received[BENCHMARK_REPLY_LENGTH]);
+
+	LPCEMU_IORead(MSG_ADDR_OF_FIFO_POINTER, &pointer[1]);
+	LPCEMU_IORead(MSG_ADDR_OF_CHECKSUM, &checksum[1]);
+
+	ok[1] = ok[1] && (length == BENCHMARK_REPLY_LENGTH) && (pointer[0] == BENCHMARK_REPLY_LENGTH) && (pointer[1] == pointer[0])
+		&& (checksum[0] == BENCHMARK_Checksum(sent, BENCHMARK_REPLY_LENGTH)) && (checksum[1] == checksum[0])
+		&& (memcmp(received, sent, BENCHMARK_REPLY_LENGTH) == 0);
+
+	at[1] = pointer[1];
+	kept[1] = (checksum[1] == checksum[0]);
+
+	LPCEMU_IOWrite(MSG_ADDR_OF_ACK, ACK_PASS);
+
+	printf("\n%-10s %8s %9s %8s\n", "overrun", "pointer", "checksum", "after");
+
+	for(j = 0; j < 2; j++)
+	{
+		printf("%-10s %8d %9s %8s\n", names[j], at[j], kept[j] ? "kept" : "changed", ok[j] ? "ok" : "FAILED");
+	}
+
+	if(!ok[0] || !ok[1]) exit(1);
+}
+
+static void BENCHMARK_Messages(long count)
+{
+	static const char *names[] = { "io", "fifo", "dma" };
+	static UINT8 sent[255];
+	static UINT8 received[255];
+	UINT8 buffer[255];
+	UINT8 length;
+	UINT8 ack;
+	UINT8 checksum;
+	long i;
+	int j;
+	int mode;
+	double start;
+	double seconds;
+
+	for(j = 0; j < 255; j++)
+	{
+		sent[j] = (UINT8)(j ^ 0x5A);
+	}
+
+	LPC_SetDMAChannel(&lpc_port, BENCHMARK_DMA_CHANNEL);
+
+	printf("\n%-10s %12s %14s\n", "message", "clocks/msg", "round trips/s");
+
+#if !defined(LPC_TABLE_DECODER) && !defined(LPC_DEFERRED_DECODE)
+	for(mode = BENCHMARK_TRANSFER_IO; mode <= BENCHMARK_TRANSFER_DMA; mode++)
+#else
+	for(mode = BENCHMARK_TRANSFER_IO; mode <= BENCHMARK_TRANSFER_FIFO; mode++)
+#endif
+	{
+		LPCEMU_ClearStats();
+		start = BENCHMARK_Seconds();
+
+		for(i = 0; i < count; i++)
+		{
+			/* Host sends the message */
+			LPCEMU_IOWrite(MSG_ADDR_OF_LENGTH, 255);
+			BENCHMARK_Transfer(mode, TRUE, sent, 255);
+			LPCEMU_IOWrite(MSG_ADDR_OF_CHECKSUM, BENCHMARK_Checksum(sent, 255));
+			LPCEMU_IORead(MSG_ADDR_OF_ACK, &ack);
+
+			/* Application echoes it */
+			LPC_GetIOMessage(&lpc_port_messages, buffer, &length);
+			LPC_SetIOMessage(&lpc_port_messages, buffer, length);
+
+			/* Host receives the echo */
+			LPCEMU_IORead(MSG_ADDR_OF_LENGTH, &length);
+			BENCHMARK_Transfer(mode, FALSE, received, length);
+			LPCEMU_IORead(MSG_ADDR_OF_CHECKSUM, &checksum);
+			LPCEMU_IOWrite(MSG_ADDR_OF_ACK, ACK_PASS);
+
+			if((ack != ACK_PASS) || (length != 255) || (checksum != BENCHMARK_Checksum(received, length)) || memcmp(sent, received, 255))
+			{
+				printf("%s: echo failed\n", names[mode]);
+				exit(1);
+			}
+		}
+
+		seconds = BENCHMARK_Seconds() - start;
+
+		printf("%-10s %12.0f %14.0f\n", names[mode],
+			(double)lpcemu_stats.edges / (double)count,
+			(double)count / seconds);
+	}
+
+	LPC_SetDMAChannel(&lpc_port, 0xFF);
+}
+
+int main(int argc, char *argv[])
+{
+	long cycles = BENCHMARK_DEFAULT_CYCLES;
+	long i;
+	int j;
+	double start;
+	double seconds;
+	UINT16 replay[BENCHMARK_REPLAY_LENGTH];
+	UINT32 replay_length;
+	UINT8 data;
+	int phase;
+
+	if(argc > 1)
+	{
+		cycles = atol(argv[1]);
+	}
+
+	LPCEMU_Initialize();
+
+#ifdef LPC_DEFERRED_DECODE
+	LPCEMU_SetBackground(BENCHMARK_ProcessSamples);
+#endif
+
+	BENCHMARK_QueueReply();
+
+	/* ### I/O Write ### */
+
+	LPCEMU_ClearStats();
+	start = BENCHMARK_Seconds();
+
+	for(i = 0; i < cycles; i++)
+	{
+		LPCEMU_IOWrite((UINT16)(i & 0xFF), (UINT8)i);
+	}
+
+	BENCHMARK_Report("io_write", BENCHMARK_Seconds() - start);
+
+	/* ### I/O Read ### */
+
+	LPCEMU_ClearStats();
+	start = BENCHMARK_Seconds();
+
+	for(i = 0; i < cycles; i++)
+	{
+		if(!LPCEMU_IORead((UINT16)(i % BENCHMARK_REPLY_LENGTH), &data) || (data != (UINT8)(i % BENCHMARK_REPLY_LENGTH)))
+		{
+			printf("io_read: unexpected data 0x%02X at 0x%04lX\n", data, i % BENCHMARK_REPLY_LENGTH);
+			return 1;
+		}
+	}
+
+	BENCHMARK_Report("io_read", BENCHMARK_Seconds() - start);
+
+	/* ### Per Phase Cost ### */
+
+	LPCEMU_ClearStats();
+	LPCEMU_SetProfiling(TRUE);
+
+	for(i = 0; i < cycles; i++)
+	{
+		LPCEMU_IOWrite((UINT16)(i & 0xFF), (UINT8)i);
+		LPCEMU_IORead((UINT16)(i & 0xFF), &data);
+	}
+
+	LPCEMU_SetProfiling(FALSE);
+
+	printf("\n%-16s %12s %10s\n", "phase", "edges", "ns/edge");
+
+	for(phase = 0; phase < PHASE_COUNT; phase++)
+	{
+		if(lpcemu_stats.phase_edges[phase] == 0) continue;
+
+		printf("%-16s %12llu %10.1f\n",
+			LPCEMU_PhaseName((LPCEMU_PHASE)phase),
+			(unsigned long long)lpcemu_stats.phase_edges[phase],
+			(double)lpcemu_stats.phase_ns[phase] / (double)lpcemu_stats.phase_edges[phase]);
+	}
+
+	/* ### Decoder Only ### */
+
+	LPCEMU_Record(replay, BENCHMARK_REPLAY_LENGTH);
+	LPCEMU_IOWrite(0x0000, 0x69);
+	LPCEMU_IORead(0x0000, &data);
+	replay_length = LPCEMU_Recorded();
+	LPCEMU_Record(NULL, 0);
+
+	start = BENCHMARK_Seconds();
+
+	for(i = 0; i < cycles; i++)
+	{
+		for(j = 0; j < (int)replay_length; j++)
+		{
+			(*gpio_data_register) = replay[j];
+			LPC_HandleCycle(&lpc_port);
+		}
+
+#ifdef LPC_DEFERRED_DECODE
+		LPC_ProcessSamples(&lpc_port);
+#endif
+	}
+
+	seconds = BENCHMARK_Seconds() - start;
+
+	LPCEMU_DiscardWrites();
+
+	printf("\n%-10s %12.0f edges/s %10.1f ns/edge\n",
+		"decoder",
+		((double)cycles * replay_length) / seconds,
+		(seconds * 1e9) / ((double)cycles * replay_length));
+
+#ifdef GPIO_COUNT_ACCESSES
+	BENCHMARK_Accesses(cycles / 4 + 1);
+#endif
+
+#if !defined(LPC_TABLE_DECODER) && !defined(LPC_DEFERRED_DECODE)
+	BENCHMARK_Bulk(cycles / BENCHMARK_BULK_LENGTH + 1);
+#endif
+
+	/* Release the reply queued for the I/O read benchmarks */
+	LPCEMU_IOWrite(MSG_ADDR_OF_ACK, ACK_PASS);
+
+	BENCHMARK_Messages(cycles / (4 * BENCHMARK_BULK_LENGTH) + 1);
+	BENCHMARK_FifoOverrun();
+
+	BENCHMARK_Queue(cycles / (16 * BENCHMARK_BULK_LENGTH) + 1);
+	BENCHMARK_Lease(cycles / (4 * BENCHMARK_BULK_LENGTH) + 1);
+	BENCHMARK_Integrity(cycles / 4 + 1);
+	BENCHMARK_Large(cycles / (16 * BENCHMARK_BULK_LENGTH) + 1);
+	BENCHMARK_Retransmit(cycles / (4 * BENCHMARK_BULK_LENGTH) + 1);
+	BENCHMARK_Master(cycles / (16 * BENCHMARK_BULK_LENGTH) + 1);
+	BENCHMARK_Compression(cycles / (16 * BENCHMARK_BULK_LENGTH) + 1);
+	BENCHMARK_Devices(cycles * 16);
+	BENCHMARK_Decode(cycles / 4 + 1);
+	BENCHMARK_Recovery();
+#ifdef LPC_DEFERRED_DECODE
+	BENCHMARK_SampleOverrun();
+#endif
+	BENCHMARK_Dispatch(cycles / 4 + 1);
+
+#ifdef LPC_INSTRUMENT
+	BENCHMARK_Counters();
+#endif
+
+	BENCHMARK_Trace(cycles * 4, (argc > 2) ? argv[2] : NULL);
+
+	return 0;
+}
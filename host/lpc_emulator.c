@@ -0,0 +1,702 @@
+#include <time.h>
+
+#include "lpc_emulator.h"
+#include "gpio.h"
+#include "interrupt.h"
+
+/* ### GPIO Register Bank Emulation ###
+ *
+ * The firmware only ever stores to the set/clear registers and loads from the data and status registers,
+ * so every register cell acts as a write latch: after the firmware has run, LPCEMU_LatchWrites folds the
+ * latched values into the emulated pin state and empties the latches again.
+ *
+ * The data register is both the pin input and the "set" half of the output latch. Bit 15 is not a GPIO pin
+ * (see GPIO_MASK), so the emulator keeps it set in the sampled value, if it is cleared the firmware has written
+ * the register. Writes are folded in the order the firmware issues them (set then clear, see GPIO_WritePins), the
+ * masked data register of the emulated backend last. The interrupt status register is the exception, the dispatcher
+ * reads it back after acknowledging pins (see GPIO_Acknowledge).
+ */
+
+#define GPIO_EMULATED_SAMPLE_MARKER	(0x8000)
+
+volatile UINT16	gpio_emulated_registers[GPIO_REGISTER_BANK_SIZE / sizeof(UINT16)] __attribute__((aligned(4)));
+P_ISR_FUNCTION	gpio_emulated_isr_table[32];
+
+LPCEMU_STATS	lpcemu_stats;
+
+static BOOL		lpcemu_profiling = FALSE;
+
+static UINT8		lpcemu_sync;			// Last ready sync sampled, 0000b or 1001b (DMA ready more)
+static BOOL		lpcemu_reset = FALSE;		// LRESET driven low
+
+static void		(*lpcemu_background)(void);
+
+static UINT16 *		lpcemu_record;
+static UINT32		lpcemu_record_capacity;
+static UINT32		lpcemu_record_length;
+
+static INTERRUPT_MASK	lpcemu_interrupt_mask;		// Interrupt controller enables
+
+static UINT16		lpcemu_pins;			// Pin levels as seen by the GPIO module
+static UINT16		lpcemu_dir;			// Output enables
+static UINT16		lpcemu_output;			// Output latch
+static UINT16		lpcemu_interrupt_enable;
+static UINT16		lpcemu_interrupt_status;
+static UINT16		lpcemu_trigger_mode;
+static UINT16		lpcemu_active_mode;
+
+/**************************************/
+/* ##### ##### Interrupts ##### ##### */
+/**************************************/
+
+void EnableInterruptRegister(const INTERRUPT_MASK mask)
+{
+	lpcemu_interrupt_mask |= mask;
+}
+
+INTERRUPT_MASK GetInterruptRegister(void)
+{
+	return lpcemu_interrupt_mask;
+}
+
+void DisableInterruptRegister(const INTERRUPT_MASK mask)
+{
+	lpcemu_interrupt_mask &= ~mask;
+}
+
+INTERRUPT_MASK GetInterruptSrcRegister(void)
+{
+	return (lpcemu_interrupt_status & GPIO_MASK) ? INTR_GPIO : 0;
+}
+
+INTERRUPT_MASK GetInterruptMaskRegister(void)
+{
+	return GetInterruptSrcRegister() & lpcemu_interrupt_mask;
+}
+
+INTERRUPT_MASK GetInterruptIndexRegister(void)
+{
+	return (GetInterruptMaskRegister() & INTR_GPIO) ? INTR_INDEX_10 : 0;
+}
+
+/*************************************/
+/* ##### ##### Registers ##### ##### */
+/*************************************/
+
+static void LPCEMU_PublishRegisters(void)
+{
+	(*gpio_data_register) = lpcemu_pins | GPIO_EMULATED_SAMPLE_MARKER;
+	(*gpio_interrupt_status_register) = lpcemu_interrupt_status;
+}
+
+static void LPCEMU_ClearLatches(void)
+{
+	(*gpio_dir_register) = 0;
+	(*gpio_dir_clear_register) = 0;
+	(*gpio_data_clear_register) = 0;
+	(*gpio_interrupt_enable_register) = 0;
+	(*gpio_interrupt_disable_register) = 0;
+	(*gpio_interrupt_status_clear_register) = 0;
+	(*gpio_interrupt_trigger_mode_register) = 0;
+	(*gpio_interrupt_trigger_mode_clear_register) = 0;
+	(*gpio_interrupt_active_mode_register) = 0;
+	(*gpio_interrupt_active_mode_clear_register) = 0;
+	GPIO_MASKED_REGISTER(gpio_bank) = 0;
+
+	LPCEMU_PublishRegisters();
+}
+
+static void LPCEMU_LatchWrites(void)
+{
+	UINT16 data = (*gpio_data_register);
+	UINT32 masked = GPIO_MASKED_REGISTER(gpio_bank);
+
+	if(!(data & GPIO_EMULATED_SAMPLE_MARKER))
+	{
+		lpcemu_output |= data;
+	}
+	lpcemu_output &= ~(*gpio_data_clear_register);
+	lpcemu_output = (UINT16)((lpcemu_output & ~(masked >> 16)) | (masked & (masked >> 16)));
+
+	lpcemu_dir |= (*gpio_dir_register);
+	lpcemu_dir &= ~(*gpio_dir_clear_register);
+
+	lpcemu_interrupt_enable &= ~(*gpio_interrupt_disable_register);
+	lpcemu_interrupt_enable |= (*gpio_interrupt_enable_register);
+
+	lpcemu_trigger_mode |= (*gpio_interrupt_trigger_mode_register);
+	lpcemu_trigger_mode &= ~(*gpio_interrupt_trigger_mode_clear_register);
+
+	lpcemu_active_mode |= (*gpio_interrupt_active_mode_register);
+	lpcemu_active_mode &= ~(*gpio_interrupt_active_mode_clear_register);
+
+	/* GPIO_Acknowledge also clears the status the ISR reads back, that covers the stores of earlier dispatch passes */
+	lpcemu_interrupt_status &= (*gpio_interrupt_status_register) & ~(*gpio_interrupt_status_clear_register);
+
+	LPCEMU_ClearLatches();
+}
+
+static void LPCEMU_SetPins(UINT16 pins)
+{
+	UINT16 falling = lpcemu_pins & ~pins;
+	UINT16 rising = ~lpcemu_pins & pins;
+
+	UINT16 edges = (falling & ~lpcemu_active_mode) | (rising & lpcemu_active_mode);
+	UINT16 levels = (~pins & ~lpcemu_active_mode) | (pins & lpcemu_active_mode);
+
+	lpcemu_interrupt_status |= lpcemu_interrupt_enable & ((edges & lpcemu_trigger_mode) | (levels & ~lpcemu_trigger_mode));
+	lpcemu_interrupt_status &= GPIO_MASK;
+
+	lpcemu_pins = pins;
+
+	LPCEMU_PublishRegisters();
+}
+
+static UINT64 LPCEMU_Now(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((UINT64)now.tv_sec * 1000000000ULL) + (UINT64)now.tv_nsec;
+}
+
+static void LPCEMU_Dispatch(LPCEMU_PHASE phase)
+{
+	P_ISR_FUNCTION isr = gpio_emulated_isr_table[INTR_INDEX_10];
+	UINT64 start;
+
+	if(!lpcemu_interrupt_status) return;
+	if(!(lpcemu_interrupt_mask & INTR_GPIO)) return;
+	if(isr == NULL) return;
+
+	if(lpcemu_record_length < lpcemu_record_capacity)
+	{
+		lpcemu_record[lpcemu_record_length++] = lpcemu_pins;
+	}
+
+	if(lpcemu_profiling)
+	{
+		start = LPCEMU_Now();
+		isr();
+		lpcemu_stats.phase_ns[phase] += LPCEMU_Now() - start;
+	}
+	else
+	{
+		isr();
+	}
+
+	lpcemu_stats.edges += 1;
+	lpcemu_stats.phase_edges[phase] += 1;
+
+	LPCEMU_LatchWrites();
+}
+
+/*************************************/
+/* ##### ##### Functions ##### ##### */
+/*************************************/
+
+void LPCEMU_Initialize(void)
+{
+	int i;
+
+	for(i = 0; i < (int)(GPIO_REGISTER_BANK_SIZE / sizeof(UINT16)); i++)
+	{
+		gpio_emulated_registers[i] = 0;
+	}
+
+	for(i = 0; i < 32; i++)
+	{
+		gpio_emulated_isr_table[i] = NULL;
+	}
+
+	lpcemu_interrupt_mask = 0;
+
+	lpcemu_dir = 0;
+	lpcemu_output = 0;
+	lpcemu_interrupt_enable = 0;
+	lpcemu_interrupt_status = 0;
+	lpcemu_trigger_mode = 0;
+	lpcemu_active_mode = 0;
+
+	/* Bus idle: LCLK high, LRESET and LFRAME inactive (high), LAD pulled up */
+	lpcemu_pins = LPC_SCATTER_PINS(LPCEMU_LCLK_MASK | LPCEMU_LRESET_MASK | LPCEMU_LFRAME_MASK | LPCEMU_LAD_MASK);
+	LPCEMU_PublishRegisters();
+
+	/* Boot the firmware exactly like the target does */
+	GPIO_Initialize();
+	LPCEMU_LatchWrites();
+
+	EnableInterruptRegister(INTR_GPIO);
+
+	LPCEMU_ClearStats();
+}
+
+void LPCEMU_SetProfiling(BOOL enabled)
+{
+	lpcemu_profiling = enabled;
+}
+
+void LPCEMU_ClearStats(void)
+{
+	int i;
+
+	lpcemu_stats.edges = 0;
+	lpcemu_stats.cycles = 0;
+	lpcemu_stats.aborts = 0;
+	lpcemu_stats.contentions = 0;
+
+	for(i = 0; i < PHASE_COUNT; i++)
+	{
+		lpcemu_stats.phase_edges[i] = 0;
+		lpcemu_stats.phase_ns[i] = 0;
+	}
+}
+
+void LPCEMU_SetReset(BOOL asserted)
+{
+	lpcemu_reset = asserted;
+}
+
+UINT8 LPCEMU_DrivenLAD(void)
+{
+	return (UINT8)(LPC_GATHER_PINS(lpcemu_dir) & LPCEMU_LAD_MASK);
+}
+
+void LPCEMU_SetBackground(void (*task)(void))
+{
+	lpcemu_background = task;
+}
+
+void LPCEMU_Record(UINT16 *buffer, UINT32 capacity)
+{
+	lpcemu_record = buffer;
+	lpcemu_record_capacity = (buffer == NULL) ? 0 : capacity;
+	lpcemu_record_length = 0;
+}
+
+UINT32 LPCEMU_Recorded(void)
+{
+	return lpcemu_record_length;
+}
+
+void LPCEMU_RaiseInterrupt(UINT16 pins)
+{
+	lpcemu_interrupt_status |= pins & lpcemu_interrupt_enable & GPIO_MASK;
+
+	(*gpio_interrupt_status_register) |= pins & lpcemu_interrupt_enable & GPIO_MASK;
+}
+
+void LPCEMU_DiscardWrites(void)
+{
+	LPCEMU_ClearLatches();
+}
+
+const char *LPCEMU_PhaseName(LPCEMU_PHASE phase)
+{
+	switch(phase)
+	{
+		case PHASE_IDLE:		return "IDLE";
+		case PHASE_START:		return "START";
+		case PHASE_CYCTYPE_AND_DIR:	return "CYCTYPE_AND_DIR";
+		case PHASE_ADDR:		return "ADDR";
+		case PHASE_DATA:		return "DATA";
+		case PHASE_TAR:			return "TAR";
+		case PHASE_SYNC:		return "SYNC";
+		case PHASE_ABORT:		return "ABORT";
+		default:			return "?";
+	}
+}
+
+UINT8 LPCEMU_Clock(BOOL lframe, UINT8 lad, BOOL host_drives, LPCEMU_PHASE phase)
+{
+	UINT8 slave_enable = (UINT8)(LPC_GATHER_PINS(lpcemu_dir) & LPCEMU_LAD_MASK);
+	UINT8 bus;
+	UINT8 pins;
+
+	/* Rising edge: the host drives LFRAME and (possibly) LAD, the peripheral may still be driving LAD */
+
+	bus = LPCEMU_LAD_MASK;
+
+	if(host_drives)
+	{
+		bus &= lad;
+
+		if(slave_enable)
+		{
+			lpcemu_stats.contentions += 1;
+		}
+	}
+
+	bus &= (UINT8)((LPC_GATHER_PINS(lpcemu_output) | ~slave_enable) & LPCEMU_LAD_MASK);
+
+	pins = lpcemu_reset ? bus : (LPCEMU_LRESET_MASK | bus);
+
+	if(lframe)
+	{
+		pins |= LPCEMU_LFRAME_MASK;
+	}
+
+	LPCEMU_SetPins(LPC_SCATTER_PINS(pins | LPCEMU_LCLK_MASK));
+
+	/* Falling edge: the peripheral samples and reacts */
+
+	LPCEMU_SetPins(LPC_SCATTER_PINS(pins));
+	LPCEMU_Dispatch(phase);
+
+	if(lpcemu_background != NULL)
+	{
+		lpcemu_background();
+		LPCEMU_LatchWrites();
+	}
+
+	/* What the host will sample on the next rising edge */
+
+	slave_enable = (UINT8)(LPC_GATHER_PINS(lpcemu_dir) & LPCEMU_LAD_MASK);
+
+	bus = host_drives ? (lad & LPCEMU_LAD_MASK) : LPCEMU_LAD_MASK;
+	bus &= (UINT8)((LPC_GATHER_PINS(lpcemu_output) | ~slave_enable) & LPCEMU_LAD_MASK);
+
+	return bus;
+}
+
+/**************************************/
+/* ##### ##### Bus Driver ##### ##### */
+/**************************************/
+
+static void LPCEMU_Start(UINT8 start)
+{
+	/* One clock, as a chipset drives it (the slave takes the frame from the last clock that LFRAME is low) */
+	LPCEMU_Clock(FALSE, start, TRUE, PHASE_START);
+}
+
+static void LPCEMU_Abort(void)
+{
+	int i;
+
+	/* LFRAME low with 1111b on LAD for at least four clocks, then one idle clock */
+	for(i = 0; i < 4; i++)
+	{
+		LPCEMU_Clock(FALSE, 0xF, TRUE, PHASE_ABORT);
+	}
+
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_ABORT);
+
+	lpcemu_stats.aborts += 1;
+}
+
+static void LPCEMU_Header(UINT16 address, BOOL write)
+{
+	/* CYCTYPE = I/O (00b), DIR in bit 1 */
+	LPCEMU_Clock(TRUE, write ? 0x2 : 0x0, TRUE, PHASE_CYCTYPE_AND_DIR);
+
+	/* Address, most significant nibble first */
+	LPCEMU_Clock(TRUE, (address >> 12) & 0xF, TRUE, PHASE_ADDR);
+	LPCEMU_Clock(TRUE, (address >> 8) & 0xF, TRUE, PHASE_ADDR);
+	LPCEMU_Clock(TRUE, (address >> 4) & 0xF, TRUE, PHASE_ADDR);
+	LPCEMU_Clock(TRUE, (address >> 0) & 0xF, TRUE, PHASE_ADDR);
+}
+
+/* Returns the LAD value sampled after the SYNC READY clock, or 0xFF if the host aborted */
+static UINT8 LPCEMU_Sync(UINT8 lad)
+{
+	UINT32 short_waits = 0;
+	UINT32 long_waits = 0;
+	UINT8 sync;
+
+	for(;;)
+	{
+		sync = lad;
+
+		lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_SYNC);
+
+		switch(sync)
+		{
+			case 0x0: /* SYNC_READY */
+			case 0x9: /* SYNC_READY_MORE */
+			{
+				lpcemu_sync = sync;
+
+				return lad;
+			}
+
+			case 0x5: /* SYNC_SHORT_WAIT */
+			{
+				short_waits += 1;
+
+			} break;
+
+			case 0x6: /* SYNC_LONG_WAIT */
+			{
+				long_waits += 1;
+
+			} break;
+
+			default: /* SYNC_ERROR or nobody driving */
+			{
+				short_waits = LPCEMU_SYNC_TIMEOUT + 1;
+
+			} break;
+		}
+
+		if((short_waits > LPCEMU_SYNC_TIMEOUT) || (long_waits > LPCEMU_LONG_SYNC_TIMEOUT))
+		{
+			LPCEMU_Abort();
+
+			return 0xFF;
+		}
+	}
+}
+
+BOOL LPCEMU_IOWrite(UINT16 address, UINT8 data)
+{
+	UINT8 lad;
+
+	LPCEMU_Start(0x0);
+	LPCEMU_Header(address, TRUE);
+
+	/* Data, least significant nibble first */
+	LPCEMU_Clock(TRUE, (data >> 0) & 0xF, TRUE, PHASE_DATA);
+	LPCEMU_Clock(TRUE, (data >> 4) & 0xF, TRUE, PHASE_DATA);
+
+	/* TAR: host drives 1111b then floats */
+	LPCEMU_Clock(TRUE, 0xF, TRUE, PHASE_TAR);
+	lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+	if(LPCEMU_Sync(lad) == 0xFF) return FALSE;
+
+	/* TAR: peripheral drives 1111b then floats */
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+	lpcemu_stats.cycles += 1;
+
+	return TRUE;
+}
+
+BOOL LPCEMU_IORead(UINT16 address, UINT8 *data)
+{
+	UINT8 lad;
+
+	LPCEMU_Start(0x0);
+	LPCEMU_Header(address, FALSE);
+
+	LPCEMU_Clock(TRUE, 0xF, TRUE, PHASE_TAR);
+	lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+	lad = LPCEMU_Sync(lad);
+
+	if(lad == 0xFF) return FALSE;
+
+	/* Data, least significant nibble first */
+	(*data) = lad;
+	lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_DATA);
+	(*data) |= (UINT8)(lad << 4);
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_DATA);
+
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+	lpcemu_stats.cycles += 1;
+
+	return TRUE;
+}
+
+UINT32 LPCEMU_IOWriteString(UINT16 address, const UINT8 *data, UINT32 count)
+{
+	UINT32 i;
+
+	for(i = 0; i < count; i++)
+	{
+		if(!LPCEMU_IOWrite(address, data[i])) break;
+	}
+
+	return i;
+}
+
+UINT32 LPCEMU_IOReadString(UINT16 address, UINT8 *data, UINT32 count)
+{
+	UINT32 i;
+
+	for(i = 0; i < count; i++)
+	{
+		if(!LPCEMU_IORead(address, &data[i])) break;
+	}
+
+	return i;
+}
+
+UINT32 LPCEMU_FirmwareSize(UINT8 msize)
+{
+	switch(msize)
+	{
+		case 0x0: return 1;
+		case 0x1: return 2;
+		case 0x2: return 4;
+		case 0x4: return 16;
+		case 0x7: return 128;
+		default: return 0;
+	}
+}
+
+static void LPCEMU_FirmwareHeader(UINT8 start, UINT8 idsel, UINT32 address, UINT8 msize)
+{
+	int i;
+
+	LPCEMU_Start(start);
+
+	LPCEMU_Clock(TRUE, idsel & 0xF, TRUE, PHASE_CYCTYPE_AND_DIR);
+
+	/* 28-bit address, most significant nibble first */
+	for(i = 6; i >= 0; i--)
+	{
+		LPCEMU_Clock(TRUE, (UINT8)((address >> (i * 4)) & 0xF), TRUE, PHASE_ADDR);
+	}
+
+	LPCEMU_Clock(TRUE, msize & 0xF, TRUE, PHASE_ADDR);
+}
+
+BOOL LPCEMU_FirmwareWrite(UINT8 idsel, UINT32 address, UINT8 msize, const UINT8 *data)
+{
+	UINT32 length = LPCEMU_FirmwareSize(msize);
+	UINT32 i;
+	UINT8 lad;
+
+	LPCEMU_FirmwareHeader(0xE, idsel, address, msize);
+
+	for(i = 0; i < length; i++)
+	{
+		LPCEMU_Clock(TRUE, (data[i] >> 0) & 0xF, TRUE, PHASE_DATA);
+		LPCEMU_Clock(TRUE, (data[i] >> 4) & 0xF, TRUE, PHASE_DATA);
+	}
+
+	LPCEMU_Clock(TRUE, 0xF, TRUE, PHASE_TAR);
+	lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+	if(LPCEMU_Sync(lad) == 0xFF) return FALSE;
+
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+	lpcemu_stats.cycles += 1;
+
+	return TRUE;
+}
+
+BOOL LPCEMU_FirmwareRead(UINT8 idsel, UINT32 address, UINT8 msize, UINT8 *data)
+{
+	UINT32 length = LPCEMU_FirmwareSize(msize);
+	UINT32 i;
+	UINT8 lad;
+
+	LPCEMU_FirmwareHeader(0xD, idsel, address, msize);
+
+	LPCEMU_Clock(TRUE, 0xF, TRUE, PHASE_TAR);
+	lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+	lad = LPCEMU_Sync(lad);
+
+	if(lad == 0xFF) return FALSE;
+
+	/* Data bytes back to back, least significant nibble first */
+	for(i = 0; i < length; i++)
+	{
+		data[i] = lad;
+		lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_DATA);
+		data[i] |= (UINT8)(lad << 4);
+		lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_DATA);
+	}
+
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+	lpcemu_stats.cycles += 1;
+
+	return TRUE;
+}
+
+static void LPCEMU_DMAHeader(BOOL to_peripheral, UINT8 channel, BOOL terminal, UINT8 size)
+{
+	LPCEMU_Start(0x0);
+
+	/* CYCTYPE = DMA (10b), DIR in bit 1: 0 = DMA read (to the peripheral), 1 = DMA write (to host memory) */
+	LPCEMU_Clock(TRUE, to_peripheral ? 0x8 : 0xA, TRUE, PHASE_CYCTYPE_AND_DIR);
+
+	LPCEMU_Clock(TRUE, (channel & 0x7) | (terminal ? 0x8 : 0x0), TRUE, PHASE_ADDR);
+	LPCEMU_Clock(TRUE, size & 0x3, TRUE, PHASE_ADDR);
+}
+
+UINT32 LPCEMU_DMASize(UINT8 size)
+{
+	switch(size)
+	{
+		case 0x0: return 1;
+		case 0x1: return 2;
+		case 0x3: return 4;
+		default: return 0;
+	}
+}
+
+BOOL LPCEMU_DMARead(UINT8 channel, BOOL terminal, UINT8 size, const UINT8 *data, BOOL *more)
+{
+	UINT32 length = LPCEMU_DMASize(size);
+	UINT32 i;
+	UINT8 lad;
+
+	LPCEMU_DMAHeader(TRUE, channel, terminal, size);
+
+	/* Every byte: DATA, TAR, SYNC, TAR */
+	for(i = 0; i < length; i++)
+	{
+		LPCEMU_Clock(TRUE, (data[i] >> 0) & 0xF, TRUE, PHASE_DATA);
+		LPCEMU_Clock(TRUE, (data[i] >> 4) & 0xF, TRUE, PHASE_DATA);
+
+		LPCEMU_Clock(TRUE, 0xF, TRUE, PHASE_TAR);
+		lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+		if(LPCEMU_Sync(lad) == 0xFF) return FALSE;
+
+		LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+		LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+	}
+
+	(*more) = (lpcemu_sync == 0x9);
+
+	lpcemu_stats.cycles += 1;
+
+	return TRUE;
+}
+
+BOOL LPCEMU_DMAWrite(UINT8 channel, BOOL terminal, UINT8 size, UINT8 *data, BOOL *more)
+{
+	UINT32 length = LPCEMU_DMASize(size);
+	UINT32 i;
+	UINT8 lad;
+
+	LPCEMU_DMAHeader(FALSE, channel, terminal, size);
+
+	LPCEMU_Clock(TRUE, 0xF, TRUE, PHASE_TAR);
+	lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+	/* Every byte: SYNC, DATA */
+	for(i = 0; i < length; i++)
+	{
+		lad = LPCEMU_Sync(lad);
+
+		if(lad == 0xFF) return FALSE;
+
+		data[i] = lad;
+		lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_DATA);
+		data[i] |= (UINT8)(lad << 4);
+		lad = LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_DATA);
+	}
+
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_TAR);
+
+	(*more) = (lpcemu_sync == 0x9);
+
+	lpcemu_stats.cycles += 1;
+
+	return TRUE;
+}
@@ -0,0 +1,111 @@
+#ifndef LPC_EMULATOR_H
+#define LPC_EMULATOR_H
+
+#include "ptypes.h"
+
+/* Host-side emulation of the slave's surroundings:
+ * 1. an emulated GPIO register bank and interrupt controller (the unmodified gpio.c/lpc.c drive it),
+ * 2. a bus driver that toggles LCLK/LFRAME/LAD the way a chipset does, one LCLK period at a time.
+ *
+ * Call LPCEMU_Initialize once, then issue cycles with LPCEMU_IOWrite/LPCEMU_IORead.
+ */
+
+// Signals in the reference layout the bus driver works in, the emulated bank carries them on the pins of the
+// pin map (LPC_PIN_* in lpc.h, recorded samples are bank values)
+
+#define LPCEMU_LCLK_MASK	(0x40)
+#define LPCEMU_LRESET_MASK	(0x20)
+#define LPCEMU_LFRAME_MASK	(0x10)
+#define LPCEMU_LAD_MASK		(0xF)
+
+// Host aborts the cycle when the peripheral keeps driving wait syncs for longer than this
+
+#define LPCEMU_SYNC_TIMEOUT	(8)
+
+// Long wait syncs have no limit in the spec, the emulated host gives up after this many (a bus watchdog)
+
+#define LPCEMU_LONG_SYNC_TIMEOUT	(4096)
+
+typedef enum {
+	PHASE_IDLE		= 0,
+	PHASE_START		= 1,
+	PHASE_CYCTYPE_AND_DIR	= 2,
+	PHASE_ADDR		= 3,
+	PHASE_DATA		= 4,
+	PHASE_TAR		= 5,
+	PHASE_SYNC		= 6,
+	PHASE_ABORT		= 7,
+	PHASE_COUNT		= 8
+} LPCEMU_PHASE;
+
+typedef struct {
+	UINT64	edges;			// LCLK falling edges delivered to GPIO_ISR
+	UINT64	cycles;			// Bus cycles completed
+	UINT64	aborts;			// Bus cycles aborted by the host (sync timeout or bad sync)
+	UINT64	contentions;		// Clocks where host and peripheral drove LAD at the same time
+	UINT64	phase_edges[PHASE_COUNT];
+	UINT64	phase_ns[PHASE_COUNT];	// Only accumulated while profiling is enabled
+} LPCEMU_STATS;
+
+extern LPCEMU_STATS	lpcemu_stats;
+
+extern void	LPCEMU_Initialize(void);
+extern void	LPCEMU_SetProfiling(BOOL enabled);
+extern void	LPCEMU_ClearStats(void);
+
+extern const char *	LPCEMU_PhaseName(LPCEMU_PHASE phase);
+
+/* Record the sampled GPIO value of every edge delivered to GPIO_ISR into buffer (until it is full),
+ * pass NULL to stop recording. Returns the number of samples recorded so far.
+ */
+extern void	LPCEMU_Record(UINT16 *buffer, UINT32 capacity);
+extern UINT32	LPCEMU_Recorded(void);
+
+/* Run task after every LCLK period, like a main loop running between LCLK interrupts (NULL to disable) */
+extern void	LPCEMU_SetBackground(void (*task)(void));
+
+/* Drop the register writes of edges fed to LPC_HandleCycle directly (replaying recorded samples), the emulated pins
+ * keep the state of the last LCLK period.
+ */
+extern void	LPCEMU_DiscardWrites(void);
+
+/* An edge on pins outside the LPC pin map (another GPIO user on the vector), latched into the interrupt status if
+ * the firmware enabled their interrupt. Called from a handler it is an edge arriving while GPIO_ISR runs.
+ */
+extern void	LPCEMU_RaiseInterrupt(UINT16 pins);
+
+/* Hold LRESET low from the next LCLK period on (the clock keeps running), until it is released with FALSE */
+extern void	LPCEMU_SetReset(BOOL asserted);
+
+/* LAD pins the peripheral currently drives (output enabled), 0 once it has floated them */
+extern UINT8	LPCEMU_DrivenLAD(void);
+
+/* Run a single LCLK period: the host drives lframe/lad (or floats LAD when host_drives is FALSE)
+ * on the rising edge, GPIO_ISR runs on the falling edge.
+ * Returns the LAD value the host will sample on the next rising edge.
+ */
+extern UINT8	LPCEMU_Clock(BOOL lframe, UINT8 lad, BOOL host_drives, LPCEMU_PHASE phase);
+
+/* Complete host initiated I/O cycles, returns FALSE when the host had to abort the cycle */
+extern BOOL	LPCEMU_IOWrite(UINT16 address, UINT8 data);
+extern BOOL	LPCEMU_IORead(UINT16 address, UINT8 *data);
+
+/* String I/O (rep outsb / rep insb): count cycles to the same address, stops at the first aborted cycle.
+ * Returns the number of cycles completed.
+ */
+extern UINT32	LPCEMU_IOWriteString(UINT16 address, const UINT8 *data, UINT32 count);
+extern UINT32	LPCEMU_IOReadString(UINT16 address, UINT8 *data, UINT32 count);
+
+/* Firmware Memory cycles, msize is the MSIZE field (0000b = 1, 0001b = 2, 0010b = 4, 0100b = 16, 0111b = 128 bytes) */
+extern BOOL	LPCEMU_FirmwareWrite(UINT8 idsel, UINT32 address, UINT8 msize, const UINT8 *data);
+extern BOOL	LPCEMU_FirmwareRead(UINT8 idsel, UINT32 address, UINT8 msize, UINT8 *data);
+extern UINT32	LPCEMU_FirmwareSize(UINT8 msize);
+
+/* DMA cycles, size is the SIZE field (00b = 8, 01b = 16, 11b = 32 bits), more reports a 1001b (ready more) sync.
+ * A DMA read moves data from the host to the peripheral, a DMA write from the peripheral to the host.
+ */
+extern BOOL	LPCEMU_DMARead(UINT8 channel, BOOL terminal, UINT8 size, const UINT8 *data, BOOL *more);
+extern BOOL	LPCEMU_DMAWrite(UINT8 channel, BOOL terminal, UINT8 size, UINT8 *data, BOOL *more);
+extern UINT32	LPCEMU_DMASize(UINT8 size);
+
+#endif
@@ -0,0 +1,429 @@
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__) && (defined(__i386__) || defined(__x86_64__))
+#include <sys/io.h>
+#define LPCM_HAVE_IOPERM
+#endif
+
+#include "lpc_master.h"
+#include "crc.h"
+
+#ifdef LPC_EMULATOR
+#include "lpc_emulator.h"
+#endif
+
+// Message protocol address map, see lpc_io_transmission.c
+
+#define MSG_ADDR_OF_LENGTH		(0x100)
+#define MSG_ADDR_OF_CHECKSUM		(0x101)
+#define MSG_ADDR_OF_ACK			(0x102)
+#define MSG_ADDR_OF_INTEGRITY		(0x103)
+#define MSG_ADDR_OF_CRC			(0x104)
+#define MSG_ADDR_OF_LENGTH_HIGH		(0x108)
+#define MSG_ADDR_OF_PAGE		(0x109)
+
+#define MSG_PAGE_LENGTH			(256)
+
+#define ACK_PASS			(0xA0)
+#define ACK_FAIL			(0xAF)
+
+#define LPCM_WRITE_BYTE(master, address, data)	((master)->transport.write((master)->transport.context, (UINT16)((master)->base + (address)), (data)))
+#define LPCM_READ_BYTE(master, address, data)	((master)->transport.read((master)->transport.context, (UINT16)((master)->base + (address)), (data)))
+
+void LPCM_Initialize(LPCM_MASTER *master, const LPCM_TRANSPORT *transport, UINT16 base)
+{
+	master->transport = (*transport);
+	master->base = base;
+	master->integrity = LPCM_INTEGRITY_SUM;
+	master->retries = LPCM_DEFAULT_RETRIES;
+	master->polls = LPCM_DEFAULT_POLLS;
+
+	LPCM_GetStats(master, NULL, TRUE);
+}
+
+BOOL LPCM_SetIntegrity(LPCM_MASTER *master, UINT8 integrity)
+{
+	if(integrity > LPCM_INTEGRITY_CRC32) return FALSE;
+	if(!LPCM_WRITE_BYTE(master, MSG_ADDR_OF_INTEGRITY, integrity)) return FALSE;
+
+	master->integrity = integrity;
+
+	return TRUE;
+}
+
+void LPCM_GetStats(LPCM_MASTER *master, LPCM_STATS *stats, BOOL clear)
+{
+	if(stats != NULL) (*stats) = master->stats;
+
+	if(clear)
+	{
+		master->stats.sent = 0;
+		master->stats.received = 0;
+		master->stats.resent = 0;
+		master->stats.reread = 0;
+		master->stats.polls = 0;
+		master->stats.failures = 0;
+	}
+}
+
+/* ### Integrity ###
+ *
+ * The check value of one page (or of the whole message below 256 bytes) in the master's integrity mode,
+ * sent least significant byte first through MSG_ADDR_OF_CHECKSUM or the MSG_ADDR_OF_CRC window.
+ */
+
+static UINT32 LPCM_Check(LPCM_MASTER *master, const UINT8 *data, UINT16 length)
+{
+	UINT8 checksum = 0;
+	UINT16 i;
+
+	switch(master->integrity)
+	{
+		case LPCM_INTEGRITY_CRC16: return CRC16_Compute(data, length);
+		case LPCM_INTEGRITY_CRC32: return CRC32_Compute(data, length);
+	}
+
+	for(i = 0; i < length; i++)
+	{
+		checksum += data[i];
+	}
+
+	return checksum;
+}
+
+static UINT8 LPCM_CheckWidth(LPCM_MASTER *master)
+{
+	return (master->integrity == LPCM_INTEGRITY_CRC32) ? 4 : 2;
+}
+
+static BOOL LPCM_WriteCheck(LPCM_MASTER *master, UINT32 check)
+{
+	UINT8 i;
+
+	if(master->integrity == LPCM_INTEGRITY_SUM) return LPCM_WRITE_BYTE(master, MSG_ADDR_OF_CHECKSUM, (UINT8)check);
+
+	/* The slave checks the CRC when its most significant byte is written */
+	for(i = 0; i < LPCM_CheckWidth(master); i++)
+	{
+		if(!LPCM_WRITE_BYTE(master, MSG_ADDR_OF_CRC + i, (UINT8)(check >> (8 * i)))) return FALSE;
+	}
+
+	return TRUE;
+}
+
+static BOOL LPCM_ReadCheck(LPCM_MASTER *master, UINT32 *check)
+{
+	UINT8 data;
+	UINT8 i;
+
+	(*check) = 0;
+
+	if(master->integrity == LPCM_INTEGRITY_SUM)
+	{
+		if(!LPCM_READ_BYTE(master, MSG_ADDR_OF_CHECKSUM, &data)) return FALSE;
+
+		(*check) = data;
+
+		return TRUE;
+	}
+
+	for(i = 0; i < LPCM_CheckWidth(master); i++)
+	{
+		if(!LPCM_READ_BYTE(master, MSG_ADDR_OF_CRC + i, &data)) return FALSE;
+
+		(*check) |= ((UINT32)data << (8 * i));
+	}
+
+	return TRUE;
+}
+
+/* ### Send ###
+ *
+ * A failed ACK on the first page may also mean the slave refused the message (every queue slot in use, or no large
+ * buffer free), which only a new LENGTH write retries, so the first page is always sent again from LENGTH on.
+ * Later pages belong to a message the slave already accepted and are sent again on their own.
+ */
+
+static BOOL LPCM_SendPage(LPCM_MASTER *master, const UINT8 *message, UINT16 length, UINT16 page)
+{
+	const UINT8 *data = &message[page * MSG_PAGE_LENGTH];
+	UINT16 page_length = ((length - (page * MSG_PAGE_LENGTH)) > MSG_PAGE_LENGTH) ? MSG_PAGE_LENGTH : (length - (page * MSG_PAGE_LENGTH));
+	BOOL paged = (length >= MSG_PAGE_LENGTH);
+	UINT16 i;
+	UINT8 ack;
+
+	if(page == 0)
+	{
+		if(paged && !LPCM_WRITE_BYTE(master, MSG_ADDR_OF_LENGTH_HIGH, (UINT8)(length >> 8))) return FALSE;
+		if(!LPCM_WRITE_BYTE(master, MSG_ADDR_OF_LENGTH, (UINT8)length)) return FALSE;
+	}
+
+	if(paged && !LPCM_WRITE_BYTE(master, MSG_ADDR_OF_PAGE, (UINT8)page)) return FALSE;
+
+	for(i = 0; i < page_length; i++)
+	{
+		if(!LPCM_WRITE_BYTE(master, i, data[i])) return FALSE;
+	}
+
+	if(!LPCM_WriteCheck(master, LPCM_Check(master, data, page_length))) return FALSE;
+	if(!LPCM_READ_BYTE(master, MSG_ADDR_OF_ACK, &ack)) return FALSE;
+
+	return (ack == ACK_PASS);
+}
+
+BOOL LPCM_SendMessage(LPCM_MASTER *master, const UINT8 *message, UINT16 length)
+{
+	UINT16 page;
+	UINT16 attempt;
+
+	if(length > LPCM_MAX_LENGTH) return FALSE;
+
+	for(page = 0; (page == 0) || ((page * MSG_PAGE_LENGTH) < length); page++)
+	{
+		for(attempt = 0; !LPCM_SendPage(master, message, length, page); attempt++)
+		{
+			if((attempt + 1) >= master->retries)
+			{
+				master->stats.failures += 1;
+
+				return FALSE;
+			}
+
+			master->stats.resent += 1;
+		}
+	}
+
+	master->stats.sent += 1;
+
+	return TRUE;
+}
+
+/* ### Receive ### */
+
+static BOOL LPCM_ReceivePage(LPCM_MASTER *master, UINT8 *reply, UINT16 length, UINT16 page)
+{
+	UINT8 *data = &reply[page * MSG_PAGE_LENGTH];
+	UINT16 page_length = ((length - (page * MSG_PAGE_LENGTH)) > MSG_PAGE_LENGTH) ? MSG_PAGE_LENGTH : (length - (page * MSG_PAGE_LENGTH));
+	UINT16 i;
+	UINT32 check;
+
+	if((length >= MSG_PAGE_LENGTH) && !LPCM_WRITE_BYTE(master, MSG_ADDR_OF_PAGE, (UINT8)page)) return FALSE;
+
+	for(i = 0; i < page_length; i++)
+	{
+		if(!LPCM_READ_BYTE(master, i, &data[i])) return FALSE;
+	}
+
+	if(!LPCM_ReadCheck(master, &check)) return FALSE;
+
+	return (check == LPCM_Check(master, data, page_length));
+}
+
+BOOL LPCM_ReceiveMessage(LPCM_MASTER *master, UINT8 *reply, UINT16 capacity, UINT16 *length)
+{
+	UINT32 polls;
+	UINT16 page;
+	UINT16 attempt;
+	UINT8 data;
+
+	/* The LENGTH read waits (long wait syncs) until the application answers, the emulated host gives up eventually */
+	for(polls = 0; !LPCM_READ_BYTE(master, MSG_ADDR_OF_LENGTH, &data); polls++)
+	{
+		master->stats.polls += 1;
+
+		if((polls + 1) >= master->polls)
+		{
+			master->stats.failures += 1;
+
+			return FALSE;
+		}
+	}
+
+	(*length) = data;
+
+	if(!LPCM_READ_BYTE(master, MSG_ADDR_OF_LENGTH_HIGH, &data)) return FALSE;
+
+	(*length) |= ((UINT16)data << 8);
+
+	if((*length) > capacity) return FALSE;
+
+	for(page = 0; (page == 0) || ((page * MSG_PAGE_LENGTH) < (*length)); page++)
+	{
+		for(attempt = 0; !LPCM_ReceivePage(master, reply, (*length), page); attempt++)
+		{
+			if((attempt + 1) >= master->retries)
+			{
+				master->stats.failures += 1;
+
+				return FALSE;
+			}
+
+			master->stats.reread += 1;
+
+			LPCM_WRITE_BYTE(master, MSG_ADDR_OF_ACK, ACK_FAIL);
+		}
+
+		/* ACK_PASS on the last page releases the reply */
+		if(!LPCM_WRITE_BYTE(master, MSG_ADDR_OF_ACK, ACK_PASS)) return FALSE;
+	}
+
+	master->stats.received += 1;
+
+	return TRUE;
+}
+
+BOOL LPCM_Transact(LPCM_MASTER *master, const UINT8 *message, UINT16 length, UINT8 *reply, UINT16 capacity, UINT16 *reply_length)
+{
+	if(!LPCM_SendMessage(master, message, length)) return FALSE;
+
+	return LPCM_ReceiveMessage(master, reply, capacity, reply_length);
+}
+
+/* ### Transport: /dev/port ###
+ *
+ * One pread/pwrite per cycle at the port number as the file offset, works on any architecture the kernel
+ * exposes port I/O on, at the cost of a system call per byte.
+ */
+
+static BOOL LPCM_DevPortWrite(void *context, UINT16 address, UINT8 data)
+{
+	return (pwrite(*(int *)context, &data, 1, address) == 1);
+}
+
+static BOOL LPCM_DevPortRead(void *context, UINT16 address, UINT8 *data)
+{
+	return (pread(*(int *)context, data, 1, address) == 1);
+}
+
+static void LPCM_DevPortClose(void *context)
+{
+	close(*(int *)context);
+	free(context);
+}
+
+BOOL LPCM_OpenDevPort(LPCM_TRANSPORT *transport)
+{
+	int *fd = (int *)malloc(sizeof(int));
+
+	if(fd == NULL) return FALSE;
+
+	(*fd) = open("/dev/port", O_RDWR);
+
+	if((*fd) < 0)
+	{
+		free(fd);
+
+		return FALSE;
+	}
+
+	transport->write = LPCM_DevPortWrite;
+	transport->read = LPCM_DevPortRead;
+	transport->close = LPCM_DevPortClose;
+	transport->context = fd;
+
+	return TRUE;
+}
+
+/* ### Transport: ioperm ###
+ *
+ * inb/outb straight from user space once ioperm granted the port range, no system call per cycle.
+ */
+
+#ifdef LPCM_HAVE_IOPERM
+
+typedef struct {
+	UINT16	base;
+	UINT16	length;
+} LPCM_IOPERM_RANGE;
+
+static BOOL LPCM_IOPermWrite(void *context, UINT16 address, UINT8 data)
+{
+	outb(data, address);
+
+	return TRUE;
+}
+
+static BOOL LPCM_IOPermRead(void *context, UINT16 address, UINT8 *data)
+{
+	(*data) = inb(address);
+
+	return TRUE;
+}
+
+static void LPCM_IOPermClose(void *context)
+{
+	LPCM_IOPERM_RANGE *range = (LPCM_IOPERM_RANGE *)context;
+
+	ioperm(range->base, range->length, 0);
+	free(range);
+}
+
+#endif
+
+BOOL LPCM_OpenIOPerm(LPCM_TRANSPORT *transport, UINT16 base, UINT16 length)
+{
+#ifdef LPCM_HAVE_IOPERM
+	LPCM_IOPERM_RANGE *range = (LPCM_IOPERM_RANGE *)malloc(sizeof(LPCM_IOPERM_RANGE));
+
+	if(range == NULL) return FALSE;
+
+	if(ioperm(base, length, 1) != 0)
+	{
+		free(range);
+
+		return FALSE;
+	}
+
+	range->base = base;
+	range->length = length;
+
+	transport->write = LPCM_IOPermWrite;
+	transport->read = LPCM_IOPermRead;
+	transport->close = LPCM_IOPermClose;
+	transport->context = range;
+
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+/* ### Transport: Loopback ###
+ *
+ * Cycles go to the emulated bus (lpc_emulator.h) and are decoded by the slave linked into the same process.
+ * The application answers from the emulator's background task (LPCEMU_SetBackground), as it would from its main loop.
+ */
+
+#ifdef LPC_EMULATOR
+
+static BOOL LPCM_LoopbackWrite(void *context, UINT16 address, UINT8 data)
+{
+	return LPCEMU_IOWrite(address, data);
+}
+
+static BOOL LPCM_LoopbackRead(void *context, UINT16 address, UINT8 *data)
+{
+	return LPCEMU_IORead(address, data);
+}
+
+BOOL LPCM_OpenLoopback(LPCM_TRANSPORT *transport)
+{
+	transport->write = LPCM_LoopbackWrite;
+	transport->read = LPCM_LoopbackRead;
+	transport->close = NULL;
+	transport->context = NULL;
+
+	return TRUE;
+}
+
+#endif
+
+void LPCM_Close(LPCM_TRANSPORT *transport)
+{
+	if(transport->close != NULL) transport->close(transport->context);
+
+	transport->close = NULL;
+	transport->context = NULL;
+}
@@ -0,0 +1,94 @@
+#ifndef LPC_MASTER_H
+#define LPC_MASTER_H
+
+#include "ptypes.h"
+
+/* ### LPC Master Driver ###
+ *
+ * Host side of the message protocol in lpc_io_transmission.c (see Master Driver Code there): sends messages,
+ * reads replies back, resends pages the slave answers with ACK_FAIL and asks again for pages that fail their check.
+ * Messages of 256 bytes or more are moved in pages, which the slave only accepts with large buffers set.
+ *
+ * The driver only issues single byte I/O cycles through a transport, so it runs unchanged on:
+ * - /dev/port (LPCM_OpenDevPort, needs CAP_SYS_RAWIO),
+ * - inb/outb after ioperm (LPCM_OpenIOPerm, x86 Linux, needs CAP_SYS_RAWIO),
+ * - the emulated slave in the same process (LPCM_OpenLoopback, built with -DLPC_EMULATOR).
+ *
+ * Usage:
+ *
+ * LPCM_OpenLoopback(&transport);
+ * LPCM_Initialize(&master, &transport, 0x0000);
+ * LPCM_Transact(&master, message, length, reply, sizeof(reply), &reply_length);
+ * LPCM_Close(&transport);
+ */
+
+/* One I/O cycle, returns FALSE when the cycle did not complete (the emulated host aborted it).
+ * Real hardware transports cannot tell, an aborted read returns 0xFF which fails the checks instead.
+ */
+typedef BOOL (*LPCM_WRITE)(void *context, UINT16 address, UINT8 data);
+typedef BOOL (*LPCM_READ)(void *context, UINT16 address, UINT8 *data);
+
+typedef struct {
+	LPCM_WRITE	write;
+	LPCM_READ	read;
+	void		(*close)(void *context);	// NULL if there is nothing to release
+	void *		context;
+} LPCM_TRANSPORT;
+
+// Integrity modes, the values written to MSG_ADDR_OF_INTEGRITY
+
+#define LPCM_INTEGRITY_SUM	(0)
+#define LPCM_INTEGRITY_CRC16	(1)
+#define LPCM_INTEGRITY_CRC32	(2)
+
+#define LPCM_DEFAULT_RETRIES	(8)		// Attempts per page before a send or receive gives up
+#define LPCM_DEFAULT_POLLS	(1000)		// LENGTH reads while waiting for a reply before a receive gives up
+
+#define LPCM_MAX_LENGTH		(0x7FFF)	// MSG_ADDR_OF_LENGTH_HIGH holds bits 14:8
+
+typedef struct {
+	UINT32	sent;			// Messages acknowledged by the slave
+	UINT32	received;		// Replies read and acknowledged
+	UINT32	resent;			// Pages sent again after ACK_FAIL (or a failed ACK read)
+	UINT32	reread;			// Pages read again after their check failed
+	UINT32	polls;			// LENGTH reads that found no reply
+	UINT32	failures;		// Sends and receives that ran out of retries or polls
+} LPCM_STATS;
+
+typedef struct {
+	LPCM_TRANSPORT	transport;
+	UINT16		base;		// I/O address the slave registered the protocol at (LPC_RegisterIOMessages)
+	UINT8		integrity;
+	UINT16		retries;
+	UINT32		polls;
+	LPCM_STATS	stats;
+} LPCM_MASTER;
+
+extern void	LPCM_Initialize(LPCM_MASTER *master, const LPCM_TRANSPORT *transport, UINT16 base);
+
+/* Select the integrity mode for messages and replies in both directions, the slave drops an unfinished message */
+extern BOOL	LPCM_SetIntegrity(LPCM_MASTER *master, UINT8 integrity);
+
+/* Send a message, returns FALSE if a page was not acknowledged within master->retries attempts */
+extern BOOL	LPCM_SendMessage(LPCM_MASTER *master, const UINT8 *message, UINT16 length);
+
+/* Read the oldest reply into reply, waiting up to master->polls LENGTH reads for it. Returns FALSE if there was none,
+ * if a page kept failing its check, or if it is longer than capacity (the reply stays queued, (*length) is set).
+ */
+extern BOOL	LPCM_ReceiveMessage(LPCM_MASTER *master, UINT8 *reply, UINT16 capacity, UINT16 *length);
+
+/* Send a message and read its reply */
+extern BOOL	LPCM_Transact(LPCM_MASTER *master, const UINT8 *message, UINT16 length, UINT8 *reply, UINT16 capacity, UINT16 *reply_length);
+
+extern void	LPCM_GetStats(LPCM_MASTER *master, LPCM_STATS *stats, BOOL clear);
+
+// Transports, the Open functions return FALSE (and leave transport unusable) if the I/O space cannot be accessed
+
+extern BOOL	LPCM_OpenDevPort(LPCM_TRANSPORT *transport);
+extern BOOL	LPCM_OpenIOPerm(LPCM_TRANSPORT *transport, UINT16 base, UINT16 length);
+#ifdef LPC_EMULATOR
+extern BOOL	LPCM_OpenLoopback(LPCM_TRANSPORT *transport);
+#endif
+extern void	LPCM_Close(LPCM_TRANSPORT *transport);
+
+#endif
@@ -0,0 +1,438 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "gpio.h"
+#include "lpc.h"
+#include "lpc_master.h"
+#include "debug.h"
+
+#if DEBUG_LEVEL > DEBUG_LEVEL_OFF
+#error "The ports would share the trace ring (see debug.h), build with -DDEBUG_LEVEL=0"
+#endif
+
+/* ### Multi-Port Harness ###
+ *
+ * Runs N independent slaves on N threads, each one a port (LPC_CONTEXT and LPC_MESSAGES) wired to a private register
+ * bank and driven by its own bus driver, to show that the decoder and the message protocol keep no shared state and
+ * scale with the cores. Every thread echoes messages through the master library (lpc_master.h) over its own bus:
+ * the master sends a message, the application copies it back into a reply, the master reads the reply and checks it.
+ *
+ * The ports use the pin map of the build (LPC_PIN_* in lpc.h), each on a bank of its own.
+ *
+ * The bus driver is a minimal version of the emulator's (lpc_emulator.c): the falling LCLK edge publishes the pins in
+ * the data register and calls LPC_ISR, then the writes of the slave are latched. The emulator itself is single
+ * instance and only linked for the interrupt controller that LPC_Initialize enables.
+ *
+ * Reports bus clocks and round trips per second for 1, 2, 4, ... ports up to N (default: the online CPUs), the speedup
+ * over one port and the clocks per second of the slowest port. Threads are pinned to CPUs round robin.
+ *
+ * Build: gcc -std=gnu89 -O2 -DLPC_EMULATOR -DDEBUG_LEVEL=0 -I. -Ihost gpio.c lpc.c lpc_io_dispatch.c lpc_io_transmission.c
+ *        crc.c lz.c debug.c host/lpc_emulator.c host/lpc_master.c host/lpc_multi.c -lpthread -o lpc_multi
+ *        (DEBUG_LEVEL=0 since the trace ring is shared by the ports, add -DLPC_TABLE_DECODER or -DLPC_DEFERRED_DECODE
+ *        to run the other decoders)
+ * Usage: lpc_multi [ports] [round trips per port]
+ */
+
+#define MULTI_MAX_PORTS		(64)
+#define MULTI_DEFAULT_ROUND_TRIPS	(20000)
+#define MULTI_MESSAGE_LENGTH	(32)
+
+#define MULTI_SAMPLE_MARKER	(0x8000)	// Kept set in the data register, see lpc_emulator.c
+#define MULTI_SYNC_TIMEOUT	(8)		// LPCEMU_SYNC_TIMEOUT
+#define MULTI_LONG_SYNC_TIMEOUT	(4096)		// LPCEMU_LONG_SYNC_TIMEOUT
+
+typedef struct {
+	LPC_CONTEXT	lpc;
+	LPC_MESSAGES	messages;
+	LPC_PINS	pins;
+
+	UINT16		registers[GPIO_REGISTER_BANK_SIZE / sizeof(UINT16)] __attribute__((aligned(4)));
+	UINT16		sampled;		// Pins published in the data register for the current clock
+	UINT16		output;			// Latched DATA/DATA_CLEAR writes of the slave
+	UINT16		dir;			// Latched DIR/DIR_CLEAR writes of the slave
+
+	pthread_t	thread;
+	int		cpu;
+	long		round_trips;
+	UINT64		clocks;
+	double		start;			// Wall clock when the port left the start barrier
+	double		end;			// and when it finished its round trips
+	BOOL		failed;
+} LPC_CACHE_ALIGNED MULTI_PORT;
+
+static MULTI_PORT		multi_ports[MULTI_MAX_PORTS];
+static pthread_barrier_t	multi_start;
+
+#define MULTI_REGISTER(port, offset)	((port)->registers[(offset) / sizeof(UINT16)])
+
+static double MULTI_Seconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + ((double)now.tv_nsec / 1e9);
+}
+
+/**************************************/
+/* ##### ##### Bus Driver ##### ##### */
+/**************************************/
+
+static void MULTI_Latch(MULTI_PORT *port)
+{
+	UINT16 data = MULTI_REGISTER(port, GPIO_DATA_OFFSET);
+	UINT32 masked = GPIO_MASKED_REGISTER((volatile UINT8 *)port->registers);
+
+	if(!(data & MULTI_SAMPLE_MARKER))
+	{
+		port->output |= data;
+	}
+	port->output &= ~MULTI_REGISTER(port, GPIO_DATA_CLEAR_OFFSET);
+	port->output = (UINT16)((port->output & ~(masked >> 16)) | (masked & (masked >> 16)));
+
+	port->dir |= MULTI_REGISTER(port, GPIO_DIR_OFFSET);
+	port->dir &= ~MULTI_REGISTER(port, GPIO_DIR_CLEAR_OFFSET);
+
+	MULTI_REGISTER(port, GPIO_DIR_OFFSET) = 0;
+	MULTI_REGISTER(port, GPIO_DIR_CLEAR_OFFSET) = 0;
+	MULTI_REGISTER(port, GPIO_DATA_CLEAR_OFFSET) = 0;
+	GPIO_MASKED_REGISTER((volatile UINT8 *)port->registers) = 0;
+
+	/* Publish the pins again, the slave's writes must not be latched twice */
+	MULTI_REGISTER(port, GPIO_DATA_OFFSET) = port->sampled;
+}
+
+/* One LCLK period, returns the LAD value the host samples on the next rising edge (see LPCEMU_Clock) */
+static UINT8 MULTI_Clock(MULTI_PORT *port, BOOL lframe, UINT8 lad, BOOL host_drives)
+{
+	UINT16 host = LPC_SCATTER_LAD(lad);
+	UINT16 slave_enable = port->dir & LPC_LAD_PINS;
+	UINT16 bus;
+	UINT16 pins;
+
+	bus = host_drives ? host : LPC_LAD_PINS;
+	bus &= (port->output | ~slave_enable) & LPC_LAD_PINS;
+
+	pins = LPC_LRESET_PIN | bus;
+
+	if(lframe)
+	{
+		pins |= LPC_LFRAME_PIN;
+	}
+
+	/* Falling edge, the rising one only matters to the interrupt controller */
+
+	port->sampled = pins | MULTI_SAMPLE_MARKER;
+
+	MULTI_REGISTER(port, GPIO_DATA_OFFSET) = port->sampled;
+	MULTI_REGISTER(port, GPIO_INTERRUPT_STATUS_OFFSET) = LPC_LCLK_PIN;
+
+	LPC_ISR(&port->lpc);
+	MULTI_Latch(port);
+
+#ifdef LPC_DEFERRED_DECODE
+	LPC_ProcessSamples(&port->lpc);
+	MULTI_Latch(port);
+#endif
+
+	port->clocks += 1;
+
+	slave_enable = port->dir & LPC_LAD_PINS;
+
+	bus = host_drives ? host : LPC_LAD_PINS;
+	bus &= (port->output | ~slave_enable) & LPC_LAD_PINS;
+
+	return (UINT8)(LPC_GATHER_PINS(bus) & 0xF);
+}
+
+static void MULTI_Header(MULTI_PORT *port, UINT16 address, BOOL write)
+{
+	/* START for one clock, CYCTYPE = I/O with DIR in bit 1, address most significant nibble first */
+	MULTI_Clock(port, FALSE, 0x0, TRUE);
+	MULTI_Clock(port, TRUE, write ? 0x2 : 0x0, TRUE);
+	MULTI_Clock(port, TRUE, (address >> 12) & 0xF, TRUE);
+	MULTI_Clock(port, TRUE, (address >> 8) & 0xF, TRUE);
+	MULTI_Clock(port, TRUE, (address >> 4) & 0xF, TRUE);
+	MULTI_Clock(port, TRUE, (address >> 0) & 0xF, TRUE);
+}
+
+/* Returns the LAD value sampled after the ready sync, or 0xFF if the host aborted */
+static UINT8 MULTI_Sync(MULTI_PORT *port, UINT8 lad)
+{
+	UINT32 short_waits = 0;
+	UINT32 long_waits = 0;
+	UINT8 sync;
+	int i;
+
+	for(;;)
+	{
+		sync = lad;
+
+		lad = MULTI_Clock(port, TRUE, 0xF, FALSE);
+
+		if(sync == 0x0) return lad;
+
+		if(sync == 0x5) short_waits += 1;
+		else if(sync == 0x6) long_waits += 1;
+		else short_waits = MULTI_SYNC_TIMEOUT + 1;
+
+		if((short_waits > MULTI_SYNC_TIMEOUT) || (long_waits > MULTI_LONG_SYNC_TIMEOUT))
+		{
+			for(i = 0; i < 4; i++)
+			{
+				MULTI_Clock(port, FALSE, 0xF, TRUE);
+			}
+			MULTI_Clock(port, TRUE, 0xF, FALSE);
+
+			return 0xFF;
+		}
+	}
+}
+
+static BOOL MULTI_IOWrite(void *context, UINT16 address, UINT8 data)
+{
+	MULTI_PORT *port = (MULTI_PORT *)context;
+	UINT8 lad;
+
+	MULTI_Header(port, address, TRUE);
+
+	MULTI_Clock(port, TRUE, (data >> 0) & 0xF, TRUE);
+	MULTI_Clock(port, TRUE, (data >> 4) & 0xF, TRUE);
+
+	MULTI_Clock(port, TRUE, 0xF, TRUE);
+	lad = MULTI_Clock(port, TRUE, 0xF, FALSE);
+
+	if(MULTI_Sync(port, lad) == 0xFF) return FALSE;
+
+	MULTI_Clock(port, TRUE, 0xF, FALSE);
+	MULTI_Clock(port, TRUE, 0xF, FALSE);
+
+	return TRUE;
+}
+
+static BOOL MULTI_IORead(void *context, UINT16 address, UINT8 *data)
+{
+	MULTI_PORT *port = (MULTI_PORT *)context;
+	UINT8 lad;
+
+	MULTI_Header(port, address, FALSE);
+
+	MULTI_Clock(port, TRUE, 0xF, TRUE);
+	lad = MULTI_Clock(port, TRUE, 0xF, FALSE);
+
+	lad = MULTI_Sync(port, lad);
+
+	if(lad == 0xFF) return FALSE;
+
+	(*data) = lad;
+	lad = MULTI_Clock(port, TRUE, 0xF, FALSE);
+	(*data) |= (UINT8)(lad << 4);
+	MULTI_Clock(port, TRUE, 0xF, FALSE);
+
+	MULTI_Clock(port, TRUE, 0xF, FALSE);
+	MULTI_Clock(port, TRUE, 0xF, FALSE);
+
+	return TRUE;
+}
+
+/*********************************/
+/* ##### ##### Ports ##### ##### */
+/*********************************/
+
+/* Called from the main thread, LPC_Initialize enables the (shared) emulated interrupt controller */
+static void MULTI_InitializePort(MULTI_PORT *port, int index, int cpus)
+{
+	memset(port, 0, sizeof(MULTI_PORT));
+
+	port->pins.bank = (volatile UINT8 *)port->registers;
+	port->cpu = index % cpus;
+
+	/* Bus idle: LRESET and LFRAME inactive (high), LAD pulled up */
+	port->sampled = LPC_LRESET_PIN | LPC_LFRAME_PIN | LPC_LAD_PINS | MULTI_SAMPLE_MARKER;
+	MULTI_REGISTER(port, GPIO_DATA_OFFSET) = port->sampled;
+
+	LPC_Initialize(&port->lpc, &port->pins, &port->messages);
+	MULTI_Latch(port);
+}
+
+static void *MULTI_Run(void *argument)
+{
+	MULTI_PORT *port = (MULTI_PORT *)argument;
+	LPCM_TRANSPORT transport;
+	LPCM_MASTER master;
+	UINT8 message[MULTI_MESSAGE_LENGTH];
+	UINT8 reply[MULTI_MESSAGE_LENGTH];
+	UINT8 received[MULTI_MESSAGE_LENGTH];
+	UINT8 received_length;
+	UINT16 reply_length;
+	long i;
+	int j;
+#ifdef __linux__
+	cpu_set_t cpus;
+
+	CPU_ZERO(&cpus);
+	CPU_SET(port->cpu, &cpus);
+	pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+#endif
+
+	transport.write = MULTI_IOWrite;
+	transport.read = MULTI_IORead;
+	transport.close = NULL;
+	transport.context = port;
+
+	LPCM_Initialize(&master, &transport, 0x0000);
+
+	pthread_barrier_wait(&multi_start);
+
+	/* Every port times itself, a worker may run long before the main thread returns from the barrier */
+	port->start = MULTI_Seconds();
+
+	for(i = 0; i < port->round_trips; i++)
+	{
+		for(j = 0; j < MULTI_MESSAGE_LENGTH; j++)
+		{
+			message[j] = (UINT8)(i + j);
+		}
+
+		if(!LPCM_SendMessage(&master, message, MULTI_MESSAGE_LENGTH)) break;
+
+		/* The application of the slave */
+		if(!LPC_GetIOMessage(&port->messages, received, &received_length)) break;
+		if(!LPC_SetIOMessage(&port->messages, received, received_length)) break;
+
+		if(!LPCM_ReceiveMessage(&master, reply, sizeof(reply), &reply_length)) break;
+		if((reply_length != MULTI_MESSAGE_LENGTH) || (memcmp(reply, message, MULTI_MESSAGE_LENGTH) != 0)) break;
+	}
+
+	port->end = MULTI_Seconds();
+	port->failed = (i != port->round_trips);
+
+	return NULL;
+}
+
+/* Runs ports threads to completion, returns the wall clock seconds from the first port starting to the last one
+ * finishing, or a negative value if a port failed
+ */
+static double MULTI_RunPorts(int ports, long round_trips, int cpus)
+{
+	double start;
+	double end;
+	int i;
+
+	for(i = 0; i < ports; i++)
+	{
+		MULTI_InitializePort(&multi_ports[i], i, cpus);
+		multi_ports[i].round_trips = round_trips;
+	}
+
+	pthread_barrier_init(&multi_start, NULL, (unsigned)(ports + 1));
+
+	for(i = 0; i < ports; i++)
+	{
+		if(pthread_create(&multi_ports[i].thread, NULL, MULTI_Run, &multi_ports[i]) != 0)
+		{
+			fprintf(stderr, "lpc_multi: cannot create thread %d\n", i);
+			exit(1);
+		}
+	}
+
+	pthread_barrier_wait(&multi_start);
+
+	for(i = 0; i < ports; i++)
+	{
+		pthread_join(multi_ports[i].thread, NULL);
+	}
+
+	pthread_barrier_destroy(&multi_start);
+
+	start = multi_ports[0].start;
+	end = multi_ports[0].end;
+
+	for(i = 1; i < ports; i++)
+	{
+		if(multi_ports[i].start < start) start = multi_ports[i].start;
+		if(multi_ports[i].end > end) end = multi_ports[i].end;
+	}
+
+	for(i = 0; i < ports; i++)
+	{
+		if(multi_ports[i].failed)
+		{
+			printf("port %d: round trip failed\n", i);
+
+			return -1;
+		}
+	}
+
+	return end - start;
+}
+
+int main(int argc, char *argv[])
+{
+	long round_trips = MULTI_DEFAULT_ROUND_TRIPS;
+	int max_ports;
+	int cpus;
+	int ports;
+	int i;
+	double seconds;
+	double port_seconds;
+	double baseline = 0;
+	double slowest;
+	UINT64 clocks;
+
+	cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	if(cpus < 1) cpus = 1;
+
+	max_ports = cpus;
+
+	if(argc > 1) max_ports = atoi(argv[1]);
+	if(argc > 2) round_trips = atol(argv[2]);
+
+	if(max_ports < 1) max_ports = 1;
+	if(max_ports > MULTI_MAX_PORTS) max_ports = MULTI_MAX_PORTS;
+
+	printf("%d cpus, %ld round trips of %d bytes per port, LPC_CONTEXT %u bytes\n\n",
+		cpus, round_trips, MULTI_MESSAGE_LENGTH, (unsigned)sizeof(LPC_CONTEXT));
+
+	printf("%-8s %16s %14s %10s %18s\n", "ports", "clocks/s", "round trips/s", "speedup", "slowest clocks/s");
+
+	for(ports = 1; ; ports *= 2)
+	{
+		if(ports > max_ports) ports = max_ports;
+
+		seconds = MULTI_RunPorts(ports, round_trips, cpus);
+
+		if(seconds < 0) return 1;
+
+		clocks = 0;
+		slowest = 0;
+
+		for(i = 0; i < ports; i++)
+		{
+			clocks += multi_ports[i].clocks;
+
+			port_seconds = multi_ports[i].end - multi_ports[i].start;
+
+			if((slowest == 0) || (((double)multi_ports[i].clocks / port_seconds) < slowest))
+			{
+				slowest = (double)multi_ports[i].clocks / port_seconds;
+			}
+		}
+
+		if(ports == 1) baseline = (double)clocks / seconds;
+
+		printf("%-8d %16.0f %14.0f %9.2fx %18.0f\n", ports, (double)clocks / seconds, (double)(round_trips * ports) / seconds,
+			((double)clocks / seconds) / baseline, slowest);
+
+		if(ports == max_ports) break;
+	}
+
+	return 0;
+}
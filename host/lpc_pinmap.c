@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "lpc_emulator.h"
+#include "gpio.h"
+#include "lpc.h"
+#include "lpc_master.h"
+
+/* ### Pin Map Check ###
+ *
+ * Checks the slave on the pin layout it was built for (LPC_PIN_* in lpc.h), build and run it once per layout:
+ * 1. LPC_GATHER_PINS against a bit by bit reference for every bank value, LPC_SCATTER_PINS and LPC_SCATTER_LAD for
+ *    every signal value,
+ * 2. message round trips through the emulated bus with the master library (lpc_master.h), a read the host aborts
+ *    (nobody answers it) and an LRESET pulse, each followed by another round trip.
+ *
+ * Prints the layout, the gather/scatter code the preprocessor chose and ns per edge of LPC_HandleCycle replaying a
+ * recorded I/O write and read, to compare layouts. Exits with 1 on the first failure.
+ *
+ * Build: gcc -std=gnu89 -O2 -DLPC_EMULATOR [-DLPC_PIN_LAD0=8 ...] -I. -Ihost gpio.c lpc.c lpc_io_dispatch.c
+ *        lpc_io_transmission.c crc.c lz.c debug.c host/lpc_emulator.c host/lpc_master.c host/lpc_pinmap.c -o lpc_pinmap
+ * Usage: lpc_pinmap [round trips]
+ */
+
+#define PINMAP_DEFAULT_ROUND_TRIPS	(1000)
+#define PINMAP_REPLAY_LENGTH		(64)
+#define PINMAP_REPLAYS			(100000)
+#define PINMAP_UNCLAIMED_ADDRESS	(0x01F0)	// Inside window 0, no device answers it
+#define PINMAP_RESET_CLOCKS		(8)
+
+static const char *	pinmap_names[] = { "LAD0", "LAD1", "LAD2", "LAD3", "LFRAME", "LRESET", "LCLK" };
+static const int	pinmap_pins[] = { LPC_PIN_LAD0, LPC_PIN_LAD1, LPC_PIN_LAD2, LPC_PIN_LAD3, LPC_PIN_LFRAME, LPC_PIN_LRESET, LPC_PIN_LCLK };
+
+static void PINMAP_Fail(const char *check, unsigned long value)
+{
+	printf("%s: failed at 0x%04lX\n", check, value);
+	exit(1);
+}
+
+static double PINMAP_Seconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + ((double)now.tv_nsec / 1e9);
+}
+
+/******************************************/
+/* ##### ##### Gather/Scatter ##### ##### */
+/******************************************/
+
+static void PINMAP_CheckMacros(void)
+{
+	UINT32 value;
+	UINT8 expected_signals;
+	UINT16 expected_pins;
+	int i;
+
+	/* Every bank value, the pins outside the map must not leak into the signals */
+	for(value = 0; value <= GPIO_MASK; value++)
+	{
+		for(expected_signals = 0, i = 0; i < 7; i++)
+		{
+			if(value & (1U << pinmap_pins[i])) expected_signals |= (UINT8)(1U << i);
+		}
+
+		if(LPC_GATHER_PINS(value) != expected_signals) PINMAP_Fail("LPC_GATHER_PINS", value);
+	}
+
+	for(value = 0; value < 0x80; value++)
+	{
+		for(expected_pins = 0, i = 0; i < 7; i++)
+		{
+			if(value & (1U << i)) expected_pins |= (UINT16)(1U << pinmap_pins[i]);
+		}
+
+		if(LPC_SCATTER_PINS(value) != expected_pins) PINMAP_Fail("LPC_SCATTER_PINS", value);
+		if(LPC_SCATTER_LAD(value) != (expected_pins & LPC_LAD_PINS)) PINMAP_Fail("LPC_SCATTER_LAD", value);
+	}
+}
+
+/************************************/
+/* ##### ##### Emulator ##### ##### */
+/************************************/
+
+#ifdef LPC_DEFERRED_DECODE
+static void PINMAP_ProcessSamples(void)
+{
+	LPC_ProcessSamples(&lpc_port);
+}
+#endif
+
+static void PINMAP_RoundTrip(LPCM_MASTER *master, int round, const char *check)
+{
+	UINT8 message[256];
+	UINT8 received[256];
+	UINT8 length;
+	UINT16 reply_length;
+	int i;
+
+	length = (UINT8)(1 + (round % 255));
+
+	for(i = 0; i < length; i++)
+	{
+		message[i] = (UINT8)((round * 13) + (i * 7));
+	}
+
+	if(!LPCM_SendMessage(master, message, length)) PINMAP_Fail(check, (unsigned long)round);
+
+	/* The application echoes the message */
+	if(!LPC_GetIOMessage(&lpc_port_messages, received, &length)) PINMAP_Fail(check, (unsigned long)round);
+	if(!LPC_SetIOMessage(&lpc_port_messages, received, length)) PINMAP_Fail(check, (unsigned long)round);
+
+	if(!LPCM_ReceiveMessage(master, received, sizeof(received), &reply_length)
+	|| (reply_length != length) || (memcmp(received, message, length) != 0))
+	{
+		PINMAP_Fail(check, (unsigned long)round);
+	}
+}
+
+static void PINMAP_CheckBus(long round_trips)
+{
+	LPCM_TRANSPORT transport;
+	LPCM_MASTER master;
+	UINT8 data;
+	long i;
+
+	LPCEMU_Initialize();
+
+#ifdef LPC_DEFERRED_DECODE
+	LPCEMU_SetBackground(PINMAP_ProcessSamples);
+#endif
+
+	if(!LPCM_OpenLoopback(&transport)) PINMAP_Fail("loopback", 0);
+
+	LPCM_Initialize(&master, &transport, 0x0000);
+
+	for(i = 0; i < round_trips; i++)
+	{
+		PINMAP_RoundTrip(&master, (int)i, "round trip");
+	}
+
+	/* Nobody answers, the slave drives short waits until the host aborts the cycle */
+	if(LPCEMU_IORead(PINMAP_UNCLAIMED_ADDRESS, &data)) PINMAP_Fail("abort", PINMAP_UNCLAIMED_ADDRESS);
+	if(LPCEMU_DrivenLAD()) PINMAP_Fail("abort, LAD released", PINMAP_UNCLAIMED_ADDRESS);
+
+	PINMAP_RoundTrip(&master, 1, "round trip after abort");
+
+	LPCEMU_SetReset(TRUE);
+
+	for(i = 0; i < PINMAP_RESET_CLOCKS; i++)
+	{
+		LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_IDLE);
+	}
+
+	LPCEMU_SetReset(FALSE);
+	LPCEMU_Clock(TRUE, 0xF, FALSE, PHASE_IDLE);
+
+	PINMAP_RoundTrip(&master, 2, "round trip after reset");
+
+	LPCM_Close(&transport);
+}
+
+/* LPC_HandleCycle alone, replaying the samples of an I/O write and read */
+static double PINMAP_EdgeNanoseconds(void)
+{
+	UINT16 replay[PINMAP_REPLAY_LENGTH];
+	UINT32 replay_length;
+	UINT8 data;
+	double start;
+	long i;
+	UINT32 j;
+
+	LPCEMU_Record(replay, PINMAP_REPLAY_LENGTH);
+	LPCEMU_IOWrite(0x0000, 0x69);
+	LPCEMU_IORead(0x0000, &data);
+	replay_length = LPCEMU_Recorded();
+	LPCEMU_Record(NULL, 0);
+
+	start = PINMAP_Seconds();
+
+	for(i = 0; i < PINMAP_REPLAYS; i++)
+	{
+		for(j = 0; j < replay_length; j++)
+		{
+			(*gpio_data_register) = replay[j];
+			LPC_HandleCycle(&lpc_port);
+		}
+
+#ifdef LPC_DEFERRED_DECODE
+		LPC_ProcessSamples(&lpc_port);
+#endif
+	}
+
+	start = PINMAP_Seconds() - start;
+
+	LPCEMU_DiscardWrites();
+
+	return (start * 1e9) / ((double)PINMAP_REPLAYS * replay_length);
+}
+
+int main(int argc, char *argv[])
+{
+	long round_trips = PINMAP_DEFAULT_ROUND_TRIPS;
+	int i;
+
+	if(argc > 1) round_trips = atol(argv[1]);
+
+	printf("pins    ");
+
+	for(i = 0; i < 7; i++)
+	{
+		printf(" %s=%d", pinmap_names[i], pinmap_pins[i]);
+	}
+
+	printf("\ngather   %s\nscatter  %s\n",
+		LPC_PINS_IN_ORDER ? "shift and mask" : LPC_PINS_LAD_CONTIGUOUS ? "LAD shift and mask, bit moves" : "bit moves",
+		LPC_PINS_LAD_CONTIGUOUS ? "LAD shift" : "LAD bit moves");
+
+	PINMAP_CheckMacros();
+	PINMAP_CheckBus(round_trips);
+
+	printf("decoder  %.1f ns/edge\nok\n", PINMAP_EdgeNanoseconds());
+
+	return 0;
+}
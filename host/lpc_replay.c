@@ -0,0 +1,1098 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "lpc_emulator.h"
+#include "gpio.h"
+#include "lpc.h"
+
+/* ### Capture Replay ###
+ *
+ * Streams a logic analyzer capture of LCLK/LFRAME/LRESET/LAD through the unmodified cycle decoder (LPC_HandleCycle)
+ * and writes the I/O cycles it decodes to a CSV or binary file. The capture is read in fixed size chunks and every
+ * sample is dropped once it was decoded, so captures of any size run in constant memory.
+ *
+ * Formats:
+ * - VCD: signals are found by name (LCLK, LFRAME, LRESET, LAD as a 4 bit vector or LAD0-LAD3 / LAD[0]-LAD[3],
+ *   suffixes like # or _N are ignored), x and z read as 1 (pulled up),
+ * - CSV (Saleae style): one row per change, time in seconds in column 0, one column per channel. Columns named like
+ *   the VCD signals are found by name, otherwise -c gives the columns of LCLK,LFRAME,LRESET,LAD0,LAD1,LAD2,LAD3
+ *   (default 1,2,3,4,5,6,7, 0 for a signal that was not captured, which then reads as 1).
+ *
+ * The decoder samples on the falling edge of LCLK, it is given the values the other signals had before the edge,
+ * so changes recorded at the same time as the edge count for the next one.
+ *
+ * Every I/O cycle the decoder completes is recorded (the replay claims the whole I/O space, see I/O Dispatch). The
+ * decoder only knows the address of a read, the data is taken from the capture: the two nibbles after the first
+ * ready sync the peripheral drives, which may already be on the edge the decoder dispatches the read (no wait states).
+ *
+ * Output, one record per cycle:
+ * - CSV: time_ns,cycle,address,data with cycle io_write, io_read or io_read_abort (no data),
+ * - binary (-b): 16 byte little endian records { UINT64 time_ps; UINT32 edge; UINT16 address; UINT8 cycle; UINT8 data; }
+ *   with cycle 1 = io_write, 2 = io_read, 3 = io_read_abort, edge is the number of LCLK falling edges before it.
+ *
+ * Throughput and the number of cycles the decoder saw are reported on stderr, so a set of captures and their
+ * expected output make a regression and performance corpus for the decoders, see host/corpus (capture.vcd next to
+ * capture.csv, the CSV output has to match it byte for byte).
+ *
+ * -r writes the samples instead of the cycles, converting the capture into a raw capture (see Raw Captures) that
+ * -j decodes on several cores, -S benchmarks the parallel decode at 1, 2, 4, ... workers up to -j.
+ *
+ * Build: gcc -std=gnu89 -O2 -DLPC_EMULATOR -I. -Ihost gpio.c lpc.c debug.c host/lpc_emulator.c host/lpc_replay.c -o lpc_replay
+ *        (add -DLPC_TABLE_DECODER or -DLPC_DEFERRED_DECODE to replay through the other decoders)
+ * Usage: lpc_replay [-b | -r] [-f vcd|csv|raw] [-c columns] [-j workers] [-S] capture|- [output]
+ */
+
+#define REPLAY_BUFFER_LENGTH	(65536)
+#define REPLAY_TOKEN_LENGTH	(256)
+#define REPLAY_LINE_LENGTH	(1024)
+#define REPLAY_SIGNALS		(16)
+#define REPLAY_CHANNELS		(7)		// LCLK, LFRAME, LRESET, LAD0-3
+
+#define REPLAY_SAMPLE_MARKER	(0x8000)	// Kept set in the emulated data register, see lpc_emulator.c
+#define REPLAY_PINS_IDLE	(LPCEMU_LCLK_MASK | LPCEMU_LRESET_MASK | LPCEMU_LFRAME_MASK | LPCEMU_LAD_MASK)
+
+#define REPLAY_SYNC_READY	(0x0)
+#define REPLAY_SYNC_ERROR	(0xA)
+#define REPLAY_SYNC_LIMIT	(LPCEMU_LONG_SYNC_TIMEOUT + 8)
+
+#define REPLAY_CYCLE_IO_WRITE		(1)
+#define REPLAY_CYCLE_IO_READ		(2)
+#define REPLAY_CYCLE_IO_READ_ABORT	(3)
+
+#define REPLAY_RECORD_LENGTH	(16)
+
+/* ### Raw Captures ###
+ *
+ * One byte per LCLK falling edge, the signals in the reference layout (LRESET bit 5, LFRAME bit 4, LAD bits 3:0)
+ * whatever the pin map of the build (see lpc.h). They carry no time, their cycles are timed at a 33 MHz LCLK.
+ *
+ * A raw capture is mapped and decoded in batches of about REPLAY_BATCH_SAMPLES samples, each cut into chunks that
+ * begin with a START (LFRAME falling with LAD 0000). The decoder is idle at a START whatever came before it, so every
+ * chunk decodes on its own from a freshly initialized slave and yields the cycles a single pass would.
+ *
+ * The decoder itself keeps its state in its LPC_CONTEXT, but a worker drives the board's port (lpc_port) through the
+ * emulator's single register bank and answers the device hooks (LPC_HandleIORead...) with the replay's own watch state,
+ * all of them process wide. So the workers are processes (fork), each with its own copy of the slave and of that state.
+ * They take the next chunk from a shared counter until none is left, so a slow chunk does not hold up the others, and
+ * leave its records in the chunk's slot of a shared output area. The slots are written out in chunk order.
+ */
+
+#define REPLAY_BATCH_SAMPLES	(16 * 1024 * 1024)
+#define REPLAY_MIN_CHUNK	(65536)
+#define REPLAY_CHUNKS_PER_WORKER	(8)
+#define REPLAY_MAX_CHUNKS	(1024)
+#define REPLAY_MAX_WORKERS	(64)
+#define REPLAY_CYCLE_EDGES	(8)		// Fewer edges than any recorded cycle takes, bounds the records of a chunk
+#define REPLAY_RAW_PERIOD_PS	(30303)
+
+typedef struct {
+	UINT64	start;		// First sample
+	UINT64	length;
+	UINT8 *	records;	// capacity records in the shared output area
+	UINT32	capacity;
+	UINT32	count;
+	UINT32	decoded;	// I/O cycles the decoder saw
+	BOOL	overflow;
+} REPLAY_CHUNK;
+
+typedef struct {
+	volatile UINT32	next;	// Next chunk to decode, taken with an atomic increment
+	UINT32		count;
+	REPLAY_CHUNK	chunks[REPLAY_MAX_CHUNKS];
+} REPLAY_SCHEDULE;
+
+typedef enum {
+	WATCH_IDLE	= 0,
+	WATCH_SYNC	= 1,
+	WATCH_DATA_0	= 2,
+	WATCH_DATA_1	= 3
+} REPLAY_WATCH;
+
+typedef struct {
+	FILE *	file;
+	size_t	length;
+	size_t	position;
+	UINT64	bytes;
+	char	buffer[REPLAY_BUFFER_LENGTH];
+} REPLAY_READER;
+
+typedef struct {
+	char	id[REPLAY_TOKEN_LENGTH];
+	UINT8	mask;		// Pins the signal carries, one bit or LPCEMU_LAD_MASK for a 4 bit LAD vector
+} REPLAY_SIGNAL;
+
+static const UINT8	replay_channel_masks[REPLAY_CHANNELS] = { LPCEMU_LCLK_MASK, LPCEMU_LFRAME_MASK, LPCEMU_LRESET_MASK, 0x1, 0x2, 0x4, 0x8 };
+static const char *	replay_cycle_names[] = { "", "io_write", "io_read", "io_read_abort" };
+
+static REPLAY_READER	replay_reader;
+static FILE *		replay_output;				// NULL only hashes the records (-S)
+static BOOL		replay_binary = FALSE;
+static BOOL		replay_raw = FALSE;			// Write samples instead of cycles
+static UINT32		replay_hash;
+static REPLAY_CHUNK *	replay_chunk;				// Chunk being decoded by a worker
+
+static UINT8		replay_previous = REPLAY_PINS_IDLE;	// Pins before the current time
+static UINT64		replay_time;				// ps
+static UINT64		replay_edges;
+static UINT64		replay_cycles;
+static UINT64		replay_decoded;
+
+static REPLAY_WATCH	replay_watch = WATCH_IDLE;
+static UINT16		replay_watch_address;
+static UINT64		replay_watch_time;
+static UINT32		replay_watch_edge;
+static UINT32		replay_watch_clocks;
+static UINT8		replay_watch_data;
+static BOOL		replay_watch_dispatched;		// The read was dispatched on the current edge
+
+/* ### Output ### */
+
+static void REPLAY_Write(const UINT8 *record)
+{
+	UINT64 time = 0;
+	UINT16 address = (UINT16)(record[12] | (record[13] << 8));
+	UINT8 cycle = record[14];
+	int i;
+
+	replay_cycles += 1;
+
+	if(replay_output == NULL)
+	{
+		/* FNV-1a, compares the output of runs with different numbers of workers */
+		for(i = 0; i < REPLAY_RECORD_LENGTH; i++)
+		{
+			replay_hash = (replay_hash ^ record[i]) * 16777619UL;
+		}
+
+		return;
+	}
+
+	if(replay_binary)
+	{
+		fwrite(record, 1, REPLAY_RECORD_LENGTH, replay_output);
+
+		return;
+	}
+
+	for(i = 7; i >= 0; i--)
+	{
+		time = (time << 8) | record[i];
+	}
+
+	if(cycle == REPLAY_CYCLE_IO_READ_ABORT)
+	{
+		fprintf(replay_output, "%.3f,%s,0x%04X,\n", (double)time / 1000.0, replay_cycle_names[cycle], address);
+	}
+	else
+	{
+		fprintf(replay_output, "%.3f,%s,0x%04X,0x%02X\n", (double)time / 1000.0, replay_cycle_names[cycle], address, record[15]);
+	}
+}
+
+static void REPLAY_Emit(UINT8 cycle, UINT16 address, UINT8 data, UINT64 time, UINT32 edge)
+{
+	UINT8 buffer[REPLAY_RECORD_LENGTH];
+	UINT8 *record = buffer;
+	int i;
+
+	if(replay_chunk != NULL)
+	{
+		if(replay_chunk->count == replay_chunk->capacity)
+		{
+			replay_chunk->overflow = TRUE;
+
+			return;
+		}
+
+		record = &replay_chunk->records[replay_chunk->count * REPLAY_RECORD_LENGTH];
+		replay_chunk->count += 1;
+	}
+
+	for(i = 0; i < 8; i++)
+	{
+		record[i] = (UINT8)(time >> (8 * i));
+	}
+
+	for(i = 0; i < 4; i++)
+	{
+		record[8 + i] = (UINT8)(edge >> (8 * i));
+	}
+
+	record[12] = (UINT8)address;
+	record[13] = (UINT8)(address >> 8);
+	record[14] = cycle;
+	record[15] = data;
+
+	if(replay_chunk == NULL) REPLAY_Write(record);
+}
+
+/* ### I/O Dispatch ###
+ *
+ * Stands in for lpc_io_dispatch.c: the decoder hands every I/O cycle to these. Nothing else is linked, so the
+ * message protocol and the counters are not registered and no device answers on the emulated bus.
+ */
+
+BOOL LPC_RegisterIODevice(LPC_CONTEXT *lpc, UINT16 base, UINT16 length, LPC_IO_READ_HANDLER read, LPC_IO_WRITE_HANDLER write, void *context)
+{
+	return TRUE;
+}
+
+void LPC_ResetIODevices(LPC_CONTEXT *lpc)
+{
+}
+
+BOOL LPC_RegisterIOMessages(LPC_CONTEXT *lpc, LPC_MESSAGES *messages, UINT16 base)
+{
+	return TRUE;
+}
+
+BOOL LPC_HandleDMARead(LPC_MESSAGES *messages, UINT8 channel, UINT8 data, BOOL terminal)
+{
+	return FALSE;
+}
+
+BOOL LPC_HandleDMAWrite(LPC_MESSAGES *messages, UINT8 channel, UINT8 *data, BOOL terminal, BOOL *more)
+{
+	return FALSE;
+}
+
+void LPC_ResetIOMessages(LPC_MESSAGES *messages)
+{
+}
+
+/* Aborted reads are found in the capture, see REPLAY_WatchRead */
+void LPC_HandleIOAbort(LPC_CONTEXT *lpc, UINT16 address)
+{
+}
+
+void LPC_HandleIOWrite(LPC_CONTEXT *lpc, UINT16 address, UINT8 data)
+{
+	REPLAY_Emit(REPLAY_CYCLE_IO_WRITE, address, data, replay_time, (UINT32)replay_edges);
+}
+
+/* The read is recorded once its data went by, see REPLAY_WatchRead */
+LPC_IO_READ_RESULT LPC_HandleIORead(LPC_CONTEXT *lpc, UINT16 address, UINT8 *data)
+{
+	if(replay_watch != WATCH_IDLE) REPLAY_Emit(REPLAY_CYCLE_IO_READ_ABORT, replay_watch_address, 0, replay_watch_time, replay_watch_edge);
+
+	replay_watch = WATCH_SYNC;
+	replay_watch_address = address;
+	replay_watch_time = replay_time;
+	replay_watch_edge = (UINT32)replay_edges;
+	replay_watch_clocks = 0;
+	replay_watch_dispatched = TRUE;
+
+	(*data) = 0xFF;
+
+	return IO_READ_READY;
+}
+
+/* ### Sampling ### */
+
+static void REPLAY_WatchRead(UINT8 sample)
+{
+	UINT8 lad = sample & LPCEMU_LAD_MASK;
+
+	if(replay_watch == WATCH_IDLE) return;
+
+	/* LFRAME during the cycle, the host aborted it */
+	if(!(sample & LPCEMU_LFRAME_MASK) || (replay_watch_clocks++ > REPLAY_SYNC_LIMIT))
+	{
+		REPLAY_Emit(REPLAY_CYCLE_IO_READ_ABORT, replay_watch_address, 0, replay_watch_time, replay_watch_edge);
+		replay_watch = WATCH_IDLE;
+
+		return;
+	}
+
+	switch(replay_watch)
+	{
+		case WATCH_SYNC: {
+
+			/* Turnaround and wait syncs go by until the ready sync */
+			if(lad == REPLAY_SYNC_READY) replay_watch = WATCH_DATA_0;
+
+			if(lad == REPLAY_SYNC_ERROR)
+			{
+				REPLAY_Emit(REPLAY_CYCLE_IO_READ_ABORT, replay_watch_address, 0, replay_watch_time, replay_watch_edge);
+				replay_watch = WATCH_IDLE;
+			}
+
+		} break;
+
+		case WATCH_DATA_0: {
+
+			replay_watch_data = lad;
+			replay_watch = WATCH_DATA_1;
+
+		} break;
+
+		case WATCH_DATA_1: {
+
+			replay_watch_data |= (UINT8)(lad << 4);
+			replay_watch = WATCH_IDLE;
+
+			REPLAY_Emit(REPLAY_CYCLE_IO_READ, replay_watch_address, replay_watch_data, replay_watch_time, replay_watch_edge);
+
+		} break;
+
+		case WATCH_IDLE: break;
+	}
+}
+
+/* A read still waiting for its data when the capture (or chunk) ends */
+static void REPLAY_FlushWatch(void)
+{
+	if(replay_watch != WATCH_IDLE) REPLAY_Emit(REPLAY_CYCLE_IO_READ_ABORT, replay_watch_address, 0, replay_watch_time, replay_watch_edge);
+
+	replay_watch = WATCH_IDLE;
+}
+
+/* Boot the slave on the emulated GPIO bank and claim every I/O address */
+static void REPLAY_Reset(void)
+{
+	LPC_DECODE_STATS stats;
+
+	LPCEMU_Initialize();
+	LPC_SetDecodeWindow(&lpc_port, 0, 0x0000, 0xFFFF);
+	LPC_GetDecodeStats(&lpc_port, &stats, TRUE);
+
+	replay_watch = WATCH_IDLE;
+	replay_watch_dispatched = FALSE;
+}
+
+/* One LCLK falling edge at replay_time, sample holds the pins other than LCLK */
+static void REPLAY_Edge(UINT8 sample)
+{
+	/* Watch the capture before the decoder, a read it dispatches on this edge has its data on later ones */
+	REPLAY_WatchRead(sample);
+
+	(*gpio_data_register) = REPLAY_SAMPLE_MARKER | LPC_SCATTER_PINS(sample);
+	LPC_HandleCycle(&lpc_port);
+
+#ifdef LPC_DEFERRED_DECODE
+	LPC_ProcessSamples(&lpc_port);
+#endif
+
+	/* The decoder dispatches a read on its first SYNC clock, a peripheral without wait states drives ready on it */
+	if(replay_watch_dispatched)
+	{
+		replay_watch_dispatched = FALSE;
+
+		REPLAY_WatchRead(sample);
+	}
+
+	replay_edges += 1;
+}
+
+/* The pins at time, LCLK falling since the previous call delivers an edge sampled with the pins before */
+static void REPLAY_Advance(UINT64 time, UINT8 pins)
+{
+	UINT8 sample;
+
+	replay_time = time;
+
+	if((replay_previous & LPCEMU_LCLK_MASK) && !(pins & LPCEMU_LCLK_MASK))
+	{
+		sample = replay_previous & ~LPCEMU_LCLK_MASK;
+
+		if(replay_raw)
+		{
+			fputc(sample, replay_output);
+			replay_edges += 1;
+		}
+		else
+		{
+			REPLAY_Edge(sample);
+		}
+	}
+
+	replay_previous = pins;
+}
+
+/* ### Input ### */
+
+static int REPLAY_Getc(REPLAY_READER *reader)
+{
+	if(reader->position == reader->length)
+	{
+		reader->length = fread(reader->buffer, 1, REPLAY_BUFFER_LENGTH, reader->file);
+		reader->position = 0;
+		reader->bytes += reader->length;
+
+		if(reader->length == 0) return EOF;
+	}
+
+	return (unsigned char)reader->buffer[reader->position++];
+}
+
+/* Next whitespace separated token, FALSE at the end of the input */
+static BOOL REPLAY_Token(REPLAY_READER *reader, char *token)
+{
+	int length = 0;
+	int c;
+
+	do
+	{
+		c = REPLAY_Getc(reader);
+	}
+	while((c != EOF) && isspace(c));
+
+	while((c != EOF) && !isspace(c))
+	{
+		if(length < (REPLAY_TOKEN_LENGTH - 1)) token[length++] = (char)c;
+
+		c = REPLAY_Getc(reader);
+	}
+
+	token[length] = '\0';
+
+	return (length != 0);
+}
+
+/* Next line without its line break, FALSE at the end of the input */
+static BOOL REPLAY_Line(REPLAY_READER *reader, char *line)
+{
+	int length = 0;
+	int c = REPLAY_Getc(reader);
+
+	if(c == EOF) return FALSE;
+
+	while((c != EOF) && (c != '\n'))
+	{
+		if((c != '\r') && (length < (REPLAY_LINE_LENGTH - 1))) line[length++] = (char)c;
+
+		c = REPLAY_Getc(reader);
+	}
+
+	line[length] = '\0';
+
+	return TRUE;
+}
+
+/* Pins a signal name stands for, width is the number of bits it has (0 if it is not an LPC signal) */
+static UINT8 REPLAY_SignalMask(const char *name, int width)
+{
+	char upper[REPLAY_TOKEN_LENGTH];
+	const char *bit;
+	int i;
+
+	for(i = 0; name[i] && (i < (REPLAY_TOKEN_LENGTH - 1)); i++)
+	{
+		upper[i] = (char)toupper((unsigned char)name[i]);
+	}
+
+	upper[i] = '\0';
+
+	/* Names may carry a scope prefix (top.lpc.LAD) */
+	name = strrchr(upper, '.') ? (strrchr(upper, '.') + 1) : upper;
+
+	if(width == 1)
+	{
+		if(strncmp(name, "LCLK", 4) == 0) return LPCEMU_LCLK_MASK;
+		if(strncmp(name, "LFRAME", 6) == 0) return LPCEMU_LFRAME_MASK;
+		if(strncmp(name, "LRESET", 6) == 0) return LPCEMU_LRESET_MASK;
+	}
+
+	if(strncmp(name, "LAD", 3) == 0)
+	{
+		if(width == 4) return LPCEMU_LAD_MASK;
+
+		bit = name + 3;
+		if(*bit == '[') bit += 1;
+
+		if((width == 1) && (*bit >= '0') && (*bit <= '3')) return (UINT8)(1 << (*bit - '0'));
+	}
+
+	return 0;
+}
+
+/* Value of a signal as 4 bits (scalars in bit 0), x and z read as pulled up */
+static UINT8 REPLAY_SignalValue(const char *value)
+{
+	UINT8 bits = 0;
+
+	for(; *value; value++)
+	{
+		bits = (UINT8)((bits << 1) | ((*value == '0') ? 0 : 1));
+	}
+
+	return bits & 0xF;
+}
+
+static UINT8 REPLAY_ApplySignal(UINT8 pins, const REPLAY_SIGNAL *signal, UINT8 value)
+{
+	if(signal->mask == LPCEMU_LAD_MASK) return (UINT8)((pins & ~LPCEMU_LAD_MASK) | value);
+
+	return (value & 1) ? (UINT8)(pins | signal->mask) : (UINT8)(pins & ~signal->mask);
+}
+
+/* ### VCD ### */
+
+static double REPLAY_TimescalePs(const char *timescale)
+{
+	static const char *units[] = { "fs", "ps", "ns", "us", "ms", "s" };
+	static const double factors[] = { 1e-3, 1, 1e3, 1e6, 1e9, 1e12 };
+	char *unit;
+	double magnitude = strtod(timescale, &unit);
+	int i;
+
+	if(magnitude == 0) magnitude = 1;
+
+	for(i = 0; i < (int)(sizeof(units) / sizeof(units[0])); i++)
+	{
+		if(strcmp(unit, units[i]) == 0) return magnitude * factors[i];
+	}
+
+	return magnitude;
+}
+
+static BOOL REPLAY_VCD(void)
+{
+	REPLAY_SIGNAL signals[REPLAY_SIGNALS];
+	int signal_count = 0;
+	char token[REPLAY_TOKEN_LENGTH];
+	char value[REPLAY_TOKEN_LENGTH];
+	char timescale[REPLAY_TOKEN_LENGTH] = "1ns";
+	char width[REPLAY_TOKEN_LENGTH];
+	double scale;
+	UINT64 time = 0;
+	UINT8 pins = REPLAY_PINS_IDLE;
+	UINT8 mask;
+	const char *id;
+	int i;
+
+	/* Header: $timescale and the $var definitions of the LPC signals */
+	while(REPLAY_Token(&replay_reader, token) && strcmp(token, "$enddefinitions"))
+	{
+		if(strcmp(token, "$timescale") == 0)
+		{
+			timescale[0] = '\0';
+
+			while(REPLAY_Token(&replay_reader, token) && strcmp(token, "$end"))
+			{
+				if((strlen(timescale) + strlen(token)) < (REPLAY_TOKEN_LENGTH - 1)) strcat(timescale, token);
+			}
+		}
+		else if(strcmp(token, "$var") == 0)
+		{
+			/* $var type width id reference [range] $end */
+			if(!REPLAY_Token(&replay_reader, token) || !REPLAY_Token(&replay_reader, width)) return FALSE;
+			if(!REPLAY_Token(&replay_reader, value) || !REPLAY_Token(&replay_reader, token)) return FALSE;
+
+			mask = REPLAY_SignalMask(token, atoi(width));
+
+			if(mask && (signal_count < REPLAY_SIGNALS))
+			{
+				strcpy(signals[signal_count].id, value);
+				signals[signal_count].mask = mask;
+				signal_count += 1;
+			}
+
+			while(strcmp(token, "$end") && REPLAY_Token(&replay_reader, token));
+		}
+	}
+
+	for(mask = 0, i = 0; i < signal_count; i++)
+	{
+		mask |= signals[i].mask;
+	}
+
+	if(!(mask & LPCEMU_LCLK_MASK) || ((mask & (LPCEMU_LFRAME_MASK | LPCEMU_LAD_MASK)) != (LPCEMU_LFRAME_MASK | LPCEMU_LAD_MASK)))
+	{
+		fprintf(stderr, "vcd: LCLK, LFRAME and LAD not found\n");
+
+		return FALSE;
+	}
+
+	scale = REPLAY_TimescalePs(timescale);
+
+	/* Value changes, the pins at a time are complete when the next time starts */
+	while(REPLAY_Token(&replay_reader, token))
+	{
+		switch(token[0])
+		{
+			case '#': {
+
+				REPLAY_Advance(time, pins);
+				time = (UINT64)(strtod(&token[1], NULL) * scale);
+
+			} continue;
+
+			case '$': continue;		// $dumpvars, $end, ...
+
+			case 'b':
+			case 'B': {
+
+				strcpy(value, &token[1]);
+				if(!REPLAY_Token(&replay_reader, token)) return TRUE;
+				id = token;
+
+			} break;
+
+			case 'r':
+			case 'R': {
+
+				REPLAY_Token(&replay_reader, token);
+
+			} continue;
+
+			default: {
+
+				value[0] = token[0];
+				value[1] = '\0';
+				id = &token[1];
+
+			} break;
+		}
+
+		for(i = 0; i < signal_count; i++)
+		{
+			if(strcmp(signals[i].id, id) == 0) pins = REPLAY_ApplySignal(pins, &signals[i], REPLAY_SignalValue(value));
+		}
+	}
+
+	REPLAY_Advance(time, pins);
+
+	return TRUE;
+}
+
+/* ### CSV ### */
+
+static BOOL REPLAY_CSV(int *columns)
+{
+	char line[REPLAY_LINE_LENGTH];
+	char *field;
+	char *next;
+	UINT8 pins;
+	UINT8 value;
+	UINT64 time;
+	int column;
+	int channel;
+
+	if(!REPLAY_Line(&replay_reader, line)) return FALSE;
+
+	/* Columns named after the signals override the column list */
+	for(field = line, column = 0; field != NULL; field = next, column++)
+	{
+		next = strchr(field, ',');
+		if(next != NULL) (*next++) = '\0';
+
+		for(channel = 0; channel < REPLAY_CHANNELS; channel++)
+		{
+			if(REPLAY_SignalMask(field, 1) == replay_channel_masks[channel]) columns[channel] = column;
+		}
+	}
+
+	while(REPLAY_Line(&replay_reader, line))
+	{
+		pins = REPLAY_PINS_IDLE;
+		time = (UINT64)(strtod(line, NULL) * 1e12);
+
+		for(field = line, column = 0; field != NULL; field = next, column++)
+		{
+			next = strchr(field, ',');
+			if(next != NULL) next += 1;
+
+			if(column == 0) continue;
+
+			value = (UINT8)(atoi(field) != 0);
+
+			for(channel = 0; channel < REPLAY_CHANNELS; channel++)
+			{
+				if((columns[channel] == column) && !value) pins &= ~replay_channel_masks[channel];
+			}
+		}
+
+		REPLAY_Advance(time, pins);
+	}
+
+	return TRUE;
+}
+
+/* ### Parallel Decode ### */
+
+/* First START at or after from (before end), end if there is none within REPLAY_BATCH_SAMPLES (an idle bus can be cut anywhere) */
+static UINT64 REPLAY_NextStart(const UINT8 *samples, UINT64 from, UINT64 end)
+{
+	UINT64 limit = ((end - from) > REPLAY_BATCH_SAMPLES) ? (from + REPLAY_BATCH_SAMPLES) : end;
+	UINT64 i;
+
+	for(i = (from == 0) ? 1 : from; i < limit; i++)
+	{
+		if((samples[i - 1] & LPCEMU_LFRAME_MASK) && ((samples[i] & (LPCEMU_LFRAME_MASK | LPCEMU_LAD_MASK)) == 0)) return i;
+	}
+
+	return limit;
+}
+
+static void REPLAY_Schedule(REPLAY_SCHEDULE *schedule, UINT8 *output, const UINT8 *samples, UINT64 start, UINT64 end, int workers)
+{
+	UINT64 target = (end - start) / ((UINT64)workers * REPLAY_CHUNKS_PER_WORKER);
+	REPLAY_CHUNK *chunk;
+	UINT64 next;
+
+	if(target < REPLAY_MIN_CHUNK) target = REPLAY_MIN_CHUNK;
+
+	schedule->next = 0;
+	schedule->count = 0;
+
+	while(start < end)
+	{
+		next = (((end - start) > target) && (schedule->count < (REPLAY_MAX_CHUNKS - 1))) ? REPLAY_NextStart(samples, start + target, end) : end;
+
+		chunk = &schedule->chunks[schedule->count++];
+		chunk->start = start;
+		chunk->length = next - start;
+		chunk->records = output;
+		chunk->capacity = (UINT32)(chunk->length / REPLAY_CYCLE_EDGES) + 2;
+		chunk->count = 0;
+		chunk->decoded = 0;
+		chunk->overflow = FALSE;
+
+		output += (UINT64)chunk->capacity * REPLAY_RECORD_LENGTH;
+		start = next;
+	}
+}
+
+static void REPLAY_DecodeChunk(const UINT8 *samples, REPLAY_CHUNK *chunk)
+{
+	LPC_DECODE_STATS stats;
+	UINT64 i;
+
+	REPLAY_Reset();
+
+	replay_chunk = chunk;
+	replay_edges = chunk->start;
+
+	for(i = chunk->start; i < (chunk->start + chunk->length); i++)
+	{
+		replay_time = replay_edges * REPLAY_RAW_PERIOD_PS;
+		REPLAY_Edge(samples[i]);
+	}
+
+	REPLAY_FlushWatch();
+
+	LPC_GetDecodeStats(&lpc_port, &stats, FALSE);
+	chunk->decoded = stats.cycles;
+
+	replay_chunk = NULL;
+}
+
+static void REPLAY_Work(REPLAY_SCHEDULE *schedule, const UINT8 *samples)
+{
+	UINT32 index;
+
+	while((index = __sync_fetch_and_add(&schedule->next, 1)) < schedule->count)
+	{
+		REPLAY_DecodeChunk(samples, &schedule->chunks[index]);
+	}
+}
+
+/* Decode a mapped raw capture with the given number of worker processes (1 decodes in this process) */
+static BOOL REPLAY_Parallel(const UINT8 *samples, UINT64 length, int workers)
+{
+	static REPLAY_SCHEDULE *schedule = NULL;
+	static UINT8 *output = NULL;
+	UINT64 output_length = ((2ULL * REPLAY_BATCH_SAMPLES / REPLAY_CYCLE_EDGES) + (2 * REPLAY_MAX_CHUNKS)) * REPLAY_RECORD_LENGTH;
+	UINT64 start;
+	UINT64 end;
+	UINT32 chunk;
+	UINT32 i;
+	int worker;
+
+	if(schedule == NULL)
+	{
+		schedule = (REPLAY_SCHEDULE *)mmap(NULL, sizeof(REPLAY_SCHEDULE), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+		output = (UINT8 *)mmap(NULL, output_length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+		if((schedule == MAP_FAILED) || (output == MAP_FAILED))
+		{
+			fprintf(stderr, "lpc_replay: cannot map the output area\n");
+			schedule = NULL;
+
+			return FALSE;
+		}
+	}
+
+	for(start = 0; start < length; start = end)
+	{
+		end = ((length - start) > REPLAY_BATCH_SAMPLES) ? REPLAY_NextStart(samples, start + REPLAY_BATCH_SAMPLES, length) : length;
+
+		REPLAY_Schedule(schedule, output, samples, start, end, workers);
+
+		if(workers == 1)
+		{
+			REPLAY_Work(schedule, samples);
+		}
+		else
+		{
+			for(worker = 0; worker < workers; worker++)
+			{
+				if(fork() == 0)
+				{
+					REPLAY_Work(schedule, samples);
+					_exit(0);
+				}
+			}
+
+			while(wait(NULL) > 0);
+		}
+
+		/* Merge in capture order */
+		for(chunk = 0; chunk < schedule->count; chunk++)
+		{
+			if(schedule->chunks[chunk].overflow)
+			{
+				fprintf(stderr, "lpc_replay: too many cycles in chunk at sample %llu\n", (unsigned long long)schedule->chunks[chunk].start);
+
+				return FALSE;
+			}
+
+			for(i = 0; i < schedule->chunks[chunk].count; i++)
+			{
+				REPLAY_Write(&schedule->chunks[chunk].records[i * REPLAY_RECORD_LENGTH]);
+			}
+
+			replay_decoded += schedule->chunks[chunk].decoded;
+		}
+	}
+
+	replay_edges = length;
+
+	return TRUE;
+}
+
+static double REPLAY_Seconds(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (double)now.tv_sec + ((double)now.tv_nsec / 1e9);
+}
+
+/* ### Scaling Benchmark ###
+ *
+ * Decodes the raw capture with 1, 2, 4, ... workers (output hashed, not written), checks that every run yields the
+ * records of the single worker run and reports samples per second and the speedup over one worker.
+ */
+
+static BOOL REPLAY_Scaling(const UINT8 *samples, UINT64 length, int max_workers)
+{
+	UINT32 hash = 0;
+	double baseline = 0;
+	double seconds;
+	int workers;
+
+	replay_output = NULL;
+
+	printf("%-8s %16s %10s %12s\n", "workers", "samples/s", "speedup", "cycles");
+
+	for(workers = 1; workers <= max_workers; workers *= 2)
+	{
+		replay_hash = 2166136261UL;
+		replay_cycles = 0;
+
+		seconds = REPLAY_Seconds();
+		if(!REPLAY_Parallel(samples, length, workers)) return FALSE;
+		seconds = REPLAY_Seconds() - seconds;
+
+		if(workers == 1)
+		{
+			hash = replay_hash;
+			baseline = seconds;
+		}
+		else if(replay_hash != hash)
+		{
+			printf("%d workers: output differs from 1 worker\n", workers);
+
+			return FALSE;
+		}
+
+		printf("%-8d %16.0f %9.2fx %12llu\n", workers, (double)length / seconds, baseline / seconds, (unsigned long long)replay_cycles);
+	}
+
+	return TRUE;
+}
+
+int main(int argc, char *argv[])
+{
+	int columns[REPLAY_CHANNELS] = { 1, 2, 3, 4, 5, 6, 7 };
+	const char *format = NULL;
+	const char *input = NULL;
+	const char *output = NULL;
+	const char *extension;
+	const UINT8 *samples = NULL;
+	struct stat status;
+	LPC_DECODE_STATS stats;
+	double seconds;
+	BOOL scaling = FALSE;
+	BOOL ok;
+	int workers = 1;
+	int channel;
+	int fd;
+	int i;
+
+	for(i = 1; i < argc; i++)
+	{
+		if(strcmp(argv[i], "-b") == 0)
+		{
+			replay_binary = TRUE;
+		}
+		else if(strcmp(argv[i], "-r") == 0)
+		{
+			replay_raw = TRUE;
+		}
+		else if(strcmp(argv[i], "-S") == 0)
+		{
+			scaling = TRUE;
+		}
+		else if((strcmp(argv[i], "-f") == 0) && ((i + 1) < argc))
+		{
+			format = argv[++i];
+		}
+		else if((strcmp(argv[i], "-j") == 0) && ((i + 1) < argc))
+		{
+			workers = atoi(argv[++i]);
+
+			if(workers < 1) workers = 1;
+			if(workers > REPLAY_MAX_WORKERS) workers = REPLAY_MAX_WORKERS;
+		}
+		else if((strcmp(argv[i], "-c") == 0) && ((i + 1) < argc))
+		{
+			for(channel = 0, extension = argv[++i]; (channel < REPLAY_CHANNELS) && extension; channel++)
+			{
+				columns[channel] = atoi(extension);
+				extension = strchr(extension, ',');
+				if(extension != NULL) extension += 1;
+			}
+		}
+		else if(input == NULL)
+		{
+			input = argv[i];
+		}
+		else
+		{
+			output = argv[i];
+		}
+	}
+
+	if(input == NULL)
+	{
+		fprintf(stderr, "usage: lpc_replay [-b | -r] [-f vcd|csv|raw] [-c lclk,lframe,lreset,lad0,lad1,lad2,lad3] [-j workers] [-S] capture|- [output]\n");
+
+		return 2;
+	}
+
+	if(format == NULL)
+	{
+		extension = strrchr(input, '.');
+		format = (extension == NULL) ? "csv" : (strcmp(extension, ".vcd") == 0) ? "vcd" : (strcmp(extension, ".raw") == 0) ? "raw" : "csv";
+	}
+
+	if(replay_raw && (strcmp(format, "raw") == 0))
+	{
+		fprintf(stderr, "lpc_replay: the capture is raw already\n");
+
+		return 2;
+	}
+
+	if((strcmp(format, "raw") != 0) && ((workers > 1) || scaling))
+	{
+		fprintf(stderr, "lpc_replay: -j and -S decode raw captures, convert with -r first\n");
+
+		return 2;
+	}
+
+	replay_output = (output == NULL) ? stdout : fopen(output, (replay_binary || replay_raw) ? "wb" : "w");
+
+	if(replay_output == NULL)
+	{
+		fprintf(stderr, "lpc_replay: cannot open %s\n", output);
+
+		return 1;
+	}
+
+	if(strcmp(format, "raw") == 0)
+	{
+		fd = open(input, O_RDONLY);
+
+		if((fd < 0) || (fstat(fd, &status) != 0))
+		{
+			fprintf(stderr, "lpc_replay: cannot open %s\n", input);
+
+			return 1;
+		}
+
+		if(status.st_size > 0)
+		{
+			samples = (const UINT8 *)mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+			if(samples == MAP_FAILED)
+			{
+				fprintf(stderr, "lpc_replay: cannot map %s\n", input);
+
+				return 1;
+			}
+
+			madvise((void *)samples, (size_t)status.st_size, MADV_SEQUENTIAL);
+		}
+
+		replay_reader.bytes = (UINT64)status.st_size;
+
+		if(scaling) return REPLAY_Scaling(samples, (UINT64)status.st_size, workers) ? 0 : 1;
+
+		if(!replay_binary) fprintf(replay_output, "time_ns,cycle,address,data\n");
+
+		seconds = REPLAY_Seconds();
+		ok = REPLAY_Parallel(samples, (UINT64)status.st_size, workers);
+		seconds = REPLAY_Seconds() - seconds;
+	}
+	else
+	{
+		replay_reader.file = (strcmp(input, "-") == 0) ? stdin : fopen(input, "rb");
+
+		if(replay_reader.file == NULL)
+		{
+			fprintf(stderr, "lpc_replay: cannot open %s\n", input);
+
+			return 1;
+		}
+
+		REPLAY_Reset();
+
+		if(!replay_binary && !replay_raw) fprintf(replay_output, "time_ns,cycle,address,data\n");
+
+		seconds = REPLAY_Seconds();
+		ok = (strcmp(format, "vcd") == 0) ? REPLAY_VCD() : REPLAY_CSV(columns);
+		seconds = REPLAY_Seconds() - seconds;
+
+		REPLAY_FlushWatch();
+
+		LPC_GetDecodeStats(&lpc_port, &stats, FALSE);
+		replay_decoded = stats.cycles;
+
+		if(replay_reader.file != stdin) fclose(replay_reader.file);
+	}
+
+	fprintf(stderr, "%llu bytes %llu edges %llu i/o cycles decoded %llu recorded, %.2f s, %.1f MB/s, %.0f edges/s\n",
+		(unsigned long long)replay_reader.bytes,
+		(unsigned long long)replay_edges,
+		(unsigned long long)replay_decoded,
+		(unsigned long long)replay_cycles,
+		seconds,
+		(double)replay_reader.bytes / (seconds * 1e6),
+		(double)replay_edges / seconds);
+
+	if(replay_output != stdout) fclose(replay_output);
+
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "debug.h"
+
+/* ### Trace Decoder ###
+ *
+ * Turns a dump of DEBUG_RECORDs (drained from the slave's trace ring, little endian, 12 bytes each)
+ * into a transaction log, one line per record with the time since the previous one: LCLK edges at DEBUG_LEVEL_EDGE,
+ * the target's DEBUG_TIMESTAMP timer, or else the record number (see debug.h).
+ *
+ * Build: gcc -I. host/lpc_trace.c -o lpc_trace
+ * Usage: lpc_trace dump
+ */
+
+#define TRACE_RECORD_LENGTH	(12)
+
+static const char *trace_read_results[] = { "retry", "ready", "pending" };
+
+static UINT32 TRACE_Get32(const UINT8 *bytes)
+{
+	return (UINT32)bytes[0] | ((UINT32)bytes[1] << 8) | ((UINT32)bytes[2] << 16) | ((UINT32)bytes[3] << 24);
+}
+
+static void TRACE_Print(const DEBUG_RECORD *record)
+{
+	switch(record->event)
+	{
+		case DEBUG_EVENT_EDGE: {
+
+			printf("edge      state %2u  LFRAME %u  LAD %X\n", record->state, (unsigned)((record->data >> 4) & 1), (unsigned)(record->data & 0xF));
+
+		} break;
+
+		case DEBUG_EVENT_IO_READ: {
+
+			printf("io read   0x%04X -> 0x%02X (%s)\n", record->address, (unsigned)(record->data & 0xFF),
+				(record->state < 3) ? trace_read_results[record->state] : "?");
+
+		} break;
+
+		case DEBUG_EVENT_IO_WRITE: {
+
+			printf("io write  0x%04X <- 0x%02X\n", record->address, (unsigned)(record->data & 0xFF));
+
+		} break;
+
+		case DEBUG_EVENT_ABORT: {
+
+			printf("abort     in state %u\n", record->state);
+
+		} break;
+
+		case DEBUG_EVENT_MSG_LENGTH: {
+
+			printf("message   length %lu, %s\n", (unsigned long)record->data, record->state ? "slot claimed" : "refused (queue full)");
+
+		} break;
+
+		case DEBUG_EVENT_MSG_CHECK: {
+
+			printf("message   check 0x%08lX %s\n", (unsigned long)record->data, record->state ? "passed" : "failed");
+
+		} break;
+
+		case DEBUG_EVENT_MSG_ACK: {
+
+			printf("message   page %u ACK read 0x%02X\n", record->state, (unsigned)(record->data & 0xFF));
+
+		} break;
+
+		case DEBUG_EVENT_MSG_COMMIT: {
+
+			printf("message   committed, %lu bytes, %u queued\n", (unsigned long)record->data, record->state);
+
+		} break;
+
+		case DEBUG_EVENT_REPLY_ACK: {
+
+			printf("reply     page %u ACK written 0x%02X\n", record->state, (unsigned)(record->data & 0xFF));
+
+		} break;
+
+		case DEBUG_EVENT_RESET: {
+
+			printf("reset     in state %u\n", record->state);
+
+		} break;
+
+		case DEBUG_EVENT_IO_READ_ABORT: {
+
+			printf("io read   0x%04X aborted, taken back\n", record->address);
+
+		} break;
+
+		default: {
+
+			printf("event %u  state %u  address 0x%04X  data 0x%08lX\n", record->event, record->state, record->address, (unsigned long)record->data);
+
+		} break;
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	UINT8 bytes[TRACE_RECORD_LENGTH];
+	DEBUG_RECORD record;
+	UINT32 last = 0;
+	unsigned long count = 0;
+	FILE *file;
+
+	if(argc < 2)
+	{
+		printf("Usage: %s dump\n", argv[0]);
+		return 1;
+	}
+
+	file = fopen(argv[1], "rb");
+
+	if(file == NULL)
+	{
+		printf("cannot read %s\n", argv[1]);
+		return 1;
+	}
+
+	printf("%10s %8s  %s\n", "time", "+time", "transaction");
+
+	while(fread(bytes, 1, TRACE_RECORD_LENGTH, file) == TRACE_RECORD_LENGTH)
+	{
+		record.timestamp = TRACE_Get32(&bytes[0]);
+		record.data = TRACE_Get32(&bytes[4]);
+		record.address = (UINT16)(bytes[8] | (bytes[9] << 8));
+		record.event = bytes[10];
+		record.state = bytes[11];
+
+		printf("%10lu %8lu  ", (unsigned long)record.timestamp, (unsigned long)((count == 0) ? 0 : (record.timestamp - last)));
+		TRACE_Print(&record);
+
+		last = record.timestamp;
+		count += 1;
+	}
+
+	fclose(file);
+
+	printf("%lu records\n", count);
+
+	return 0;
+}
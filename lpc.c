@@ -1,480 +1,1885 @@
-#include "lpc.h"
-#include "gpio.h"
-#include "interrupt.h"
-#include "debug.h"
-
-/* TODO:
- * - The ABORT state has not been implemented
- * - The LRESET has not been implemented
- */
-
-/***********************************/
-/* ##### ##### Globals ##### ##### */
-/***********************************/
-
-#define LPC_MASK		(0x7F)		// 0000 0000 0111 1111 b
-
-#define LPC_LCLK_MASK		(0x40)		// 0000 0000 0100 0000 b
-#define LPC_LRESET_MASK		(0x20)		// 0000 0000 0010 0000 b
-#define LPC_LFRAME_MASK		(0x10)		// 0000 0000 0001 0000 b
-
-#define LPC_LAD_MASK		(0xF)		// 0000 0000 0000 1111 b
-#define LPC_CYCTYPE_MASK	(0xC)		// 0000 0000 0000 1100 b
-#define LPC_DIR_MASK		(0x2)		// 0000 0000 0000 0010 b
-
-typedef enum {
-	FRAME_START		= 0x0,		// 0000b
-	FRAME_ABORT		= 0xF		// 1111b
-} LPC_FRAME;
-
-typedef enum {
-	CYCTYPE_IO		= 0x0,		// 00b
-	CYCTYPE_MEMORY		= 0x1,		// 01b
-	CYCTYPE_DMA		= 0x3		// 11b
-} LPC_CYCTYPE;
-
-typedef enum {
-	DIR_READ		= 0x0,		// 0b
-	DIR_WRITE		= 0x1		// 1b
-} LPC_DIR;
-
-typedef enum {
-	SYNC_READY		= 0x0,		// 0000b
-	SYNC_SHORT_WAIT		= 0x5,		// 0101b
-	SYNC_LONG_WAIT		= 0x6,		// 0110b
-	SYNC_ERROR		= 0xA		// 1010b
-} LPC_SYNC;
-
-typedef enum {
-	// Note: These enumerations are assigned values for debugging purposes only
-	STATE_IDLE				= 0,
-	STATE_CYCTYPE_AND_DIR			= 1,
-	STATE_ADDR_0				= 2,
-	STATE_ADDR_1				= 3,
-	STATE_ADDR_2				= 4,
-	STATE_ADDR_3				= 5,
-	STATE_DATA_WRITE_0			= 6,
-	STATE_DATA_WRITE_1			= 7,
-	STATE_TAR_TO_PERIPHERAL_0		= 8,
-	STATE_TAR_TO_PERIPHERAL_1		= 9,
-	STATE_SYNC				= 10,
-	STATE_DATA_READ_0			= 11,
-	STATE_DATA_READ_1			= 12,
-	STATE_TAR_TO_HOST_0			= 13,
-	STATE_TAR_TO_HOST_1			= 14,
-	STATE_ABORT				= 15
-} LPC_IO_CYCLE_STATE;
-
-LPC_IO_CYCLE_STATE lpc_state;
-
-LPC_FRAME	lpc_frame_info;
-LPC_CYCTYPE	lpc_cycle_type;
-LPC_DIR		lpc_direction;
-UINT16		lpc_address;
-UINT8		lpc_data;
-LPC_SYNC	lpc_synchronize_info;
-
-/**************************************/
-/* ##### ##### Prototypes ##### ##### */
-/**************************************/
-
-void				LPC_Initialize(void);
-void				LPC_ISR(void);
-
-__inline UINT16			LPC_ReadSignal(void);
-__inline void			LPC_WriteSignal(UINT8 values);
-
-__inline void			LPC_TurnAroundToPeripheral(void);
-__inline void			LPC_TurnAroundToHost(void);
-
-__inline LPC_IO_CYCLE_STATE	LPC_GetState(void);
-__inline void			LPC_SetState(LPC_IO_CYCLE_STATE state);
-
-void				LPC_HandleCycle(void);
-
-// Protocols for io read and write
-
-extern BOOL			LPC_HandleIORead(UINT16 address, UINT8 *data);
-extern void			LPC_HandleIOWrite(UINT16 address, UINT8 data);
-
-/*************************************/
-/* ##### ##### Functions ##### ##### */
-/*************************************/
-
-void LPC_ISR(void)
-{
-	/* If the GPIO status register indicates that the interrupt was from the LCLK line */
-	if((*gpio_interrupt_status_register) & LPC_LCLK_MASK)
-	{
-		LPC_HandleCycle();
-	}
-}
-
-void LPC_Initialize(void)
-{
-	/* Ensure that the GPIO interrupts are disabled */
-	DisableInterruptRegister(INTR_GPIO);
-	
-	/* Ensure that any current LPC LCLK interrupt is disabled ... */
-	(*gpio_interrupt_disable_register) = LPC_LCLK_MASK;
-	
-	/* Have the GPIO module generate an edge triggered interrupt for the LPC LCLK pin... */
-	(*gpio_interrupt_trigger_mode_register) = LPC_LCLK_MASK;
-	
-	/* Have the GPIO module generate an active-low triggered interrupt for the LPC LCLK so it is triggered when LCLK is falling... */
-	(*gpio_interrupt_active_mode_clear_register) = LPC_LCLK_MASK;
-	
-	/* Set the LPC LCLK, LRESET and LFRAME line direction so the peripheral is receiving from the host... */
-	(*gpio_dir_clear_register) = (LPC_LCLK_MASK | LPC_LRESET_MASK | LPC_LFRAME_MASK);
-	
-	/* Enable the new LPC LCLK interrupt... */
-	(*gpio_interrupt_enable_register) = LPC_LCLK_MASK;
-	
-	// ##### ##### >>>>>
-	
-	/* Ensure that the host has initial control of the LAD values, so that the peripheral (this device) can read GPIO signals */
-	LPC_TurnAroundToHost();
-	
-	/* Begin the state machine in IDLE */
-	LPC_SetState(STATE_IDLE);
-	
-	// ##### ##### >>>>>
-	
-	/* Enable the GPIO interrupts */
-	EnableInterruptRegister(INTR_GPIO);
-}
-
-__inline UINT8
-LPC_Read(void)
-{
-	return (*gpio_data_register) & LPC_MASK;
-}
-
-__inline void
-LPC_Write(UINT8 values)
-{
-	/* Filter values so that writing only happens to the LAD pins since this device is only the peripheral */
-	values &= LPC_LAD_MASK;
-	
-	/* Set all pins high */
-	(*gpio_data_register) = LPC_LAD_MASK;
-	
-	/* Clear pins that map to zeros bits */
-	(*gpio_data_clear_register) = (~values) & LPC_LAD_MASK;
-}
-
-__inline void
-LPC_TurnAroundToPeripheral(void)
-{
-	/* If bit is set high, the GPIO pin is in output mode */
-	(*gpio_dir_register) = LPC_LAD_MASK;
-}
-
-__inline void
-LPC_TurnAroundToHost(void)
-{
-	/* If bit is set low, the GPIO pin is in input mode */
-	(*gpio_dir_clear_register) = LPC_LAD_MASK;
-}
-
-__inline LPC_IO_CYCLE_STATE
-LPC_GetState(void)
-{
-	return lpc_state;
-}
-
-__inline void
-LPC_SetState(LPC_IO_CYCLE_STATE state)
-{
-	lpc_state = state;
-}
-
-void LPC_HandleCycle(void)
-{
-	static UINT8 lframe = FALSE;
-	
-	UINT8 last_lframe;
-	
-	UINT8 signal;
-	
-	// Important values
-	
-	BOOL lframe_falling;
-	BOOL lframe_rising;
-	BOOL lframe_active;
-	
-	UINT8 lad;
-	
-	// Signal
-	
-	signal = LPC_Read();
-	
-	//DEBUG_SaveToBuffer(0xAA);
-	//DEBUG_SaveToBuffer(signal);
-	
-	// LFRAME
-	
-	last_lframe = lframe;
-	lframe = (signal & LPC_LFRAME_MASK);
-	
-	lframe_falling = IS_HIGH(last_lframe) && IS_LOW(lframe);
-	lframe_rising = IS_LOW(last_lframe) && IS_HIGH(lframe);
-	lframe_active = IS_LOW(lframe);
-	
-	// LAD
-	
-	lad = (signal & LPC_LAD_MASK);
-	
-	/* ### State Machine - Handle Frame ### */
-	
-	if(lframe_falling)
-	{
-		/* Note: The host may have aborted unexpectently, so the state machine must be cleaned */
-		
-		/* Ensure that the cycle state has been returned to an idle state */
-		LPC_SetState(STATE_IDLE);
-		
-		/* Ensure that the LAD values are readable */
-		LPC_TurnAroundToHost();
-		
-		return; /* Exit early (collect the newly accessable LAD values before the next falling LCLK) */
-	}
-	
-	if(lframe_active)
-	{
-		/* Store the frame to be recalled for later use */
-		lpc_frame_info = (LPC_FRAME)lad;
-		
-		return; /* Exit early (wait for next falling LCLK) */
-	}
-	
-	if(lframe_rising)
-	{
-		switch(lpc_frame_info)
-		{
-			case FRAME_START: /* (0000b) Start cycle */
-			{
-				LPC_SetState(STATE_CYCTYPE_AND_DIR);
-			
-			} break;
-			
-			case FRAME_ABORT: /* (1111b) Stop cycle */
-			{
-				LPC_SetState(STATE_ABORT);
-			
-			} break;
-			
-			default:
-			{
-				LPC_SetState(STATE_IDLE);
-			
-			} break;
-		}
-	}
-	
-	/* ### State Machine - Handle Cycle ### */
-	
-	//DEBUG_SaveToBuffer(0xBB);
-	//DEBUG_SaveToBuffer(LPC_GetState());
-	
-	switch(LPC_GetState())
-	{
-		// ### STATE_CYCTYPE_AND_DIR ### //
-	
-		case STATE_CYCTYPE_AND_DIR:
-		{
-			lpc_cycle_type = (LPC_CYCTYPE)((lad & LPC_CYCTYPE_MASK) >> 2);
-			lpc_direction = (LPC_DIR)((lad & LPC_DIR_MASK) >> 1);
-			
-			if(lpc_cycle_type == CYCTYPE_IO)
-			{
-				LPC_SetState(STATE_ADDR_0);
-			}
-			else
-			{
-				LPC_SetState(STATE_IDLE);
-			}
-		
-		} break;
-		
-		// ### STATE_ADDR ### //
-		
-		case STATE_ADDR_0:
-		{
-			lpc_address = 0;
-			
-			lpc_address <<= 4;
-			lpc_address |= lad;
-			
-			LPC_SetState(STATE_ADDR_1);
-		
-		} break;
-		
-		case STATE_ADDR_1:
-		{
-			lpc_address <<= 4;
-			lpc_address |= lad;
-			
-			LPC_SetState(STATE_ADDR_2);
-		
-		} break;
-		
-		case STATE_ADDR_2:
-		{
-			lpc_address <<= 4;
-			lpc_address |= lad;
-			
-			LPC_SetState(STATE_ADDR_3);
-		
-		} break;
-		
-		case STATE_ADDR_3:
-		{
-			lpc_address <<= 4;
-			lpc_address |= lad;
-			
-			if(lpc_direction == DIR_WRITE)
-			{
-				LPC_SetState(STATE_DATA_WRITE_0);
-			}
-			else
-			{
-				LPC_SetState(STATE_TAR_TO_PERIPHERAL_0);
-			}
-		
-		} break;
-		
-		// ### STATE_DATA_WRITE ### //
-		
-		case STATE_DATA_WRITE_0:
-		{
-			lpc_data = 0;
-			
-			lpc_data |= (lad << 0);
-			
-			LPC_SetState(STATE_DATA_WRITE_1);
-		
-		} break;
-		
-		case STATE_DATA_WRITE_1:
-		{
-			lpc_data |= (lad << 4);
-			
-			LPC_SetState(STATE_TAR_TO_PERIPHERAL_0);
-		
-		} break;
-		
-		// ### STATE_TAR_TO_PERIPHERAL ### //
-		
-		case STATE_TAR_TO_PERIPHERAL_0:
-		{
-			/* Drive out an early sync signal so that the sync is less likely to be missed by the host... */
-			
-			if(lpc_direction == DIR_READ)
-			{
-				lpc_synchronize_info = SYNC_SHORT_WAIT;
-			}
-			else
-			{
-				lpc_synchronize_info = SYNC_READY;
-			}
-			
-			LPC_Write(lpc_synchronize_info);
-			
-			LPC_SetState(STATE_TAR_TO_PERIPHERAL_1);
-		
-		} break;
-		
-		case STATE_TAR_TO_PERIPHERAL_1:
-		{
-			LPC_TurnAroundToPeripheral();
-			
-			LPC_SetState(STATE_SYNC);
-		
-		} break;
-		
-		// ### STATE_SYNC ### //
-		
-		case STATE_SYNC:
-		{
-			if(lpc_direction == DIR_READ)
-			{
-				if(LPC_HandleIORead(lpc_address, (&lpc_data)))
-				{
-					lpc_synchronize_info = SYNC_READY;
-					LPC_Write(lpc_synchronize_info);
-					
-					LPC_SetState(STATE_DATA_READ_0);
-				}
-				else
-				{
-					/* IMPORTANT: If the Sync pattern is '0101b',
-					 * then the maximum number of SYNC clocks is assumed to be 8.
-					 * If the host sees that more than 8 clocks of this SYNC value have been driven,
-					 * it may abort the cycle.
-					 */
-					
-					lpc_synchronize_info = SYNC_SHORT_WAIT; /* Allow host to abort */
-					LPC_Write(lpc_synchronize_info);
-				}
-			}
-			else
-			{
-				lpc_synchronize_info = SYNC_READY;
-				LPC_Write(lpc_synchronize_info);
-				
-				if(lpc_direction == DIR_WRITE)
-				{
-					LPC_HandleIOWrite(lpc_address, lpc_data);
-				}
-				
-				LPC_SetState(STATE_TAR_TO_HOST_0);
-			}
-		
-		} break;
-		
-		// ### STATE_DATA_READ ### //
-		
-		case STATE_DATA_READ_0:
-		{
-			LPC_Write((lpc_data >> 0) & LPC_LAD_MASK);
-			
-			LPC_SetState(STATE_DATA_READ_1);
-		
-		} break;
-		
-		case STATE_DATA_READ_1:
-		{
-			LPC_Write((lpc_data >> 4) & LPC_LAD_MASK);
-			
-			LPC_SetState(STATE_TAR_TO_HOST_0);
-		
-		} break;
-		
-		// ### STATE_TAR_TO_HOST ### //
-		
-		case STATE_TAR_TO_HOST_0:
-		{
-			LPC_Write(0xF);
-			
-			LPC_SetState(STATE_TAR_TO_HOST_1);
-			
-		} break;
-		
-		case STATE_TAR_TO_HOST_1:
-		{
-			LPC_TurnAroundToHost();
-			
-			LPC_SetState(STATE_IDLE);
-		
-		} break;
-		
-		// ### STATE_ABORT ### //
-		
-		case STATE_ABORT:
-		{
-			// TODO: ...
-			
-		} break;
-	}
-}
+#include <stddef.h>
+
+#include "lpc.h"
+#include "gpio.h"
+#include "interrupt.h"
+#include "debug.h"
+
+/***********************************/
+/* ##### ##### Globals ##### ##### */
+/***********************************/
+
+#define LPC_MASK		(0x7F)		// 0000 0000 0111 1111 b
+
+#define LPC_LCLK_MASK		(0x40)		// 0000 0000 0100 0000 b
+#define LPC_LRESET_MASK		(0x20)		// 0000 0000 0010 0000 b
+#define LPC_LFRAME_MASK		(0x10)		// 0000 0000 0001 0000 b
+
+#define LPC_LAD_MASK		(0xF)		// 0000 0000 0000 1111 b
+#define LPC_CYCTYPE_MASK	(0xC)		// 0000 0000 0000 1100 b
+#define LPC_DIR_MASK		(0x2)		// 0000 0000 0000 0010 b
+
+typedef enum {
+	FRAME_START		= 0x0,		// 0000b
+	FRAME_FWH_READ		= 0xD,		// 1101b
+	FRAME_FWH_WRITE		= 0xE,		// 1110b
+	FRAME_ABORT		= 0xF		// 1111b
+} LPC_FRAME;
+
+typedef enum {
+	CYCTYPE_IO		= 0x0,		// 00b
+	CYCTYPE_MEMORY		= 0x1,		// 01b
+	CYCTYPE_DMA		= 0x2		// 10b
+} LPC_CYCTYPE;
+
+typedef enum {
+	DIR_READ		= 0x0,		// 0b
+	DIR_WRITE		= 0x1		// 1b
+} LPC_DIR;
+
+typedef enum {
+	SYNC_READY		= 0x0,		// 0000b
+	SYNC_SHORT_WAIT		= 0x5,		// 0101b
+	SYNC_LONG_WAIT		= 0x6,		// 0110b
+	SYNC_READY_MORE		= 0x9,		// 1001b (DMA only)
+	SYNC_ERROR		= 0xA		// 1010b
+} LPC_SYNC;
+
+typedef enum {
+	// Note: These enumerations are assigned values for debugging purposes only
+	STATE_IDLE				= 0,
+	STATE_CYCTYPE_AND_DIR			= 1,
+	STATE_ADDR_0				= 2,
+	STATE_ADDR_1				= 3,
+	STATE_ADDR_2				= 4,
+	STATE_ADDR_3				= 5,
+	STATE_DATA_WRITE_0			= 6,
+	STATE_DATA_WRITE_1			= 7,
+	STATE_TAR_TO_PERIPHERAL_0		= 8,
+	STATE_TAR_TO_PERIPHERAL_1		= 9,
+	STATE_SYNC				= 10,
+	STATE_DATA_READ_0			= 11,
+	STATE_DATA_READ_1			= 12,
+	STATE_TAR_TO_HOST_0			= 13,
+	STATE_TAR_TO_HOST_1			= 14,
+	STATE_ABORT				= 15,
+	STATE_FWH_IDSEL				= 16,
+	STATE_FWH_ADDR				= 17,
+	STATE_FWH_MSIZE				= 18,
+	STATE_FWH_DATA_WRITE			= 19,
+	STATE_DMA_CHANNEL			= 20,
+	STATE_DMA_SIZE				= 21,
+	STATE_IGNORE				= 22,		// Address outside every decode window, wait for the next frame
+	STATE_RESET				= 23		// LRESET was sampled low, wait for the next frame once it is released
+} LPC_IO_CYCLE_STATE;
+
+/* The decoder keeps all of its state in the port's LPC_CONTEXT (see lpc.h), the fields it reads on every edge
+ * have to stay within the first cache line.
+ */
+/* The pin map has to fit a bank, bit 15 is not a pin (see GPIO_MASK) */
+#if (LPC_PIN_LAD0 > 14) || (LPC_PIN_LAD1 > 14) || (LPC_PIN_LAD2 > 14) || (LPC_PIN_LAD3 > 14) \
+	|| (LPC_PIN_LFRAME > 14) || (LPC_PIN_LRESET > 14) || (LPC_PIN_LCLK > 14)
+#error "LPC_PIN_* must be bank bits 0-14"
+#endif
+
+typedef char LPC_PINS_DISTINCT[((LPC_LAD_PINS | LPC_LFRAME_PIN | LPC_LRESET_PIN | LPC_LCLK_PIN) ==
+	(LPC_LAD_PINS + LPC_LFRAME_PIN + LPC_LRESET_PIN + LPC_LCLK_PIN)) ? 1 : -1];
+
+typedef char LPC_CONTEXT_HOT_FIELDS_FIT[(offsetof(LPC_CONTEXT, sample_cycle) <= LPC_CACHE_LINE) ? 1 : -1];
+
+// Firmware Memory cycles
+
+#define FWH_ADDR_NIBBLES	(7)		// 28-bit address
+
+// DMA cycles
+
+#define LPC_DMA_CHANNEL_MASK	(0x7)		// 0000 0000 0000 0111 b
+#define LPC_DMA_TC_MASK		(0x8)		// 0000 0000 0000 1000 b
+#define LPC_DMA_SIZE_MASK	(0x3)		// 0000 0000 0000 0011 b
+
+#ifdef LPC_TABLE_DECODER
+
+/* The table decoder folds LFRAME history, cycle direction and the frame type into its states,
+ * so that every LCLK edge is decided by the (state, LFRAME, LAD) triple alone, see lpc_decode_table.
+ */
+
+typedef enum {
+	DECODE_IDLE				= 0,
+	DECODE_FRAME_START			= 1,
+	DECODE_FRAME_ABORT			= 2,
+	DECODE_FRAME_OTHER			= 3,
+	DECODE_ABORT				= 4,
+	DECODE_ADDR_0_READ			= 5,
+	DECODE_ADDR_1_READ			= 6,
+	DECODE_ADDR_2_READ			= 7,
+	DECODE_ADDR_3_READ			= 8,
+	DECODE_ADDR_0_WRITE			= 9,
+	DECODE_ADDR_1_WRITE			= 10,
+	DECODE_ADDR_2_WRITE			= 11,
+	DECODE_ADDR_3_WRITE			= 12,
+	DECODE_DATA_WRITE_0			= 13,
+	DECODE_DATA_WRITE_1			= 14,
+	DECODE_TAR_TO_PERIPHERAL_0_READ		= 15,
+	DECODE_TAR_TO_PERIPHERAL_0_WRITE	= 16,
+	DECODE_TAR_TO_PERIPHERAL_1_READ		= 17,
+	DECODE_TAR_TO_PERIPHERAL_1_WRITE	= 18,
+	DECODE_SYNC_READ			= 19,
+	DECODE_SYNC_WRITE			= 20,
+	DECODE_DATA_READ_0			= 21,
+	DECODE_DATA_READ_1			= 22,
+	DECODE_TAR_TO_HOST_0			= 23,
+	DECODE_TAR_TO_HOST_1			= 24,
+	DECODE_IGNORE				= 25,
+	DECODE_RESET				= 26,
+	DECODE_STATE_COUNT			= 27
+} LPC_DECODE_STATE;
+
+typedef enum {
+	ACTION_NONE				= 0,
+	ACTION_TURN_AROUND_TO_HOST		= 1,
+	ACTION_ADDR_0				= 2,
+	ACTION_ADDR_1				= 3,
+	ACTION_ADDR_2				= 4,
+	ACTION_ADDR_3				= 5,
+	ACTION_DATA_WRITE_0			= 6,
+	ACTION_DATA_WRITE_1			= 7,
+	ACTION_DRIVE_SYNC_SHORT_WAIT		= 8,
+	ACTION_DRIVE_SYNC_READY			= 9,
+	ACTION_TURN_AROUND_TO_PERIPHERAL	= 10,
+	ACTION_SYNC_READ			= 11,
+	ACTION_SYNC_WRITE			= 12,
+	ACTION_DATA_READ_0			= 13,
+	ACTION_DATA_READ_1			= 14,
+	ACTION_TAR_TO_HOST_0			= 15,
+	ACTION_ABORT				= 16,
+	ACTION_ABORT_IO_SYNC			= 17,
+	ACTION_ABORT_IO_READ			= 18
+} LPC_DECODE_ACTION;
+
+#endif
+
+#ifdef LPC_DEFERRED_DECODE
+
+#ifdef LPC_TABLE_DECODER
+#error "LPC_DEFERRED_DECODE and LPC_TABLE_DECODER are mutually exclusive"
+#endif
+
+#define LPC_SAMPLE_RING_MASK		(LPC_SAMPLE_RING_LENGTH - 1)
+
+#define LPC_TRANSACTION_BATCH_LENGTH	(16)
+
+typedef struct {
+	UINT16	address;
+	UINT8	data;
+} LPC_TRANSACTION;
+
+#endif
+
+/**************************************/
+/* ##### ##### Prototypes ##### ##### */
+/**************************************/
+
+__inline void			LPC_DecodeEdge(LPC_CONTEXT *lpc);
+
+__inline UINT8			LPC_Read(LPC_CONTEXT *lpc);
+__inline void			LPC_Write(LPC_CONTEXT *lpc, UINT8 values);
+
+__inline void			LPC_TurnAroundToPeripheral(LPC_CONTEXT *lpc);
+__inline void			LPC_TurnAroundToHost(LPC_CONTEXT *lpc);
+
+__inline LPC_IO_CYCLE_STATE	LPC_GetState(LPC_CONTEXT *lpc);
+__inline void			LPC_SetState(LPC_CONTEXT *lpc, LPC_IO_CYCLE_STATE state);
+
+__inline BOOL			LPC_SyncIORead(LPC_CONTEXT *lpc, UINT16 address);
+
+__inline BOOL			LPC_IOReadInterrupted(LPC_CONTEXT *lpc);
+__inline void			LPC_AbortIORead(LPC_CONTEXT *lpc, UINT16 address);
+void				LPC_HandleReset(LPC_CONTEXT *lpc);
+
+__inline BOOL			LPC_DecodeNibble(LPC_CONTEXT *lpc, UINT8 nibble, UINT8 lad);
+__inline UINT8			LPC_DecodeWindows(LPC_CONTEXT *lpc, UINT16 address);
+
+#ifdef LPC_INSTRUMENT
+LPC_IO_READ_RESULT		LPC_CountersRead(void *context, UINT16 address, UINT8 *data);
+void				LPC_CountersWrite(void *context, UINT16 address, UINT8 data);
+#endif
+
+BOOL				LPC_ClaimFirmwareMemory(LPC_CONTEXT *lpc, UINT8 msize);
+
+// I/O cycles are dispatched to the port's devices, see lpc_io_dispatch.c
+
+extern LPC_IO_READ_RESULT	LPC_HandleIORead(LPC_CONTEXT *lpc, UINT16 address, UINT8 *data);
+extern void			LPC_HandleIOWrite(LPC_CONTEXT *lpc, UINT16 address, UINT8 data);
+extern void			LPC_HandleIOAbort(LPC_CONTEXT *lpc, UINT16 address);
+
+// LRESET drops every exchange of the message protocol instance in progress, see lpc_io_transmission.c
+
+extern void			LPC_ResetIOMessages(LPC_MESSAGES *messages);
+
+// Protocols for dma, named like the LPC spec from the host memory's point of view:
+// a DMA read moves a byte from the host to the peripheral, a DMA write moves a byte from the peripheral to the host.
+// The bytes go to the message protocol instance registered on the port.
+
+extern BOOL			LPC_HandleDMARead(LPC_MESSAGES *messages, UINT8 channel, UINT8 data, BOOL terminal);
+extern BOOL			LPC_HandleDMAWrite(LPC_MESSAGES *messages, UINT8 channel, UINT8 *data, BOOL terminal, BOOL *more);
+
+/*************************************/
+/* ##### ##### Functions ##### ##### */
+/*************************************/
+
+void LPC_ISR(LPC_CONTEXT *lpc)
+{
+	/* If the GPIO status register indicates that the interrupt was from the LCLK line */
+	if(GPIO_Load(&lpc->gpio, GPIO_INTERRUPT_STATUS_OFFSET) & LPC_LCLK_PIN)
+	{
+		DEBUG_TICK();
+		
+		LPC_HandleCycle(lpc);
+	}
+}
+
+void LPC_Initialize(LPC_CONTEXT *lpc, const LPC_PINS *pins, LPC_MESSAGES *messages)
+{
+	UINT32 i;
+	
+	/* Ensure that the GPIO interrupts are disabled */
+	DisableInterruptRegister(INTR_GPIO);
+	
+	/* Start from a clean port, whatever an earlier LPC_Initialize left behind */
+	for(i = 0; i < sizeof(LPC_CONTEXT); i++)
+	{
+		((UINT8 *)lpc)[i] = 0;
+	}
+	
+	lpc->dma_channel_claimed = 0xFF; /* None */
+	
+#ifdef LPC_DEFERRED_DECODE
+	lpc->process_frame_info = FRAME_ABORT;
+#endif
+	
+	/* LAD starts out floating, the GPIO backend is handed the pins this device drives */
+	GPIO_Attach(&lpc->gpio, pins->bank, LPC_LAD_PINS);
+	
+	/* Ensure that any current LPC LCLK interrupt is disabled ... */
+	GPIO_Store(&lpc->gpio, GPIO_INTERRUPT_DISABLE_OFFSET, LPC_LCLK_PIN);
+	
+	/* Have the GPIO module generate an edge triggered interrupt for the LPC LCLK pin... */
+	GPIO_Store(&lpc->gpio, GPIO_INTERRUPT_TRIGGER_MODE_OFFSET, LPC_LCLK_PIN);
+	
+	/* Have the GPIO module generate an active-low triggered interrupt for the LPC LCLK so it is triggered when LCLK is falling... */
+	GPIO_Store(&lpc->gpio, GPIO_INTERRUPT_ACTIVE_MODE_CLEAR_OFFSET, LPC_LCLK_PIN);
+	
+	/* Set the LPC LCLK, LRESET and LFRAME line direction so the peripheral is receiving from the host... */
+	GPIO_Store(&lpc->gpio, GPIO_DIR_CLEAR_OFFSET, (LPC_LCLK_PIN | LPC_LRESET_PIN | LPC_LFRAME_PIN));
+	
+	/* Enable the new LPC LCLK interrupt... */
+	GPIO_Store(&lpc->gpio, GPIO_INTERRUPT_ENABLE_OFFSET, LPC_LCLK_PIN);
+	
+	// ##### ##### >>>>>
+	
+	/* Ensure that the host has initial control of the LAD values, so that the peripheral (this device) can read GPIO signals */
+	LPC_TurnAroundToHost(lpc);
+	
+	/* The message protocol is the first I/O device, the application may register more */
+	LPC_ResetIODevices(lpc);
+	LPC_RegisterIOMessages(lpc, messages, 0x0000);
+	
+#ifdef LPC_INSTRUMENT
+	LPC_RegisterIODevice(lpc, LPC_COUNTERS_BASE, LPC_COUNTERS_LENGTH, LPC_CountersRead, LPC_CountersWrite, lpc);
+#endif
+	
+	/* Positive decode, only the message protocol's addresses are claimed until the application opens more windows */
+	LPC_SetDecodeWindow(lpc, 0, 0x0000, 0x01FF);
+	
+	/* Begin the state machine in IDLE */
+	LPC_SetState(lpc, STATE_IDLE);
+	
+#ifdef LPC_TABLE_DECODER
+	lpc->decode_state = DECODE_IDLE;
+#endif
+	
+	// ##### ##### >>>>>
+	
+	/* Enable the GPIO interrupts */
+	EnableInterruptRegister(INTR_GPIO);
+}
+
+/* The decoder works on the signals in the reference layout (LPC_MASK), gathered from the pin map (see lpc.h) */
+__inline UINT8
+LPC_Read(LPC_CONTEXT *lpc)
+{
+	return LPC_GATHER_PINS(GPIO_ReadPins(&lpc->gpio));
+}
+
+__inline void
+LPC_Write(LPC_CONTEXT *lpc, UINT8 values)
+{
+	/* Only the LAD pins are written since this device is only the peripheral, the backend drives all four at once */
+	GPIO_WritePins(&lpc->gpio, LPC_LAD_PINS, LPC_SCATTER_LAD(values));
+}
+
+__inline void
+LPC_TurnAroundToPeripheral(LPC_CONTEXT *lpc)
+{
+	/* If bit is set high, the GPIO pin is in output mode */
+	GPIO_Drive(&lpc->gpio, LPC_LAD_PINS);
+}
+
+__inline void
+LPC_TurnAroundToHost(LPC_CONTEXT *lpc)
+{
+	/* If bit is set low, the GPIO pin is in input mode */
+	GPIO_Release(&lpc->gpio, LPC_LAD_PINS);
+}
+
+__inline LPC_IO_CYCLE_STATE
+LPC_GetState(LPC_CONTEXT *lpc)
+{
+	return (LPC_IO_CYCLE_STATE)lpc->state;
+}
+
+__inline void
+LPC_SetState(LPC_CONTEXT *lpc, LPC_IO_CYCLE_STATE state)
+{
+	lpc->state = (UINT8)state;
+}
+
+/* Drive the sync for one SYNC clock of an I/O read, returns TRUE once lpc->data holds the data for the host */
+__inline BOOL
+LPC_SyncIORead(LPC_CONTEXT *lpc, UINT16 address)
+{
+	if(lpc->read_pending)
+	{
+		if(!lpc->read_completed)
+		{
+			LPC_COUNT(lpc, long_waits);
+			
+			/* Long waits have no clock limit, the host keeps waiting for LPC_CompleteIORead */
+			lpc->synchronize_info = SYNC_LONG_WAIT;
+			LPC_Write(lpc, lpc->synchronize_info);
+			
+			return FALSE;
+		}
+		
+		lpc->read_pending = FALSE;
+		lpc->data = lpc->read_data;
+		
+		lpc->synchronize_info = SYNC_READY;
+		LPC_Write(lpc, lpc->synchronize_info);
+		
+		return TRUE;
+	}
+	
+	lpc->read_completed = FALSE;
+	
+	switch(LPC_HandleIORead(lpc, address, (&lpc->data)))
+	{
+		case IO_READ_READY:
+		{
+			lpc->synchronize_info = SYNC_READY;
+			LPC_Write(lpc, lpc->synchronize_info);
+			
+			return TRUE;
+		}
+		
+		case IO_READ_PENDING:
+		{
+			LPC_COUNT(lpc, reads_pending);
+			LPC_COUNT(lpc, long_waits);
+			
+			lpc->read_pending = TRUE;
+			
+			lpc->synchronize_info = SYNC_LONG_WAIT;
+			LPC_Write(lpc, lpc->synchronize_info);
+			
+			return FALSE;
+		}
+		
+		default:
+		{
+			/* IMPORTANT: If the Sync pattern is '0101b',
+			 * then the maximum number of SYNC clocks is assumed to be 8.
+			 * If the host sees that more than 8 clocks of this SYNC value have been driven,
+			 * it may abort the cycle.
+			 */
+			
+			LPC_COUNT(lpc, reads_retried);
+			LPC_COUNT(lpc, short_waits);
+			
+			lpc->synchronize_info = SYNC_SHORT_WAIT; /* Allow host to abort */
+			LPC_Write(lpc, lpc->synchronize_info);
+			
+			return FALSE;
+		}
+	}
+}
+
+BOOL LPC_CompleteIORead(LPC_CONTEXT *lpc, UINT8 data)
+{
+	if(!lpc->read_pending) return FALSE;
+	
+	lpc->read_data = data;
+	lpc->read_completed = TRUE;
+	
+	return TRUE;
+}
+
+/* ### Abort and Reset ###
+ *
+ * ABORT: the host drives LFRAME low (with 1111b on LAD) for at least four clocks, and the peripheral has to float LAD
+ * before the last of them. Every decoder releases LAD on the first LCLK edge LFRAME is sampled low, whatever state the
+ * cycle was in. An I/O read the device already answered (or left pending) whose data the host never got is handed back
+ * to the device (LPC_HandleIOAbort), so the host can simply read it again: the message protocol takes back the checksum,
+ * CRC and stream pointer updates of the read.
+ *
+ * LRESET: sampled on every LCLK edge, the clock keeps running through a platform reset. The first edge LRESET is low
+ * releases LAD, drops the cycle and any pending read and resets the message protocol (LPC_ResetIOMessages), the edges
+ * that follow are ignored until it is high again and the decoder waits for the next frame. The deferred decoder's
+ * bottom half resets the message protocol when it reaches the sample, after the writes that came before it.
+ */
+
+// The host aborted an I/O read between the device answering it and the last data nibble
+__inline BOOL
+LPC_IOReadInterrupted(LPC_CONTEXT *lpc)
+{
+	switch(LPC_GetState(lpc))
+	{
+		case STATE_SYNC:		return lpc->read_pending;
+		case STATE_DATA_READ_0:
+		case STATE_DATA_READ_1:		return (lpc->cycle_type == CYCTYPE_IO);
+		default:			return FALSE;
+	}
+}
+
+__inline void
+LPC_AbortIORead(LPC_CONTEXT *lpc, UINT16 address)
+{
+	LPC_COUNT(lpc, reads_aborted);
+	
+	lpc->read_pending = FALSE;
+	
+	LPC_HandleIOAbort(lpc, address);
+}
+
+void LPC_HandleReset(LPC_CONTEXT *lpc)
+{
+	LPC_COUNT(lpc, resets);
+	DEBUG_TRACE_MESSAGE(DEBUG_EVENT_RESET, LPC_GetState(lpc), lpc->address, 0);
+	
+	LPC_TurnAroundToHost(lpc);
+	
+	lpc->read_pending = FALSE;
+	lpc->read_completed = FALSE;
+	
+	/* Whatever LFRAME does next starts a frame */
+	lpc->lframe = LPC_LFRAME_MASK;
+	lpc->frame_info = FRAME_ABORT;
+	
+	lpc->dma_count = 0;
+	lpc->fwh_count = 0;
+	
+	LPC_SetState(lpc, STATE_RESET);
+	
+#ifdef LPC_TABLE_DECODER
+	lpc->decode_state = DECODE_RESET;
+#endif
+	
+#ifndef LPC_DEFERRED_DECODE
+	LPC_ResetIOMessages(lpc->messages);
+#endif
+}
+
+/* ### Decode Windows ###
+ *
+ * A window covers the addresses that equal its base in every bit its mask leaves clear, so whether an address can
+ * still fall into a window is known nibble by nibble as the address phase arrives: lpc->window_nibbles holds, for
+ * every nibble position and value, the windows that accept it. The candidates are narrowed once per address clock
+ * and the cycle is ignored as soon as none is left, up to 3 clocks before the last address nibble.
+ */
+
+__inline BOOL LPC_DecodeNibble(LPC_CONTEXT *lpc, UINT8 nibble, UINT8 lad)
+{
+	int window;
+	
+	if(nibble == 0)
+	{
+		lpc->window_stats.cycles += 1;
+		lpc->window_candidates = lpc->window_enabled;
+	}
+	
+	lpc->window_candidates &= lpc->window_nibbles[nibble][lad];
+	
+	if(lpc->window_candidates == 0)
+	{
+		LPC_COUNT(lpc, ignored);
+		
+		lpc->window_stats.rejected[nibble] += 1;
+		
+		return FALSE;
+	}
+	
+	if(nibble == 3)
+	{
+		for(window = 0; window < LPC_DECODE_WINDOWS; window++)
+		{
+			if(lpc->window_candidates & (1 << window)) lpc->window_stats.hits[window] += 1;
+		}
+	}
+	
+	return TRUE;
+}
+
+// Windows a complete address falls into
+__inline UINT8 LPC_DecodeWindows(LPC_CONTEXT *lpc, UINT16 address)
+{
+	return lpc->window_enabled
+		& lpc->window_nibbles[0][(address >> 12) & 0xF]
+		& lpc->window_nibbles[1][(address >> 8) & 0xF]
+		& lpc->window_nibbles[2][(address >> 4) & 0xF]
+		& lpc->window_nibbles[3][(address >> 0) & 0xF];
+}
+
+void LPC_BuildDecodeWindows(LPC_CONTEXT *lpc)
+{
+	int window;
+	int nibble;
+	int value;
+	UINT8 shift;
+	UINT8 windows;
+	
+	for(nibble = 0; nibble < 4; nibble++)
+	{
+		shift = (UINT8)((3 - nibble) * 4);
+		
+		for(value = 0; value < 16; value++)
+		{
+			windows = 0;
+			
+			for(window = 0; window < LPC_DECODE_WINDOWS; window++)
+			{
+				if(((value ^ (lpc->window_base[window] >> shift)) & ~(lpc->window_mask[window] >> shift) & 0xF) == 0)
+				{
+					windows |= (UINT8)(1 << window);
+				}
+			}
+			
+			lpc->window_nibbles[nibble][value] = windows;
+		}
+	}
+}
+
+BOOL LPC_SetDecodeWindow(LPC_CONTEXT *lpc, UINT8 window, UINT16 base, UINT16 mask)
+{
+	if(window >= LPC_DECODE_WINDOWS) return FALSE;
+	
+	/* Close the window first so that the ISR never decodes a half updated one */
+	lpc->window_enabled &= (UINT8)~(1 << window);
+	
+	lpc->window_base[window] = base;
+	lpc->window_mask[window] = mask;
+	
+	LPC_BuildDecodeWindows(lpc);
+	
+	lpc->window_enabled |= (UINT8)(1 << window);
+	
+	return TRUE;
+}
+
+void LPC_ClearDecodeWindow(LPC_CONTEXT *lpc, UINT8 window)
+{
+	if(window >= LPC_DECODE_WINDOWS) return;
+	
+	lpc->window_enabled &= (UINT8)~(1 << window);
+}
+
+void LPC_GetDecodeStats(LPC_CONTEXT *lpc, LPC_DECODE_STATS *stats, BOOL clear)
+{
+	int window;
+	
+	(*stats) = lpc->window_stats;
+	
+	for(window = 0; window < LPC_DECODE_WINDOWS; window++)
+	{
+		stats->misses[window] = stats->cycles - stats->hits[window];
+	}
+	
+	if(clear)
+	{
+		lpc->window_stats.cycles = 0;
+		
+		for(window = 0; window < 4; window++)
+		{
+			lpc->window_stats.rejected[window] = 0;
+		}
+		
+		for(window = 0; window < LPC_DECODE_WINDOWS; window++)
+		{
+			lpc->window_stats.hits[window] = 0;
+		}
+	}
+}
+
+/* ### Instrumentation Counters ###
+ *
+ * The counters are only ever updated from the LCLK interrupt, and so is the snapshot (the counter window is an
+ * I/O device), so the host always reads a consistent set. Each counter is a single increment in the hot path.
+ */
+
+#ifdef LPC_INSTRUMENT
+
+LPC_IO_READ_RESULT LPC_CountersRead(void *context, UINT16 address, UINT8 *data)
+{
+	LPC_CONTEXT *lpc = (LPC_CONTEXT *)context;
+	UINT32 counter;
+	
+	if(address < 4)
+	{
+		(*data) = (address == 0) ? (UINT8)(sizeof(LPC_COUNTERS) / sizeof(UINT32)) : 0;
+		
+		return IO_READ_READY;
+	}
+	
+	address -= 4;
+	counter = ((UINT32 *)&lpc->counters_snapshot)[address >> 2];
+	
+	(*data) = (UINT8)(counter >> ((address & 3) * 8));
+	
+	return IO_READ_READY;
+}
+
+void LPC_CountersWrite(void *context, UINT16 address, UINT8 data)
+{
+	LPC_CONTEXT *lpc = (LPC_CONTEXT *)context;
+	
+	if(address != 0) return;
+	
+	LPC_COUNT(lpc, snapshots);
+	
+	LPC_GetCounters(lpc, &lpc->counters_snapshot, (data & 1));
+}
+
+#endif
+
+void LPC_GetCounters(LPC_CONTEXT *lpc, LPC_COUNTERS *counters, BOOL clear)
+{
+	UINT32 *counter = (UINT32 *)counters;
+	int i;
+	
+	for(i = 0; i < (int)(sizeof(LPC_COUNTERS) / sizeof(UINT32)); i++)
+	{
+#ifdef LPC_INSTRUMENT
+		counter[i] = ((UINT32 *)&lpc->counters)[i];
+		
+		if(clear) ((UINT32 *)&lpc->counters)[i] = 0;
+#else
+		counter[i] = 0;
+#endif
+	}
+}
+
+void LPC_SetDMAChannel(LPC_CONTEXT *lpc, UINT8 channel)
+{
+	lpc->dma_channel_claimed = channel;
+}
+
+void LPC_SetFirmwareMemory(LPC_CONTEXT *lpc, UINT8 idsel, UINT32 base, UINT8 *buffer, UINT32 length, BOOL writable)
+{
+	/* Unregister first so that the ISR never sees a half updated window */
+	lpc->fwh_memory = NULL;
+	
+	lpc->fwh_memory_idsel = idsel;
+	lpc->fwh_memory_base = base;
+	lpc->fwh_memory_length = length;
+	lpc->fwh_memory_writable = writable;
+	
+	lpc->fwh_memory = buffer;
+}
+
+BOOL LPC_ClaimFirmwareMemory(LPC_CONTEXT *lpc, UINT8 msize)
+{
+	/* MSIZE: 0000b = 1, 0001b = 2, 0010b = 4, 0100b = 16, 0111b = 128 bytes, the rest is reserved */
+	switch(msize)
+	{
+		case 0x0: lpc->fwh_length = 1; break;
+		case 0x1: lpc->fwh_length = 2; break;
+		case 0x2: lpc->fwh_length = 4; break;
+		case 0x4: lpc->fwh_length = 16; break;
+		case 0x7: lpc->fwh_length = 128; break;
+		default: return FALSE;
+	}
+	
+	if(lpc->fwh_memory == NULL) return FALSE;
+	if(lpc->fwh_idsel != lpc->fwh_memory_idsel) return FALSE;
+	if(lpc->fwh_address < lpc->fwh_memory_base) return FALSE;
+	if((lpc->fwh_address - lpc->fwh_memory_base) + lpc->fwh_length > lpc->fwh_memory_length) return FALSE;
+	
+	return TRUE;
+}
+
+#if !defined(LPC_TABLE_DECODER) && !defined(LPC_DEFERRED_DECODE)
+
+__inline void
+LPC_DecodeEdge(LPC_CONTEXT *lpc)
+{
+	UINT8 lframe;
+	UINT8 last_lframe;
+	
+	UINT8 signal;
+	
+	BOOL dma_more;
+	
+	// Important values
+	
+	BOOL lframe_falling;
+	BOOL lframe_rising;
+	BOOL lframe_active;
+	
+	UINT8 lad;
+	
+	// Signal
+	
+	signal = LPC_Read(lpc);
+	
+	DEBUG_TRACE_EDGE(DEBUG_EVENT_EDGE, LPC_GetState(lpc), lpc->address, signal);
+	
+	// LRESET
+	
+	if(IS_LOW(signal & LPC_LRESET_MASK))
+	{
+		if(LPC_GetState(lpc) != STATE_RESET) LPC_HandleReset(lpc);
+		
+		return; /* Exit early (the bus is idle until LRESET is released) */
+	}
+	
+	// LFRAME
+	
+	last_lframe = lpc->lframe;
+	lframe = (signal & LPC_LFRAME_MASK);
+	lpc->lframe = lframe;
+	
+	lframe_falling = IS_HIGH(last_lframe) && IS_LOW(lframe);
+	lframe_rising = IS_LOW(last_lframe) && IS_HIGH(lframe);
+	lframe_active = IS_LOW(lframe);
+	
+	// LAD
+	
+	lad = (signal & LPC_LAD_MASK);
+	
+	/* ### State Machine - Handle Frame ### */
+	
+	if(lframe_falling)
+	{
+		/* Note: The host may have aborted unexpectently, so the state machine must be cleaned */
+		
+		/* The device takes back a read the host did not get (see Abort and Reset) */
+		if(LPC_IOReadInterrupted(lpc)) LPC_AbortIORead(lpc, lpc->address);
+		
+		/* A read left pending by the aborted cycle can no longer be completed */
+		lpc->read_pending = FALSE;
+		
+		/* Ensure that the LAD values are readable (an ignored cycle never drove them) */
+		if(LPC_GetState(lpc) != STATE_IGNORE) LPC_TurnAroundToHost(lpc);
+		
+		/* Ensure that the cycle state has been returned to an idle state */
+		LPC_SetState(lpc, STATE_IDLE);
+		
+		/* A START may be a single clock long, so the frame is stored from the first clock on */
+		lpc->frame_info = (LPC_FRAME)lad;
+		
+		return; /* Exit early (collect the newly accessable LAD values before the next falling LCLK) */
+	}
+	
+	if(lframe_active)
+	{
+		/* Store the frame to be recalled for later use (the last clock LFRAME is low wins) */
+		lpc->frame_info = (LPC_FRAME)lad;
+		
+		return; /* Exit early (wait for next falling LCLK) */
+	}
+	
+	if(lframe_rising)
+	{
+		switch(lpc->frame_info)
+		{
+			case FRAME_START: /* (0000b) Start cycle */
+			{
+				LPC_SetState(lpc, STATE_CYCTYPE_AND_DIR);
+			
+			} break;
+			
+			case FRAME_FWH_READ: /* (1101b) Firmware Memory read */
+			{
+				LPC_COUNT(lpc, memory_cycles);
+				
+				lpc->cycle_type = CYCTYPE_MEMORY;
+				lpc->direction = DIR_READ;
+				LPC_SetState(lpc, STATE_FWH_IDSEL);
+			
+			} break;
+			
+			case FRAME_FWH_WRITE: /* (1110b) Firmware Memory write */
+			{
+				LPC_COUNT(lpc, memory_cycles);
+				
+				lpc->cycle_type = CYCTYPE_MEMORY;
+				lpc->direction = DIR_WRITE;
+				LPC_SetState(lpc, STATE_FWH_IDSEL);
+			
+			} break;
+			
+			case FRAME_ABORT: /* (1111b) Stop cycle */
+			{
+				LPC_COUNT(lpc, aborts);
+				DEBUG_TRACE_MESSAGE(DEBUG_EVENT_ABORT, LPC_GetState(lpc), lpc->address, 0);
+				
+				LPC_SetState(lpc, STATE_ABORT);
+			
+			} break;
+			
+			default:
+			{
+				LPC_SetState(lpc, STATE_IDLE);
+			
+			} break;
+		}
+	}
+	
+	/* ### State Machine - Handle Cycle ### */
+	
+	switch(LPC_GetState(lpc))
+	{
+		// ### STATE_CYCTYPE_AND_DIR ### //
+	
+		case STATE_CYCTYPE_AND_DIR:
+		{
+			lpc->cycle_type = (LPC_CYCTYPE)((lad & LPC_CYCTYPE_MASK) >> 2);
+			lpc->direction = (LPC_DIR)((lad & LPC_DIR_MASK) >> 1);
+			
+			if(lpc->cycle_type == CYCTYPE_MEMORY) LPC_COUNT(lpc, memory_cycles);
+			if(lpc->cycle_type == CYCTYPE_DMA) LPC_COUNT(lpc, dma_cycles);
+			
+			if(lpc->cycle_type == CYCTYPE_IO)
+			{
+				LPC_SetState(lpc, STATE_ADDR_0);
+			}
+			else if((lpc->cycle_type == CYCTYPE_DMA) && (lpc->dma_channel_claimed <= LPC_DMA_CHANNEL_MASK))
+			{
+				/* A DMA read moves data to the peripheral like an I/O write, and a DMA write like an I/O read */
+				lpc->direction = (lpc->direction == DIR_READ) ? DIR_WRITE : DIR_READ;
+				
+				LPC_SetState(lpc, STATE_DMA_CHANNEL);
+			}
+			else
+			{
+				LPC_SetState(lpc, STATE_IDLE);
+			}
+		
+		} break;
+		
+		// ### STATE_DMA ### //
+		
+		case STATE_DMA_CHANNEL:
+		{
+			lpc->dma_terminal = (lad & LPC_DMA_TC_MASK) ? TRUE : FALSE;
+			
+			if((lad & LPC_DMA_CHANNEL_MASK) == lpc->dma_channel_claimed)
+			{
+				LPC_SetState(lpc, STATE_DMA_SIZE);
+			}
+			else
+			{
+				LPC_SetState(lpc, STATE_IDLE);
+			}
+		
+		} break;
+		
+		case STATE_DMA_SIZE:
+		{
+			/* SIZE: 00b = 8, 01b = 16, 11b = 32 bits, 10b is reserved */
+			switch(lad & LPC_DMA_SIZE_MASK)
+			{
+				case 0x0: lpc->dma_length = 1; break;
+				case 0x1: lpc->dma_length = 2; break;
+				case 0x3: lpc->dma_length = 4; break;
+				default: lpc->dma_length = 0; break;
+			}
+			
+			lpc->dma_count = 0;
+			
+			if(lpc->dma_length == 0)
+			{
+				LPC_SetState(lpc, STATE_IDLE);
+			}
+			else if(lpc->direction == DIR_WRITE)
+			{
+				LPC_SetState(lpc, STATE_DATA_WRITE_0);
+			}
+			else
+			{
+				LPC_SetState(lpc, STATE_TAR_TO_PERIPHERAL_0);
+			}
+		
+		} break;
+		
+		// ### STATE_ADDR ### //
+		
+		case STATE_ADDR_0:
+		{
+			lpc->address = 0;
+			
+			lpc->address <<= 4;
+			lpc->address |= lad;
+			
+			LPC_SetState(lpc, LPC_DecodeNibble(lpc, 0, lad) ? STATE_ADDR_1 : STATE_IGNORE);
+		
+		} break;
+		
+		case STATE_ADDR_1:
+		{
+			lpc->address <<= 4;
+			lpc->address |= lad;
+			
+			LPC_SetState(lpc, LPC_DecodeNibble(lpc, 1, lad) ? STATE_ADDR_2 : STATE_IGNORE);
+		
+		} break;
+		
+		case STATE_ADDR_2:
+		{
+			lpc->address <<= 4;
+			lpc->address |= lad;
+			
+			LPC_SetState(lpc, LPC_DecodeNibble(lpc, 2, lad) ? STATE_ADDR_3 : STATE_IGNORE);
+		
+		} break;
+		
+		case STATE_ADDR_3:
+		{
+			lpc->address <<= 4;
+			lpc->address |= lad;
+			
+			if(!LPC_DecodeNibble(lpc, 3, lad))
+			{
+				LPC_SetState(lpc, STATE_IGNORE);
+			}
+			else if(lpc->direction == DIR_WRITE)
+			{
+				LPC_COUNT(lpc, io_writes);
+				
+				LPC_SetState(lpc, STATE_DATA_WRITE_0);
+			}
+			else
+			{
+				LPC_COUNT(lpc, io_reads);
+				
+				LPC_SetState(lpc, STATE_TAR_TO_PERIPHERAL_0);
+			}
+		
+		} break;
+		
+		// ### STATE_DATA_WRITE ### //
+		
+		case STATE_DATA_WRITE_0:
+		{
+			lpc->data = 0;
+			
+			lpc->data |= (lad << 0);
+			
+			LPC_SetState(lpc, STATE_DATA_WRITE_1);
+		
+		} break;
+		
+		case STATE_DATA_WRITE_1:
+		{
+			lpc->data |= (lad << 4);
+			
+			LPC_SetState(lpc, STATE_TAR_TO_PERIPHERAL_0);
+		
+		} break;
+		
+		// ### STATE_TAR_TO_PERIPHERAL ### //
+		
+		case STATE_TAR_TO_PERIPHERAL_0:
+		{
+			/* Drive out an early sync signal so that the sync is less likely to be missed by the host... */
+			
+			if(lpc->direction == DIR_READ)
+			{
+				lpc->synchronize_info = SYNC_SHORT_WAIT;
+			}
+			else if(lpc->cycle_type == CYCTYPE_DMA)
+			{
+				/* The DMA byte is complete, hand it over now so the early sync can already ask for more data */
+				lpc->dma_count += 1;
+				
+				if(LPC_HandleDMARead(lpc->messages, lpc->dma_channel_claimed, lpc->data, lpc->dma_terminal) && (lpc->dma_count == lpc->dma_length))
+				{
+					lpc->synchronize_info = SYNC_READY_MORE;
+				}
+				else
+				{
+					lpc->synchronize_info = SYNC_READY;
+				}
+			}
+			else
+			{
+				lpc->synchronize_info = SYNC_READY;
+			}
+			
+			LPC_Write(lpc, lpc->synchronize_info);
+			
+			LPC_SetState(lpc, STATE_TAR_TO_PERIPHERAL_1);
+		
+		} break;
+		
+		case STATE_TAR_TO_PERIPHERAL_1:
+		{
+			LPC_TurnAroundToPeripheral(lpc);
+			
+			LPC_SetState(lpc, STATE_SYNC);
+		
+		} break;
+		
+		// ### STATE_SYNC ### //
+		
+		case STATE_SYNC:
+		{
+			if(lpc->frame_info == FRAME_FWH_READ)
+			{
+				/* Firmware Memory reads are served straight from the registered buffer */
+				lpc->data = lpc->fwh_memory[lpc->fwh_address - lpc->fwh_memory_base];
+				lpc->fwh_count = 1;
+				
+				lpc->synchronize_info = SYNC_READY;
+				LPC_Write(lpc, lpc->synchronize_info);
+				
+				LPC_SetState(lpc, STATE_DATA_READ_0);
+			}
+			else if((lpc->cycle_type == CYCTYPE_DMA) && (lpc->direction == DIR_READ))
+			{
+				if(LPC_HandleDMAWrite(lpc->messages, lpc->dma_channel_claimed, (&lpc->data), lpc->dma_terminal, (&dma_more)))
+				{
+					lpc->dma_count += 1;
+					
+					lpc->synchronize_info = (dma_more && (lpc->dma_count == lpc->dma_length))
+						? SYNC_READY_MORE
+						: SYNC_READY;
+					LPC_Write(lpc, lpc->synchronize_info);
+					
+					LPC_SetState(lpc, STATE_DATA_READ_0);
+				}
+				else
+				{
+					LPC_COUNT(lpc, short_waits);
+					
+					lpc->synchronize_info = SYNC_SHORT_WAIT;
+					LPC_Write(lpc, lpc->synchronize_info);
+				}
+			}
+			else if(lpc->cycle_type == CYCTYPE_DMA)
+			{
+				/* Repeat the sync computed in STATE_TAR_TO_PERIPHERAL_0 */
+				LPC_Write(lpc, lpc->synchronize_info);
+				
+				LPC_SetState(lpc, STATE_TAR_TO_HOST_0);
+			}
+			else if(lpc->direction == DIR_READ)
+			{
+				if(LPC_SyncIORead(lpc, lpc->address))
+				{
+					LPC_SetState(lpc, STATE_DATA_READ_0);
+				}
+			}
+			else
+			{
+				lpc->synchronize_info = SYNC_READY;
+				LPC_Write(lpc, lpc->synchronize_info);
+				
+				if((lpc->direction == DIR_WRITE) && (lpc->cycle_type == CYCTYPE_IO))
+				{
+					LPC_HandleIOWrite(lpc, lpc->address, lpc->data);
+				}
+				
+				LPC_SetState(lpc, STATE_TAR_TO_HOST_0);
+			}
+		
+		} break;
+		
+		// ### STATE_DATA_READ ### //
+		
+		case STATE_DATA_READ_0:
+		{
+			LPC_Write(lpc, (lpc->data >> 0) & LPC_LAD_MASK);
+			
+			LPC_SetState(lpc, STATE_DATA_READ_1);
+		
+		} break;
+		
+		case STATE_DATA_READ_1:
+		{
+			LPC_Write(lpc, (lpc->data >> 4) & LPC_LAD_MASK);
+			
+			if((lpc->frame_info == FRAME_FWH_READ) && (lpc->fwh_count < lpc->fwh_length))
+			{
+				/* MSIZE burst: the next byte follows without another SYNC */
+				lpc->data = lpc->fwh_memory[(lpc->fwh_address - lpc->fwh_memory_base) + lpc->fwh_count];
+				lpc->fwh_count += 1;
+				
+				LPC_SetState(lpc, STATE_DATA_READ_0);
+			}
+			else if((lpc->cycle_type == CYCTYPE_DMA) && (lpc->dma_count < lpc->dma_length))
+			{
+				/* Each DMA byte to the host is preceded by its own SYNC */
+				LPC_SetState(lpc, STATE_SYNC);
+			}
+			else
+			{
+				LPC_SetState(lpc, STATE_TAR_TO_HOST_0);
+			}
+		
+		} break;
+		
+		// ### STATE_TAR_TO_HOST ### //
+		
+		case STATE_TAR_TO_HOST_0:
+		{
+			LPC_Write(lpc, 0xF);
+			
+			LPC_SetState(lpc, STATE_TAR_TO_HOST_1);
+			
+		} break;
+		
+		case STATE_TAR_TO_HOST_1:
+		{
+			LPC_TurnAroundToHost(lpc);
+			
+			if((lpc->cycle_type == CYCTYPE_DMA) && (lpc->direction == DIR_WRITE) && (lpc->dma_count < lpc->dma_length))
+			{
+				/* Each DMA byte from the host is followed by its own TAR, SYNC, TAR */
+				LPC_SetState(lpc, STATE_DATA_WRITE_0);
+			}
+			else
+			{
+				LPC_SetState(lpc, STATE_IDLE);
+			}
+		
+		} break;
+		
+		// ### STATE_ABORT ### //
+		
+		case STATE_ABORT:
+		{
+			/* LAD was released when LFRAME fell, nothing of the aborted cycle is left */
+			LPC_SetState(lpc, STATE_IDLE);
+			
+		} break;
+		
+		// ### STATE_FWH ### //
+		
+		case STATE_FWH_IDSEL:
+		{
+			lpc->fwh_idsel = lad;
+			lpc->fwh_address = 0;
+			lpc->fwh_count = 0;
+			
+			LPC_SetState(lpc, STATE_FWH_ADDR);
+		
+		} break;
+		
+		case STATE_FWH_ADDR:
+		{
+			lpc->fwh_address <<= 4;
+			lpc->fwh_address |= lad;
+			
+			lpc->fwh_count += 1;
+			
+			if(lpc->fwh_count == FWH_ADDR_NIBBLES)
+			{
+				LPC_SetState(lpc, STATE_FWH_MSIZE);
+			}
+		
+		} break;
+		
+		case STATE_FWH_MSIZE:
+		{
+			lpc->fwh_count = 0;
+			
+			if(!LPC_ClaimFirmwareMemory(lpc, lad))
+			{
+				/* Not ours, never turn the LAD pins around */
+				LPC_SetState(lpc, STATE_IDLE);
+			}
+			else if(lpc->direction == DIR_WRITE)
+			{
+				LPC_SetState(lpc, STATE_FWH_DATA_WRITE);
+			}
+			else
+			{
+				LPC_SetState(lpc, STATE_TAR_TO_PERIPHERAL_0);
+			}
+		
+		} break;
+		
+		case STATE_FWH_DATA_WRITE:
+		{
+			/* Least significant nibble first */
+			
+			if(lpc->fwh_count & 1)
+			{
+				lpc->data |= (lad << 4);
+				
+				if(lpc->fwh_memory_writable)
+				{
+					lpc->fwh_memory[(lpc->fwh_address - lpc->fwh_memory_base) + (lpc->fwh_count >> 1)] = lpc->data;
+				}
+			}
+			else
+			{
+				lpc->data = lad;
+			}
+			
+			lpc->fwh_count += 1;
+			
+			if(lpc->fwh_count == (lpc->fwh_length << 1))
+			{
+				LPC_SetState(lpc, STATE_TAR_TO_PERIPHERAL_0);
+			}
+		
+		} break;
+		
+		// ### STATE_IDLE, STATE_IGNORE, STATE_RESET ### //
+	
+		/* Nothing to sample, the framing above leaves these states on the next START */
+	
+		case STATE_IDLE:
+		case STATE_IGNORE:
+		case STATE_RESET:
+		default:
+		{
+		
+		} break;
+	}
+}
+
+#elif defined(LPC_TABLE_DECODER)
+
+/* ### Table Decoder ###
+ *
+ * The table is indexed by (state << 5) | (LFRAME << 4) | LAD, which is exactly the state concatenated with the
+ * LFRAME and LAD bits of the sampled GPIO value. Each entry holds the next state in the high byte and the action
+ * to perform in the low byte, so an edge costs one indexed load plus a small action.
+ *
+ * Unlike the switch decoder, the frame type is latched on every clock LFRAME is low (including the falling one),
+ * so a START held for a single clock is decoded as well.
+ */
+
+#if (LPC_LFRAME_MASK != 0x10) || (LPC_LAD_MASK != 0xF)
+#error "The table decoder requires LFRAME on the GPIO bit directly above the LAD nibble"
+#endif
+
+#define DECODE_INDEX_MASK	(LPC_LFRAME_MASK | LPC_LAD_MASK)
+
+#define DECODE_ENTRY(next, action)	((UINT16)(((next) << 8) | (action)))
+
+#define DECODE_ENTRY_4(next, action)	DECODE_ENTRY(next, action), DECODE_ENTRY(next, action), DECODE_ENTRY(next, action), DECODE_ENTRY(next, action)
+
+#define DECODE_ROW(next, action)	DECODE_ENTRY_4(next, action), DECODE_ENTRY_4(next, action), DECODE_ENTRY_4(next, action), DECODE_ENTRY_4(next, action)
+
+// LFRAME low: latch the frame type from LAD, START 0000b and ABORT 1111b
+
+#define DECODE_FRAME_ROW(action)						\
+	DECODE_ENTRY(DECODE_FRAME_START, action),				\
+	DECODE_ENTRY(DECODE_FRAME_OTHER, action),				\
+	DECODE_ENTRY(DECODE_FRAME_OTHER, action),				\
+	DECODE_ENTRY(DECODE_FRAME_OTHER, action),				\
+	DECODE_ENTRY_4(DECODE_FRAME_OTHER, action),				\
+	DECODE_ENTRY_4(DECODE_FRAME_OTHER, action),				\
+	DECODE_ENTRY(DECODE_FRAME_OTHER, action),				\
+	DECODE_ENTRY(DECODE_FRAME_OTHER, action),				\
+	DECODE_ENTRY(DECODE_FRAME_OTHER, action),				\
+	DECODE_ENTRY(DECODE_FRAME_ABORT, action)
+
+// LFRAME rising after START: CYCTYPE (bits 3:2) and DIR (bit 1), only I/O cycles are accepted
+
+#define DECODE_CYCTYPE_AND_DIR_ROW						\
+	DECODE_ENTRY(DECODE_ADDR_0_READ, ACTION_NONE),				\
+	DECODE_ENTRY(DECODE_ADDR_0_READ, ACTION_NONE),				\
+	DECODE_ENTRY(DECODE_ADDR_0_WRITE, ACTION_NONE),				\
+	DECODE_ENTRY(DECODE_ADDR_0_WRITE, ACTION_NONE),				\
+	DECODE_ENTRY_4(DECODE_IDLE, ACTION_NONE),				\
+	DECODE_ENTRY_4(DECODE_IDLE, ACTION_NONE),				\
+	DECODE_ENTRY_4(DECODE_IDLE, ACTION_NONE)
+
+// A state that LFRAME falling interrupts (LFRAME low row) and how it continues (LFRAME high row)
+
+#define DECODE_STATE(next, action)						\
+	DECODE_FRAME_ROW(ACTION_TURN_AROUND_TO_HOST),				\
+	DECODE_ROW(next, action)
+
+// The same for the states of an I/O read the device may have answered, LFRAME falling aborts the read
+
+#define DECODE_READ_STATE(next, action, abort)					\
+	DECODE_FRAME_ROW(abort),						\
+	DECODE_ROW(next, action)
+
+const UINT16 lpc_decode_table[DECODE_STATE_COUNT << 5] = {
+	/* DECODE_IDLE */			DECODE_STATE(DECODE_IDLE, ACTION_NONE),
+	/* DECODE_FRAME_START */		DECODE_FRAME_ROW(ACTION_NONE), DECODE_CYCTYPE_AND_DIR_ROW,
+	/* DECODE_FRAME_ABORT */		DECODE_FRAME_ROW(ACTION_NONE), DECODE_ROW(DECODE_ABORT, ACTION_ABORT),
+	/* DECODE_FRAME_OTHER */		DECODE_FRAME_ROW(ACTION_NONE), DECODE_ROW(DECODE_IDLE, ACTION_NONE),
+	/* DECODE_ABORT */			DECODE_STATE(DECODE_ABORT, ACTION_NONE),
+	/* DECODE_ADDR_0_READ */		DECODE_STATE(DECODE_ADDR_1_READ, ACTION_ADDR_0),
+	/* DECODE_ADDR_1_READ */		DECODE_STATE(DECODE_ADDR_2_READ, ACTION_ADDR_1),
+	/* DECODE_ADDR_2_READ */		DECODE_STATE(DECODE_ADDR_3_READ, ACTION_ADDR_2),
+	/* DECODE_ADDR_3_READ */		DECODE_STATE(DECODE_TAR_TO_PERIPHERAL_0_READ, ACTION_ADDR_3),
+	/* DECODE_ADDR_0_WRITE */		DECODE_STATE(DECODE_ADDR_1_WRITE, ACTION_ADDR_0),
+	/* DECODE_ADDR_1_WRITE */		DECODE_STATE(DECODE_ADDR_2_WRITE, ACTION_ADDR_1),
+	/* DECODE_ADDR_2_WRITE */		DECODE_STATE(DECODE_ADDR_3_WRITE, ACTION_ADDR_2),
+	/* DECODE_ADDR_3_WRITE */		DECODE_STATE(DECODE_DATA_WRITE_0, ACTION_ADDR_3),
+	/* DECODE_DATA_WRITE_0 */		DECODE_STATE(DECODE_DATA_WRITE_1, ACTION_DATA_WRITE_0),
+	/* DECODE_DATA_WRITE_1 */		DECODE_STATE(DECODE_TAR_TO_PERIPHERAL_0_WRITE, ACTION_DATA_WRITE_1),
+	/* DECODE_TAR_TO_PERIPHERAL_0_READ */	DECODE_STATE(DECODE_TAR_TO_PERIPHERAL_1_READ, ACTION_DRIVE_SYNC_SHORT_WAIT),
+	/* DECODE_TAR_TO_PERIPHERAL_0_WRITE */	DECODE_STATE(DECODE_TAR_TO_PERIPHERAL_1_WRITE, ACTION_DRIVE_SYNC_READY),
+	/* DECODE_TAR_TO_PERIPHERAL_1_READ */	DECODE_STATE(DECODE_SYNC_READ, ACTION_TURN_AROUND_TO_PERIPHERAL),
+	/* DECODE_TAR_TO_PERIPHERAL_1_WRITE */	DECODE_STATE(DECODE_SYNC_WRITE, ACTION_TURN_AROUND_TO_PERIPHERAL),
+	/* DECODE_SYNC_READ */			DECODE_READ_STATE(DECODE_SYNC_READ, ACTION_SYNC_READ, ACTION_ABORT_IO_SYNC),
+	/* DECODE_SYNC_WRITE */			DECODE_STATE(DECODE_TAR_TO_HOST_0, ACTION_SYNC_WRITE),
+	/* DECODE_DATA_READ_0 */		DECODE_READ_STATE(DECODE_DATA_READ_1, ACTION_DATA_READ_0, ACTION_ABORT_IO_READ),
+	/* DECODE_DATA_READ_1 */		DECODE_READ_STATE(DECODE_TAR_TO_HOST_0, ACTION_DATA_READ_1, ACTION_ABORT_IO_READ),
+	/* DECODE_TAR_TO_HOST_0 */		DECODE_STATE(DECODE_TAR_TO_HOST_1, ACTION_TAR_TO_HOST_0),
+	/* DECODE_TAR_TO_HOST_1 */		DECODE_STATE(DECODE_IDLE, ACTION_TURN_AROUND_TO_HOST),
+	/* DECODE_IGNORE */			DECODE_FRAME_ROW(ACTION_NONE), DECODE_ROW(DECODE_IGNORE, ACTION_NONE),
+	/* DECODE_RESET */			DECODE_FRAME_ROW(ACTION_NONE), DECODE_ROW(DECODE_RESET, ACTION_NONE)
+};
+
+__inline void
+LPC_DecodeEdge(LPC_CONTEXT *lpc)
+{
+	UINT8 signal;
+	UINT8 lad;
+	UINT16 entry;
+	LPC_DECODE_ACTION action;
+
+	signal = LPC_Read(lpc);
+	lad = (signal & LPC_LAD_MASK);
+
+	DEBUG_TRACE_EDGE(DEBUG_EVENT_EDGE, lpc->decode_state, lpc->address, signal);
+
+	/* LRESET is not part of the table index, the bus is idle until it is released */
+	if(IS_LOW(signal & LPC_LRESET_MASK))
+	{
+		if(lpc->decode_state != DECODE_RESET) LPC_HandleReset(lpc);
+
+		return;
+	}
+
+	entry = lpc_decode_table[(lpc->decode_state << 5) | (signal & DECODE_INDEX_MASK)];
+
+	lpc->decode_state = (UINT8)(entry >> 8);
+	action = (LPC_DECODE_ACTION)(entry & 0xFF);
+
+	switch(action)
+	{
+		case ACTION_NONE:
+		{
+		} break;
+
+		case ACTION_TURN_AROUND_TO_HOST:
+		{
+			LPC_TurnAroundToHost(lpc);
+
+			lpc->read_pending = FALSE;
+
+		} break;
+
+		case ACTION_ABORT_IO_SYNC:
+		{
+			/* Only a pending read was answered during SYNC, see Abort and Reset */
+			if(lpc->read_pending) LPC_AbortIORead(lpc, lpc->address);
+
+			LPC_TurnAroundToHost(lpc);
+
+		} break;
+
+		case ACTION_ABORT_IO_READ:
+		{
+			LPC_AbortIORead(lpc, lpc->address);
+
+			LPC_TurnAroundToHost(lpc);
+
+		} break;
+
+		case ACTION_ADDR_0:
+		{
+			lpc->address = lad;
+
+			if(!LPC_DecodeNibble(lpc, 0, lad)) lpc->decode_state = DECODE_IGNORE;
+
+		} break;
+
+		case ACTION_ADDR_1:
+		case ACTION_ADDR_2:
+		case ACTION_ADDR_3:
+		{
+			lpc->address = (lpc->address << 4) | lad;
+
+			/* The actions are numbered like the address nibbles */
+			if(!LPC_DecodeNibble(lpc, (UINT8)(action - ACTION_ADDR_0), lad)) lpc->decode_state = DECODE_IGNORE;
+
+		} break;
+
+		case ACTION_DATA_WRITE_0:
+		{
+			lpc->data = lad;
+
+		} break;
+
+		case ACTION_DATA_WRITE_1:
+		{
+			lpc->data |= (lad << 4);
+
+		} break;
+
+		case ACTION_DRIVE_SYNC_SHORT_WAIT:
+		{
+			/* Early sync, see STATE_TAR_TO_PERIPHERAL_0 */
+			LPC_Write(lpc, SYNC_SHORT_WAIT);
+
+			LPC_COUNT(lpc, io_reads);
+
+		} break;
+
+		case ACTION_DRIVE_SYNC_READY:
+		{
+			LPC_Write(lpc, SYNC_READY);
+
+			LPC_COUNT(lpc, io_writes);
+
+		} break;
+
+		case ACTION_TURN_AROUND_TO_PERIPHERAL:
+		{
+			LPC_TurnAroundToPeripheral(lpc);
+
+		} break;
+
+		case ACTION_SYNC_READ:
+		{
+			if(LPC_SyncIORead(lpc, lpc->address))
+			{
+				lpc->decode_state = DECODE_DATA_READ_0;
+			}
+
+		} break;
+
+		case ACTION_SYNC_WRITE:
+		{
+			LPC_Write(lpc, SYNC_READY);
+
+			LPC_HandleIOWrite(lpc, lpc->address, lpc->data);
+
+		} break;
+
+		case ACTION_DATA_READ_0:
+		{
+			LPC_Write(lpc, (lpc->data >> 0) & LPC_LAD_MASK);
+
+		} break;
+
+		case ACTION_DATA_READ_1:
+		{
+			LPC_Write(lpc, (lpc->data >> 4) & LPC_LAD_MASK);
+
+		} break;
+
+		case ACTION_TAR_TO_HOST_0:
+		{
+			LPC_Write(lpc, 0xF);
+
+		} break;
+
+		case ACTION_ABORT:
+		{
+			LPC_COUNT(lpc, aborts);
+			DEBUG_TRACE_MESSAGE(DEBUG_EVENT_ABORT, lpc->decode_state, lpc->address, 0);
+
+		} break;
+	}
+}
+
+#else /* LPC_DEFERRED_DECODE */
+
+/* ### Deferred Decoder ###
+ *
+ * Top half (LCLK interrupt): store the sampled GPIO value into lpc->sample_ring and follow the cycle just far enough
+ * to drive TAR/SYNC/data at the right clocks. Addresses and write data are not assembled here.
+ *
+ * Bottom half (LPC_ProcessSamples, main loop): decode the captured samples into I/O write transactions and dispatch
+ * them to LPC_HandleIOWrite in batches.
+ *
+ * Reads are answered inline (the fast path): on SYNC the top half assembles the address from the captured samples and
+ * calls LPC_HandleIORead, but only once the bottom half has dispatched every write that preceded the read cycle,
+ * until then it drives SYNC_SHORT_WAIT.
+ */
+
+__inline UINT16
+LPC_SampledAddress(LPC_CONTEXT *lpc)
+{
+	UINT32 i = lpc->sample_cycle + 1;
+	UINT16 address;
+
+	address  = (lpc->sample_ring[(i + 0) & LPC_SAMPLE_RING_MASK] & LPC_LAD_MASK) << 12;
+	address |= (lpc->sample_ring[(i + 1) & LPC_SAMPLE_RING_MASK] & LPC_LAD_MASK) << 8;
+	address |= (lpc->sample_ring[(i + 2) & LPC_SAMPLE_RING_MASK] & LPC_LAD_MASK) << 4;
+	address |= (lpc->sample_ring[(i + 3) & LPC_SAMPLE_RING_MASK] & LPC_LAD_MASK) << 0;
+
+	return address;
+}
+
+__inline void
+LPC_DecodeEdge(LPC_CONTEXT *lpc)
+{
+	UINT8 lframe;
+	UINT8 last_lframe;
+	UINT8 signal;
+	UINT8 lad;
+	UINT32 head;
+
+	// Capture
+
+	signal = LPC_Read(lpc);
+
+	head = lpc->sample_head;
+	lpc->sample_ring[head & LPC_SAMPLE_RING_MASK] = signal;
+	lpc->sample_head = head + 1;
+
+	DEBUG_TRACE_EDGE(DEBUG_EVENT_EDGE, LPC_GetState(lpc), 0, signal);
+
+	/* The sample is captured anyway, the bottom half resets the message protocol when it gets to it */
+	if(IS_LOW(signal & LPC_LRESET_MASK))
+	{
+		if(LPC_GetState(lpc) != STATE_RESET) LPC_HandleReset(lpc);
+
+		return;
+	}
+
+	last_lframe = lpc->lframe;
+	lframe = (signal & LPC_LFRAME_MASK);
+	lpc->lframe = lframe;
+
+	lad = (signal & LPC_LAD_MASK);
+
+	/* ### State Machine - Handle Frame ### */
+
+	if(IS_LOW(lframe))
+	{
+		if(IS_HIGH(last_lframe))
+		{
+			if(LPC_IOReadInterrupted(lpc)) LPC_AbortIORead(lpc, LPC_SampledAddress(lpc));
+
+			if(LPC_GetState(lpc) != STATE_IGNORE) LPC_TurnAroundToHost(lpc);
+			LPC_SetState(lpc, STATE_IDLE);
+
+			lpc->read_pending = FALSE;
+		}
+
+		/* The frame is the LAD value of the last clock LFRAME is low, which may also be the first */
+		lpc->frame_info = (LPC_FRAME)lad;
+
+		return;
+	}
+
+	if(IS_LOW(last_lframe))
+	{
+		if(lpc->frame_info != FRAME_START)
+		{
+			if(lpc->frame_info == FRAME_ABORT)
+			{
+				LPC_COUNT(lpc, aborts);
+				DEBUG_TRACE_MESSAGE(DEBUG_EVENT_ABORT, LPC_GetState(lpc), 0, 0);
+			}
+
+			LPC_SetState(lpc, (lpc->frame_info == FRAME_ABORT) ? STATE_ABORT : STATE_IDLE);
+		}
+		else if(((lad & LPC_CYCTYPE_MASK) >> 2) != CYCTYPE_IO)
+		{
+			LPC_SetState(lpc, STATE_IDLE);
+		}
+		else
+		{
+			lpc->sample_cycle = head;
+			lpc->direction = (LPC_DIR)((lad & LPC_DIR_MASK) >> 1);
+
+			LPC_SetState(lpc, STATE_ADDR_0);
+		}
+
+		return;
+	}
+
+	/* ### State Machine - Handle Cycle ### */
+
+	switch(LPC_GetState(lpc))
+	{
+		case STATE_ADDR_0:		LPC_SetState(lpc, LPC_DecodeNibble(lpc, 0, lad) ? STATE_ADDR_1 : STATE_IGNORE); break;
+		case STATE_ADDR_1:		LPC_SetState(lpc, LPC_DecodeNibble(lpc, 1, lad) ? STATE_ADDR_2 : STATE_IGNORE); break;
+		case STATE_ADDR_2:		LPC_SetState(lpc, LPC_DecodeNibble(lpc, 2, lad) ? STATE_ADDR_3 : STATE_IGNORE); break;
+
+		case STATE_ADDR_3:
+		{
+			if(!LPC_DecodeNibble(lpc, 3, lad))
+			{
+				LPC_SetState(lpc, STATE_IGNORE);
+				break;
+			}
+
+			if(lpc->direction == DIR_WRITE) LPC_COUNT(lpc, io_writes); else LPC_COUNT(lpc, io_reads);
+
+			LPC_SetState(lpc, (lpc->direction == DIR_WRITE) ? STATE_DATA_WRITE_0 : STATE_TAR_TO_PERIPHERAL_0);
+
+		} break;
+
+		case STATE_DATA_WRITE_0:	LPC_SetState(lpc, STATE_DATA_WRITE_1); break;
+		case STATE_DATA_WRITE_1:	LPC_SetState(lpc, STATE_TAR_TO_PERIPHERAL_0); break;
+
+		case STATE_TAR_TO_PERIPHERAL_0:
+		{
+			/* Early sync, see the switch decoder */
+			LPC_Write(lpc, (lpc->direction == DIR_READ) ? SYNC_SHORT_WAIT : SYNC_READY);
+
+			LPC_SetState(lpc, STATE_TAR_TO_PERIPHERAL_1);
+
+		} break;
+
+		case STATE_TAR_TO_PERIPHERAL_1:
+		{
+			LPC_TurnAroundToPeripheral(lpc);
+
+			LPC_SetState(lpc, STATE_SYNC);
+
+		} break;
+
+		case STATE_SYNC:
+		{
+			if(lpc->direction == DIR_WRITE)
+			{
+				/* Posted write, the bottom half hands it to LPC_HandleIOWrite */
+				LPC_Write(lpc, SYNC_READY);
+
+				LPC_SetState(lpc, STATE_TAR_TO_HOST_0);
+			}
+			else if((SINT32)(lpc->sample_tail - lpc->sample_cycle) >= 0)
+			{
+				if(LPC_SyncIORead(lpc, LPC_SampledAddress(lpc)))
+				{
+					LPC_SetState(lpc, STATE_DATA_READ_0);
+				}
+			}
+			else
+			{
+				LPC_Write(lpc, SYNC_SHORT_WAIT); /* Hold off until the bottom half has caught up */
+			}
+
+		} break;
+
+		case STATE_DATA_READ_0:
+		{
+			LPC_Write(lpc, (lpc->data >> 0) & LPC_LAD_MASK);
+
+			LPC_SetState(lpc, STATE_DATA_READ_1);
+
+		} break;
+
+		case STATE_DATA_READ_1:
+		{
+			LPC_Write(lpc, (lpc->data >> 4) & LPC_LAD_MASK);
+
+			LPC_SetState(lpc, STATE_TAR_TO_HOST_0);
+
+		} break;
+
+		case STATE_TAR_TO_HOST_0:
+		{
+			LPC_Write(lpc, 0xF);
+
+			LPC_SetState(lpc, STATE_TAR_TO_HOST_1);
+
+		} break;
+
+		case STATE_TAR_TO_HOST_1:
+		{
+			LPC_TurnAroundToHost(lpc);
+
+			LPC_SetState(lpc, STATE_IDLE);
+
+		} break;
+
+		default:
+		{
+		} break;
+	}
+}
+
+void LPC_ProcessSamples(LPC_CONTEXT *lpc)
+{
+	/* The decoder state lives in the context between calls, and in locals while the samples are decoded */
+	UINT8 lframe = lpc->process_lframe;
+	LPC_IO_CYCLE_STATE state = (LPC_IO_CYCLE_STATE)lpc->process_state;
+	LPC_FRAME frame_info = (LPC_FRAME)lpc->process_frame_info;
+	UINT16 address = lpc->process_address;
+	UINT8 data = lpc->process_data;
+
+	LPC_TRANSACTION batch[LPC_TRANSACTION_BATCH_LENGTH];
+	int batch_length = 0;
+	int i;
+
+	UINT32 head = lpc->sample_head;
+	UINT32 tail = lpc->sample_tail;
+
+	UINT8 last_lframe;
+	UINT8 signal;
+	UINT8 lad;
+
+	if((head - tail) > LPC_SAMPLE_RING_LENGTH)
+	{
+		/* The top half has overwritten samples that were never decoded, drop them and wait for the next LFRAME like after an abort */
+		lpc->sample_overruns += 1;
+
+		lpc->process_lframe = LPC_LFRAME_MASK;
+		lpc->process_state = STATE_IDLE;
+		lpc->process_frame_info = FRAME_ABORT;
+
+		lpc->sample_tail = head;
+
+		return;
+	}
+
+	while(tail != head)
+	{
+		signal = lpc->sample_ring[tail & LPC_SAMPLE_RING_MASK];
+		tail += 1;
+
+		if(IS_LOW(signal & LPC_LRESET_MASK))
+		{
+			if(state != STATE_RESET)
+			{
+				/* Writes decoded before the reset go to the devices first */
+				for(i = 0; i < batch_length; i++)
+				{
+					LPC_HandleIOWrite(lpc, batch[i].address, batch[i].data);
+				}
+
+				batch_length = 0;
+
+				LPC_ResetIOMessages(lpc->messages);
+			}
+
+			state = STATE_RESET;
+			lframe = LPC_LFRAME_MASK;
+
+			continue;
+		}
+
+		last_lframe = lframe;
+		lframe = (signal & LPC_LFRAME_MASK);
+
+		lad = (signal & LPC_LAD_MASK);
+
+		if(IS_LOW(lframe))
+		{
+			/* Mirror the top half, the frame type is latched on every clock LFRAME is low */
+			frame_info = (LPC_FRAME)lad;
+
+			state = STATE_IDLE;
+
+			continue;
+		}
+
+		if(IS_LOW(last_lframe))
+		{
+			/* Only I/O writes are left to the bottom half, reads are answered by the top half */
+			state = ((frame_info == FRAME_START) && (lad == ((CYCTYPE_IO << 2) | (DIR_WRITE << 1))))
+				? STATE_ADDR_0
+				: STATE_IDLE;
+
+			continue;
+		}
+
+		switch(state)
+		{
+			case STATE_ADDR_0:
+			case STATE_ADDR_1:
+			case STATE_ADDR_2:
+			case STATE_ADDR_3:
+			{
+				address = (state == STATE_ADDR_0) ? lad : ((address << 4) | lad);
+
+				/* The top half ignored writes outside the decode windows, so does the bottom half */
+				if((state == STATE_ADDR_3) && (LPC_DecodeWindows(lpc, address) == 0))
+				{
+					state = STATE_IDLE;
+					break;
+				}
+
+				state = (LPC_IO_CYCLE_STATE)(state + 1);
+
+			} break;
+
+			case STATE_DATA_WRITE_0:
+			{
+				data = lad;
+
+				state = STATE_DATA_WRITE_1;
+
+			} break;
+
+			case STATE_DATA_WRITE_1:
+			{
+				batch[batch_length].address = address;
+				batch[batch_length].data = data | (lad << 4);
+				batch_length += 1;
+
+				state = STATE_IDLE;
+
+				if(batch_length == LPC_TRANSACTION_BATCH_LENGTH)
+				{
+					for(i = 0; i < batch_length; i++)
+					{
+						LPC_HandleIOWrite(lpc, batch[i].address, batch[i].data);
+					}
+
+					batch_length = 0;
+
+					lpc->sample_tail = tail;
+				}
+
+			} break;
+
+			default:
+			{
+			} break;
+		}
+	}
+
+	for(i = 0; i < batch_length; i++)
+	{
+		LPC_HandleIOWrite(lpc, batch[i].address, batch[i].data);
+	}
+
+	lpc->process_lframe = lframe;
+	lpc->process_state = (UINT8)state;
+	lpc->process_frame_info = (UINT8)frame_info;
+	lpc->process_address = address;
+	lpc->process_data = data;
+
+	/* Publish only after dispatching, the read fast path relies on it */
+	lpc->sample_tail = tail;
+}
+
+#endif
+
+/* One falling LCLK edge: decode it, then let the GPIO backend store what the decoder drove (see GPIO_Flush) */
+void LPC_HandleCycle(LPC_CONTEXT *lpc)
+{
+	LPC_DecodeEdge(lpc);
+	
+	GPIO_Flush(&lpc->gpio);
+}
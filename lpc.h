@@ -1,23 +1,472 @@
-#ifndef LPC_STATE_MACHINE_H
-#define LPC_STATE_MACHINE_H
-
-#include "ptypes.h"
-
-/* When the LPC state machine receives a message use LPC_GetIOMessage to read the message from the host.
- *
- * You may call LPC_GetIOMessage as many times as you like before you call LPC_SetIOMessage,
- * it will make a copy of the message buffer and write it to the memory location provided,
- * and return TRUE, otherwise it will return FALSE.
- */
-extern BOOL	LPC_GetIOMessage(UINT8 *message, UINT8 *message_length);
-
-/* When the LPC state machine receives a message use LPC_SetIOMessage to write a message to the host.
- *
- * You can only call LPC_SetIOMessage once per message received,
- * this will copy the contents of the parameters into the io transmission buffer,
- * give control to the io transmission state machine,
- * and return TRUE, otherwise it will return FALSE.
- */
-extern BOOL	LPC_SetIOMessage(UINT8 *message, UINT8 message_length);
-
-#endif
+#ifndef LPC_STATE_MACHINE_H
+#define LPC_STATE_MACHINE_H
+
+#include "ptypes.h"
+#include "gpio_backend.h"
+
+/* Every function below acts on one LPC port (LPC_CONTEXT) or one message protocol instance (LPC_MESSAGES),
+ * see Ports at the end of this file. The board's port is lpc_port (gpio.c).
+ */
+typedef struct LPC_CONTEXT	LPC_CONTEXT;
+typedef struct LPC_MESSAGES	LPC_MESSAGES;
+
+/* Result of an I/O read handler (see LPC_RegisterIODevice).
+ *
+ * IO_READ_RETRY: the data is not available, the state machine drives short wait syncs and asks again on the next SYNC clock,
+ * the host aborts the cycle after 8 clocks.
+ * IO_READ_PENDING: the data will be supplied later with LPC_CompleteIORead, the state machine drives long wait syncs until then.
+ */
+typedef enum {
+	IO_READ_RETRY		= FALSE,
+	IO_READ_READY		= TRUE,
+	IO_READ_PENDING		= 2
+} LPC_IO_READ_RESULT;
+
+/* I/O devices (see lpc_io_dispatch.c), handlers are passed the address relative to the base of their range.
+ *
+ * LPC_RegisterIODevice routes I/O cycles to [base, base + length) to read and write, a range registered later
+ * replaces earlier ones on the addresses they share. Pass NULL for a direction the device does not handle, the
+ * addresses keep their previous handler for that direction. Returns FALSE if the device or page table is full.
+ *
+ * LPC_ResetIODevices removes every device, LPC_Initialize calls it and registers the message protocol
+ * (LPC_RegisterIOMessages) at address 0, register further devices after LPC_Initialize.
+ * Reads from addresses no device claims drive short wait syncs until the host aborts the cycle.
+ */
+typedef LPC_IO_READ_RESULT	(*LPC_IO_READ_HANDLER)(void *context, UINT16 address, UINT8 *data);
+typedef void			(*LPC_IO_WRITE_HANDLER)(void *context, UINT16 address, UINT8 data);
+
+extern BOOL	LPC_RegisterIODevice(LPC_CONTEXT *lpc, UINT16 base, UINT16 length, LPC_IO_READ_HANDLER read, LPC_IO_WRITE_HANDLER write, void *context);
+extern void	LPC_ResetIODevices(LPC_CONTEXT *lpc);
+
+/* Serve the message protocol of messages (see lpc_io_transmission.c) at base on lpc, which also carries its DMA cycles */
+extern BOOL	LPC_RegisterIOMessages(LPC_CONTEXT *lpc, LPC_MESSAGES *messages, UINT16 base);
+
+/* Positive decode: the slave only claims I/O cycles to addresses inside one of LPC_DECODE_WINDOWS decode windows.
+ *
+ * A window covers the addresses that equal base in every bit that is clear in mask (base 0x02E0, mask 0x0007 covers
+ * 0x02E0-0x02E7). Other cycles are dropped at the first address nibble that no window accepts, LAD is never driven
+ * and the host aborts them when nobody answers the SYNC. LPC_Initialize opens window 0 over the message protocol
+ * (0x0000-0x01FF), devices registered elsewhere need a window of their own.
+ *
+ * LPC_GetDecodeStats copies the decode statistics to stats, clear resets them after copying them.
+ */
+#define LPC_DECODE_WINDOWS	(8)
+
+typedef struct {
+	UINT32	cycles;				// I/O cycles seen
+	UINT32	rejected[4];			// Cycles dropped at each address nibble (bits 15:12 first)
+	UINT32	hits[LPC_DECODE_WINDOWS];	// Cycles claimed through each window (overlapping windows all count)
+	UINT32	misses[LPC_DECODE_WINDOWS];	// Cycles outside each window
+} LPC_DECODE_STATS;
+
+extern BOOL	LPC_SetDecodeWindow(LPC_CONTEXT *lpc, UINT8 window, UINT16 base, UINT16 mask);
+extern void	LPC_ClearDecodeWindow(LPC_CONTEXT *lpc, UINT8 window);
+extern void	LPC_GetDecodeStats(LPC_CONTEXT *lpc, LPC_DECODE_STATS *stats, BOOL clear);
+
+/* Instrumentation counters, built with -DLPC_INSTRUMENT only, without it LPC_COUNT compiles to nothing.
+ *
+ * The host reads them through the counter window at LPC_COUNTERS_BASE (inside decode window 0):
+ * writing LPC_COUNTERS_BASE latches a snapshot (and clears the counters if bit 0 of the data is set),
+ * reading it returns the number of counters, and the snapshot follows from LPC_COUNTERS_BASE + 4,
+ * one 32-bit counter after the other, least significant byte first.
+ * The table and deferred decoders only see I/O cycles, their memory and DMA counters stay 0.
+ */
+#define LPC_COUNTERS_BASE	(0x0180)
+
+typedef struct {
+	UINT32	io_reads;
+	UINT32	io_writes;
+	UINT32	memory_cycles;			// CYCTYPE memory and Firmware Memory frames
+	UINT32	dma_cycles;
+	UINT32	aborts;				// ABORT frames from the host
+	UINT32	short_waits;			// SYNC_SHORT_WAIT clocks driven while the data was not ready
+	UINT32	long_waits;			// SYNC_LONG_WAIT clocks driven for pending reads
+	UINT32	reads_retried;			// I/O reads the handler could not answer yet (IO_READ_RETRY)
+	UINT32	reads_pending;			// I/O reads the handler left pending (IO_READ_PENDING)
+	UINT32	ignored;			// I/O cycles outside the decode windows
+	UINT32	acks_passed;			// ACK reads that accepted a page (one per message or page, not the re-reads)
+	UINT32	acks_failed;			// ACK reads that returned a failure
+	UINT32	replies_passed;			// ACK_PASS writes from the host
+	UINT32	replies_failed;
+	UINT32	snapshots;
+	UINT32	reads_aborted;			// I/O reads the host aborted after the device answered them
+	UINT32	resets;				// LRESET assertions
+} LPC_COUNTERS;
+
+#define LPC_COUNTERS_LENGTH	(4 + sizeof(LPC_COUNTERS))
+
+#ifdef LPC_INSTRUMENT
+#define LPC_COUNT(lpc, counter)	((lpc)->counters.counter += 1)
+#else
+#define LPC_COUNT(lpc, counter)	((void)0)
+#endif
+
+/* Copy the counters to counters (all 0 without LPC_INSTRUMENT), clear resets them after copying them. */
+extern void	LPC_GetCounters(LPC_CONTEXT *lpc, LPC_COUNTERS *counters, BOOL clear);
+
+/* Complete the I/O read that LPC_HandleIORead left pending, the data is returned to the host on the next SYNC clock.
+ *
+ * Returns FALSE if no read is pending, for example because the host aborted the cycle.
+ */
+extern BOOL	LPC_CompleteIORead(LPC_CONTEXT *lpc, UINT8 data);
+
+/* When the LPC state machine receives a message use LPC_GetIOMessage to read the message from the host.
+ *
+ * Messages are queued, LPC_GetIOMessage returns the oldest message that has not been answered yet.
+ * You may call LPC_GetIOMessage as many times as you like before you call LPC_SetIOMessage,
+ * it will make a copy of the message buffer and write it to the memory location provided,
+ * and return TRUE, otherwise (no message, a message longer than 255 bytes or one that did not expand) it will return FALSE.
+ */
+extern BOOL	LPC_GetIOMessage(LPC_MESSAGES *messages, UINT8 *message, UINT8 *message_length);
+
+/* When the LPC state machine receives a message use LPC_SetIOMessage to write a message to the host.
+ *
+ * You can only call LPC_SetIOMessage once per message received,
+ * this will copy the contents of the parameters into the next reply slot,
+ * release the message returned by LPC_GetIOMessage,
+ * and return TRUE, otherwise (no message, or every reply slot is still waiting for the host) it will return FALSE.
+ */
+extern BOOL	LPC_SetIOMessage(LPC_MESSAGES *messages, UINT8 *message, UINT8 message_length);
+
+/* Zero-copy access to the message queue, LPC_GetIOMessage and LPC_SetIOMessage are built on these.
+ *
+ * LPC_LeaseIOMessage returns the oldest message that has not been answered yet in place (NULL if there is none),
+ * the buffer stays valid and unchanged until the reply is committed. A compressed message that passed its integrity
+ * check but does not expand (see LPC_SetIOExpandBuffer) is not handed out: NULL is returned with message_length set
+ * to LPC_MESSAGE_EXPAND_ERROR, until the application releases it by committing a reply (the host already got ACK_PASS).
+ *
+ * LPC_LeaseIOReply returns a buffer for a reply of up to reply_length bytes to that message (256 bytes, or the
+ * large transmit buffer for replies of 256 bytes or more), or NULL if there is no message or no free reply buffer.
+ *
+ * LPC_CommitIOReply hands the first reply_length bytes of the reply buffer to the host and releases the message,
+ * both leased buffers must not be used afterwards. It masks the GPIO interrupt while it updates the state the LCLK
+ * interrupt shares.
+ */
+#define LPC_MESSAGE_EXPAND_ERROR	(0xFFFF)
+
+extern UINT8 *	LPC_LeaseIOMessage(LPC_MESSAGES *messages, UINT16 *message_length);
+extern UINT8 *	LPC_LeaseIOReply(LPC_MESSAGES *messages, UINT16 reply_length);
+extern BOOL	LPC_CommitIOReply(LPC_MESSAGES *messages, UINT16 reply_length);
+
+/* Accept messages and send replies of 256 up to length bytes (see Large Messages in lpc_io_transmission.c).
+ *
+ * The host sends such messages in 256 byte pages which are reassembled into receive, replies are read from transmit.
+ * One large message and one large reply can be queued at a time. Pass NULL buffers to refuse large messages (the default).
+ */
+extern void	LPC_SetIOLargeBuffers(LPC_MESSAGES *messages, UINT8 *receive, UINT8 *transmit, UINT16 length);
+
+/* Accept compressed messages (see lz.h) which expand to up to length bytes, they are expanded into buffer
+ * by LPC_LeaseIOMessage (and so LPC_GetIOMessage) before they are handed to the application.
+ * Pass a NULL buffer to refuse compressed messages (the default), the host then sends them uncompressed.
+ */
+extern void	LPC_SetIOExpandBuffer(LPC_MESSAGES *messages, UINT8 *buffer, UINT16 length);
+
+/* Message queue depth statistics */
+typedef struct {
+	UINT8	rx_depth;		// Messages waiting for the application
+	UINT8	tx_depth;		// Replies waiting for the host
+	UINT8	rx_depth_max;
+	UINT8	tx_depth_max;
+	UINT32	rx_full;		// Messages dropped because every slot (or the large buffer) was in use (the host sends them again)
+	UINT32	tx_full;		// Replies refused (LPC_LeaseIOReply, LPC_SetIOMessage) because no reply buffer was free
+	UINT32	expand_errors;		// Compressed messages that did not expand (LPC_MESSAGE_EXPAND_ERROR)
+} LPC_QUEUE_STATS;
+
+/* Copy the message queue statistics to stats, clear resets the maxima and counters after copying them.
+ */
+extern void	LPC_GetQueueStats(LPC_MESSAGES *messages, LPC_QUEUE_STATS *stats, BOOL clear);
+
+/* Serve Firmware Memory cycles (START 1101b read, 1110b write) addressed to idsel
+ * from buffer, which covers [base, base + length) of the 28-bit firmware memory space.
+ *
+ * Multi-byte (MSIZE) reads are served straight from buffer without involving the application,
+ * writes are stored into buffer only if writable is TRUE. Pass a NULL buffer to stop responding.
+ * Firmware Memory cycles are decoded by the default (switch) decoder only.
+ */
+extern void	LPC_SetFirmwareMemory(LPC_CONTEXT *lpc, UINT8 idsel, UINT32 base, UINT8 *buffer, UINT32 length, BOOL writable);
+
+/* Claim LPC DMA cycles on channel (0-7) so the host DMA controller can stream message bytes
+ * (see lpc_io_transmission.c) instead of issuing one I/O cycle per byte. Any other channel disables DMA.
+ * DMA cycles are decoded by the default (switch) decoder only.
+ */
+extern void	LPC_SetDMAChannel(LPC_CONTEXT *lpc, UINT8 channel);
+
+#ifdef LPC_DEFERRED_DECODE
+/* In deferred decode mode the LCLK interrupt only captures samples and answers reads.
+ *
+ * Call LPC_ProcessSamples from the main loop as often as possible,
+ * it decodes the captured samples and dispatches the I/O writes in batches.
+ * Reads are held off with wait syncs until the writes before them have been dispatched.
+ */
+extern void	LPC_ProcessSamples(LPC_CONTEXT *lpc);
+#endif
+
+/* ### Ports ###
+ *
+ * Everything the decoder knows about one LPC bus lives in its LPC_CONTEXT and everything the message protocol knows
+ * in an LPC_MESSAGES, nothing is kept in globals or function statics. One image can serve several ports (each LCLK
+ * pin calls LPC_ISR with its own context) and the host can run independent slaves on as many threads.
+ *
+ * The fields the decoder touches on every LCLK edge come first and fit one LPC_CACHE_LINE (checked in lpc.c), the
+ * decode windows, device table and statistics follow. Contexts are aligned to the cache line so that ports on
+ * different cores never share one. Members are private to lpc.c and lpc_io_dispatch.c, use the functions above.
+ *
+ * LPC_Initialize wires lpc to pins, clears it, and registers messages at address 0 (see LPC_RegisterIODevice).
+ * An LPC_MESSAGES needs no initialization beyond starting out zeroed (static storage or cleared memory).
+ */
+
+#define LPC_CACHE_LINE		(64)
+
+#ifdef __GNUC__
+#define LPC_CACHE_ALIGNED	__attribute__((aligned(LPC_CACHE_LINE)))
+#else
+#define LPC_CACHE_ALIGNED
+#endif
+
+/* ### Pin Map ###
+ *
+ * Bank bit of every LPC signal, fixed at build time for the board (-DLPC_PIN_LAD0=8 ...), bits 0-14 of a bank. Every
+ * port of the image uses the same layout, on a bank of its own (LPC_PINS). The decoder works on the reference layout
+ * of the signals (LAD on bits 3:0, LFRAME 4, LRESET 5, LCLK 6), LPC_GATHER_PINS moves a bank value into it and
+ * LPC_SCATTER_PINS / LPC_SCATTER_LAD back out. The macros are specialised by the preprocessor: when the signals keep
+ * their reference order at some offset (the default layout is offset 0) gathering is a single shift and mask, a
+ * contiguous LAD is scattered with a single shift, any other layout moves one bit at a time with constant shifts.
+ */
+#ifndef LPC_PIN_LAD0
+#define LPC_PIN_LAD0		(0)
+#endif
+#ifndef LPC_PIN_LAD1
+#define LPC_PIN_LAD1		(1)
+#endif
+#ifndef LPC_PIN_LAD2
+#define LPC_PIN_LAD2		(2)
+#endif
+#ifndef LPC_PIN_LAD3
+#define LPC_PIN_LAD3		(3)
+#endif
+#ifndef LPC_PIN_LFRAME
+#define LPC_PIN_LFRAME		(4)
+#endif
+#ifndef LPC_PIN_LRESET
+#define LPC_PIN_LRESET		(5)
+#endif
+#ifndef LPC_PIN_LCLK
+#define LPC_PIN_LCLK		(6)
+#endif
+
+#define LPC_PIN(pin)		((UINT16)(1U << (pin)))
+
+#define LPC_LAD_PINS		(LPC_PIN(LPC_PIN_LAD0) | LPC_PIN(LPC_PIN_LAD1) | LPC_PIN(LPC_PIN_LAD2) | LPC_PIN(LPC_PIN_LAD3))
+#define LPC_LFRAME_PIN		LPC_PIN(LPC_PIN_LFRAME)
+#define LPC_LRESET_PIN		LPC_PIN(LPC_PIN_LRESET)
+#define LPC_LCLK_PIN		LPC_PIN(LPC_PIN_LCLK)
+
+#define LPC_PINS_LAD_CONTIGUOUS	((LPC_PIN_LAD1 == LPC_PIN_LAD0 + 1) && (LPC_PIN_LAD2 == LPC_PIN_LAD0 + 2) && (LPC_PIN_LAD3 == LPC_PIN_LAD0 + 3))
+
+#define LPC_PINS_IN_ORDER	(LPC_PINS_LAD_CONTIGUOUS && (LPC_PIN_LFRAME == LPC_PIN_LAD0 + 4) \
+				&& (LPC_PIN_LRESET == LPC_PIN_LAD0 + 5) && (LPC_PIN_LCLK == LPC_PIN_LAD0 + 6))
+
+/* Bit from of value moved to bit to, the shift counts are masked so the branch not taken stays a valid shift */
+#define LPC_MOVE_BIT(value, from, to)	(((from) >= (to)) ? (((UINT32)(value) >> (((from) - (to)) & 15)) & (1U << (to))) \
+					: (((UINT32)(value) << (((to) - (from)) & 15)) & (1U << (to))))
+
+#if LPC_PINS_IN_ORDER
+
+#define LPC_GATHER_PINS(pins)	((UINT8)(((pins) >> LPC_PIN_LAD0) & 0x7F))
+#define LPC_SCATTER_PINS(signals)	((UINT16)(((signals) & 0x7F) << LPC_PIN_LAD0))
+
+#else
+
+#if LPC_PINS_LAD_CONTIGUOUS
+#define LPC_GATHER_LAD(pins)	(((pins) >> LPC_PIN_LAD0) & 0xF)
+#else
+#define LPC_GATHER_LAD(pins)	(LPC_MOVE_BIT(pins, LPC_PIN_LAD0, 0) | LPC_MOVE_BIT(pins, LPC_PIN_LAD1, 1) \
+				| LPC_MOVE_BIT(pins, LPC_PIN_LAD2, 2) | LPC_MOVE_BIT(pins, LPC_PIN_LAD3, 3))
+#endif
+
+#define LPC_GATHER_PINS(pins)	((UINT8)(LPC_GATHER_LAD(pins) | LPC_MOVE_BIT(pins, LPC_PIN_LFRAME, 4) \
+				| LPC_MOVE_BIT(pins, LPC_PIN_LRESET, 5) | LPC_MOVE_BIT(pins, LPC_PIN_LCLK, 6)))
+#define LPC_SCATTER_PINS(signals)	((UINT16)(LPC_SCATTER_LAD(signals) | LPC_MOVE_BIT(signals, 4, LPC_PIN_LFRAME) \
+				| LPC_MOVE_BIT(signals, 5, LPC_PIN_LRESET) | LPC_MOVE_BIT(signals, 6, LPC_PIN_LCLK)))
+
+#endif
+
+#if LPC_PINS_LAD_CONTIGUOUS
+#define LPC_SCATTER_LAD(lad)	((UINT16)(((lad) & 0xF) << LPC_PIN_LAD0))
+#else
+#define LPC_SCATTER_LAD(lad)	((UINT16)(LPC_MOVE_BIT(lad, 0, LPC_PIN_LAD0) | LPC_MOVE_BIT(lad, 1, LPC_PIN_LAD1) \
+				| LPC_MOVE_BIT(lad, 2, LPC_PIN_LAD2) | LPC_MOVE_BIT(lad, 3, LPC_PIN_LAD3)))
+#endif
+
+/* The GPIO register bank of a port (see gpio.h), the signals are on the pins of the pin map */
+typedef struct {
+	volatile UINT8 *	bank;		// Base of the GPIO register bank, gpio_bank on the ASIC
+} LPC_PINS;
+
+extern void	LPC_Initialize(LPC_CONTEXT *lpc, const LPC_PINS *pins, LPC_MESSAGES *messages);
+
+/* LCLK interrupt of the port, LPC_HandleCycle decodes one falling LCLK edge without checking the interrupt status */
+extern void	LPC_ISR(LPC_CONTEXT *lpc);
+extern void	LPC_HandleCycle(LPC_CONTEXT *lpc);
+
+// I/O device table of a port (see lpc_io_dispatch.c)
+
+#ifndef LPC_IO_DEVICES
+#define LPC_IO_DEVICES		(8)	// Registered devices, at most 255
+#endif
+
+#ifndef LPC_IO_PAGES
+#define LPC_IO_PAGES		(8)	// 256 byte pages mapped for both directions together, at most 255
+#endif
+
+typedef struct {
+	LPC_IO_READ_HANDLER	read;
+	LPC_IO_WRITE_HANDLER	write;
+	void *			context;
+	UINT16			base;		// Handlers are passed the address relative to base
+} LPC_IO_DEVICE;
+
+typedef struct {
+	LPC_IO_DEVICE	devices[LPC_IO_DEVICES + 1];
+	UINT8		device_count;
+	UINT8		page_count;
+	UINT8		directory[2][256];		// Page of each 256 byte range, per direction
+	UINT8		pages[LPC_IO_PAGES + 1][256];	// Device of each address of the page
+} LPC_IO_TABLE;
+
+#define LPC_SAMPLE_RING_LENGTH	(256)	// Deferred decoder, must be a power of two
+
+struct LPC_CONTEXT {
+	// Every LCLK edge, the first cache line
+	
+	GPIO_PORT		gpio;			// LPC_PINS.bank, through the GPIO backend (see gpio_backend.h)
+	
+	UINT8			state;			// LPC_IO_CYCLE_STATE
+	UINT8			lframe;			// LFRAME at the previous edge
+	UINT8			frame_info;		// LPC_FRAME
+	UINT8			cycle_type;		// LPC_CYCTYPE
+	UINT8			direction;		// LPC_DIR
+	UINT8			synchronize_info;	// LPC_SYNC
+	UINT16			address;
+	UINT8			data;
+	UINT8			decode_state;		// Table decoder
+	
+	UINT8			window_enabled;		// One bit per window
+	UINT8			window_candidates;	// Windows the current address can still fall into
+	
+	volatile UINT8		read_pending;		// See LPC_CompleteIORead
+	volatile UINT8		read_completed;
+	volatile UINT8		read_data;
+	
+	UINT8			dma_channel_claimed;	// 0xFF for none
+	UINT8			dma_terminal;
+	UINT8			dma_length;		// Bytes in the current cycle
+	UINT8			dma_count;		// Bytes transferred so far
+	
+	UINT8			fwh_idsel;
+	UINT32			fwh_address;
+	UINT16			fwh_length;		// Bytes in the current cycle (MSIZE)
+	UINT16			fwh_count;		// Nibbles received or bytes sent so far
+	
+	volatile UINT32		sample_head;		// Deferred decoder, advanced by the top half
+	volatile UINT32		sample_tail;		// Advanced by the bottom half once every write before it has been dispatched
+	
+	// Once per cycle or less
+	
+	UINT32			sample_cycle;		// Deferred decoder, index of the CYCTYPE_AND_DIR sample of the current cycle
+	UINT16			window_base[LPC_DECODE_WINDOWS];
+	UINT16			window_mask[LPC_DECODE_WINDOWS];
+	UINT8			window_nibbles[4][16];	// Windows that accept each value of address nibble 0 (bits 15:12) to 3
+	LPC_DECODE_STATS	window_stats;
+	
+	UINT8 *			fwh_memory;
+	UINT8			fwh_memory_idsel;
+	UINT8			fwh_memory_writable;
+	UINT32			fwh_memory_base;
+	UINT32			fwh_memory_length;
+	
+	LPC_MESSAGES *		messages;		// LPC_RegisterIOMessages, the DMA cycles go to its data window
+	LPC_IO_TABLE		io;
+	
+#ifdef LPC_INSTRUMENT
+	LPC_COUNTERS		counters;
+	LPC_COUNTERS		counters_snapshot;	// Latched for the host by a write to LPC_COUNTERS_BASE
+#endif
+	
+#ifdef LPC_DEFERRED_DECODE
+	UINT8			sample_ring[LPC_SAMPLE_RING_LENGTH];
+	UINT32			sample_overruns;
+	
+	UINT8			process_lframe;		// Bottom half decoder (LPC_ProcessSamples)
+	UINT8			process_state;
+	UINT8			process_frame_info;
+	UINT8			process_data;
+	UINT16			process_address;
+#endif
+} LPC_CACHE_ALIGNED;
+
+// Message protocol instance (see lpc_io_transmission.c)
+
+#define LPC_MESSAGE_LENGTH		(256)	// Page length, messages below it fit a queue slot
+#define LPC_MESSAGE_QUEUE_LENGTH	(4)	// Must be a power of two
+#define LPC_MESSAGE_BLOCKS		(8)	// Blocks per page with their own check value (selective retransmission)
+
+typedef struct {
+	UINT16	length;
+	UINT8 *	data;			// buffer, or the large buffer for messages longer than 255 bytes
+	UINT16	capacity;		// Bytes available at data
+	BOOL	compressed;		// length bytes of LZ stream at data, expanded into expand when leased
+	UINT8	buffer[LPC_MESSAGE_LENGTH];
+} LPC_MESSAGE_SLOT;
+
+struct LPC_MESSAGES {
+	LPC_CONTEXT *		port;			// LPC_RegisterIOMessages
+	
+	LPC_MESSAGE_SLOT	rx_queue[LPC_MESSAGE_QUEUE_LENGTH];	// Host to application
+	LPC_MESSAGE_SLOT	tx_queue[LPC_MESSAGE_QUEUE_LENGTH];	// Application to host
+	
+	volatile UINT8		rx_head;		// Slot the host is filling
+	volatile UINT8		rx_tail;		// Oldest message the application has not answered
+	volatile UINT8		tx_head;		// Slot the application fills next
+	volatile UINT8		tx_tail;		// Oldest reply the host has not acknowledged
+	
+	BOOL			rx_filling;		// A LENGTH write claimed rx_queue[rx_head] and it has not been committed yet
+	BOOL			length_pending;		// The host is waiting (long wait sync) on a LENGTH read for the reply
+	
+	LPC_QUEUE_STATS		queue_stats;
+	
+	UINT8			ack;			// MSG_ACK
+	UINT8			checksum;
+	UINT16			stream_index;		// Next data byte of the page for DMA cycles and the FIFO port
+	
+	UINT8			length_high;		// Latched by MSG_ADDR_OF_LENGTH_HIGH writes, used by the next LENGTH write
+	UINT8			page;			// Page of the message the data addresses refer to
+	UINT16			rx_pages;		// Pages of the message being received that passed their integrity check, in order
+	UINT8			nak;			// Blocks of the page being received that have not passed their block check
+	UINT8			block_crc[LPC_MESSAGE_BLOCKS];	// CRC-8 of each block of the page, folded in as its bytes are moved
+	UINT8			block_length[LPC_MESSAGE_BLOCKS];	// Bytes of the block in block_crc, moved in order from its first one
+	UINT8			block_valid;		// Blocks whose first byte was moved since the page was (re)started
+	
+	UINT8 *			large_rx;		// LPC_SetIOLargeBuffers
+	UINT8 *			large_tx;
+	UINT16			large_length;
+	volatile BOOL		large_rx_busy;		// Claimed by the bus side, released by the application
+	volatile BOOL		large_tx_busy;		// The other way around
+	
+	UINT8 *			expand;			// LPC_SetIOExpandBuffer, the oldest message is expanded when first leased
+	UINT16			expand_capacity;
+	UINT16			expand_length;		// Expanded length of the message in expand
+	BOOL			expanded;		// expand holds rx_queue[rx_tail]
+	
+	UINT8			integrity;		// MSG_INTEGRITY
+	UINT32			crc;			// Running CRC of the data bytes, before CRC32_FINAL
+	UINT16			crc_length;		// Data bytes of the page in crc, moved in order from the first one
+	UINT32			crc_expected;		// CRC written by the host so far
+	
+	UINT8			undo_checksum;		// Integrity and stream pointer before the last read, restored if the host aborts it
+	UINT32			undo_crc;
+	UINT16			undo_crc_length;
+	UINT16			undo_stream_index;
+};
+
+#endif
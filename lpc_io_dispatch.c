@@ -0,0 +1,151 @@
+#include "ptypes.h"
+#include "lpc.h"
+#include "debug.h"
+
+/* ### I/O Address Dispatch ###
+ *
+ * Every I/O cycle is dispatched through a two-level page table per direction (LPC_IO_TABLE, one per port): the high
+ * byte of the address selects a page in the directory, the low byte selects the device within the page. Page 0 is
+ * shared by every unmapped range and device 0 is the unclaimed device, so a lookup is two indexed loads and one
+ * indirect call, whatever the number of devices or ranges.
+ *
+ * A range registered over another one replaces it on the addresses they share (sub-ranges), a device registered
+ * with a NULL read or write handler leaves that direction of its range as it was (read or write only devices).
+ */
+
+#define LPC_IO_READ		(0)
+#define LPC_IO_WRITE		(1)
+
+LPC_IO_READ_RESULT LPC_UnclaimedIORead(void *context, UINT16 address, UINT8 *data)
+{
+	return IO_READ_RETRY;
+}
+
+void LPC_UnclaimedIOWrite(void *context, UINT16 address, UINT8 data)
+{
+}
+
+void LPC_ResetIODevices(LPC_CONTEXT *lpc)
+{
+	int i;
+	
+	for(i = 0; i < 256; i++)
+	{
+		lpc->io.directory[LPC_IO_READ][i] = 0;
+		lpc->io.directory[LPC_IO_WRITE][i] = 0;
+		lpc->io.pages[0][i] = 0;
+	}
+	
+	lpc->io.devices[0].read = LPC_UnclaimedIORead;
+	lpc->io.devices[0].write = LPC_UnclaimedIOWrite;
+	lpc->io.devices[0].context = NULL;
+	lpc->io.devices[0].base = 0;
+	
+	lpc->io.device_count = 0;
+	lpc->io.page_count = 0;
+}
+
+// Pages a range needs that are still shared with page 0
+__inline UINT8 LPC_UnmappedIOPages(LPC_CONTEXT *lpc, UINT8 direction, UINT16 base, UINT16 last)
+{
+	UINT8 count = 0;
+	UINT16 page;
+	
+	for(page = (base >> 8); page <= (last >> 8); page++)
+	{
+		if(lpc->io.directory[direction][page] == 0) count += 1;
+	}
+	
+	return count;
+}
+
+__inline void LPC_MapIORange(LPC_CONTEXT *lpc, UINT8 direction, UINT16 base, UINT16 last, UINT8 device)
+{
+	UINT32 address;
+	UINT16 page;
+	int i;
+	
+	for(address = base; address <= last; address++)
+	{
+		page = (UINT16)(address >> 8);
+		
+		if(lpc->io.directory[direction][page] == 0)
+		{
+			lpc->io.page_count += 1;
+			
+			for(i = 0; i < 256; i++)
+			{
+				lpc->io.pages[lpc->io.page_count][i] = 0;
+			}
+			
+			lpc->io.directory[direction][page] = lpc->io.page_count;
+		}
+		
+		lpc->io.pages[lpc->io.directory[direction][page]][address & 0xFF] = device;
+	}
+}
+
+BOOL LPC_RegisterIODevice(LPC_CONTEXT *lpc, UINT16 base, UINT16 length, LPC_IO_READ_HANDLER read, LPC_IO_WRITE_HANDLER write, void *context)
+{
+	LPC_IO_DEVICE *device;
+	UINT16 last = (UINT16)(base + length - 1);
+	UINT8 pages = 0;
+	
+	if(length == 0) return FALSE;
+	if(last < base) return FALSE;
+	if(lpc->io.device_count == LPC_IO_DEVICES) return FALSE;
+	
+	/* Check first so a failed registration leaves the table as it was */
+	if(read != NULL) pages += LPC_UnmappedIOPages(lpc, LPC_IO_READ, base, last);
+	if(write != NULL) pages += LPC_UnmappedIOPages(lpc, LPC_IO_WRITE, base, last);
+	
+	if((lpc->io.page_count + pages) > LPC_IO_PAGES) return FALSE;
+	
+	lpc->io.device_count += 1;
+	
+	device = &lpc->io.devices[lpc->io.device_count];
+	device->read = (read != NULL) ? read : LPC_UnclaimedIORead;
+	device->write = (write != NULL) ? write : LPC_UnclaimedIOWrite;
+	device->context = context;
+	device->base = base;
+	
+	if(read != NULL) LPC_MapIORange(lpc, LPC_IO_READ, base, last, lpc->io.device_count);
+	if(write != NULL) LPC_MapIORange(lpc, LPC_IO_WRITE, base, last, lpc->io.device_count);
+	
+	return TRUE;
+}
+
+LPC_IO_READ_RESULT LPC_HandleIORead(LPC_CONTEXT *lpc, UINT16 address, UINT8 *data)
+{
+	LPC_IO_DEVICE *device = &lpc->io.devices[lpc->io.pages[lpc->io.directory[LPC_IO_READ][address >> 8]][address & 0xFF]];
+	LPC_IO_READ_RESULT result = device->read(device->context, (UINT16)(address - device->base), data);
+	
+	DEBUG_TRACE_CYCLE(DEBUG_EVENT_IO_READ, result, address, *data);
+	
+	return result;
+}
+
+void LPC_HandleIOWrite(LPC_CONTEXT *lpc, UINT16 address, UINT8 data)
+{
+	LPC_IO_DEVICE *device = &lpc->io.devices[lpc->io.pages[lpc->io.directory[LPC_IO_WRITE][address >> 8]][address & 0xFF]];
+	
+	DEBUG_TRACE_CYCLE(DEBUG_EVENT_IO_WRITE, 0, address, data);
+	
+	device->write(device->context, (UINT16)(address - device->base), data);
+}
+
+// The message protocol is the only device whose reads change its state, the others are not told (see Abort and Reset in lpc.c)
+
+extern void LPC_AbortIOMessageRead(LPC_MESSAGES *messages, UINT16 address);
+
+void LPC_HandleIOAbort(LPC_CONTEXT *lpc, UINT16 address)
+{
+	LPC_IO_DEVICE *device = &lpc->io.devices[lpc->io.pages[lpc->io.directory[LPC_IO_READ][address >> 8]][address & 0xFF]];
+	
+	DEBUG_TRACE_CYCLE(DEBUG_EVENT_IO_READ_ABORT, 0, address, 0);
+	
+	if((lpc->messages != NULL) && (device->context == lpc->messages))
+	{
+		LPC_AbortIOMessageRead(lpc->messages, (UINT16)(address - device->base));
+	}
+}
@@ -1,324 +1,1099 @@
-#include "ptypes.h"
-//#include "debug.h"
-
-/* ### I/O Transmission Test Code ###
- *
- * Note: These tests assume that the data sent will be the same as received
- *
- * ### Test #1 - Simple tests that will not challenge checksum extraordinarily
- *
- * Single-Byte >>>
- * 
- * State	Command				Expected Return Value
- *
- * LENGTH	"lpc io_write 0100 01"		N/A
- * DATA		"lpc io_write 0000 69"		N/A
- * CHECKSUM	"lpc io_write 0101 69"		N/A
- * ACK		"lpc io_read 0102"		0xA0
- * 
- * LENGTH	"lpc io_read 0100"		0x01
- * DATA		"lpc io_read 0000"		0x69
- * CHECKSUM	"lpc io_read 0101"		0x69
- * ACK		"lpc io_write 0102 A0"		N/A
- *
- * Multi-Byte >>>
- *
- * LENGTH	"lpc io_write 0100 03"		N/A
- * DATA		"lpc io_write 0000 69"		N/A
- * DATA		"lpc io_write 0001 3C"		N/A
- * DATA		"lpc io_write 0002 5A"		N/A
- * CHECKSUM	"lpc io_write 0101 FF"		N/A
- * ACK		"lpc io_read 0102"		0xA0
- *
- * LENGTH	"lpc io_read 0100"		0x03
- * DATA		"lpc io_read 0002"		0x5A
- * DATA		"lpc io_read 0000"		0x69
- * DATA		"lpc io_read 0001"		0x3C
- * CHECKSUM	"lpc io_read 0101"		0xFF
- * ACK		"lpc io_write 0102 A0"		N/A
- *
- * ### Test #2 - Test checksum by causing the checksum to overflow
- *
- * State	Command				Expected Return Value
- *
- * LENGTH	"lpc io_write 0100 04"		N/A
- * DATA		"lpc io_write 0000 5A"		N/A
- * DATA		"lpc io_write 0001 69"		N/A
- * DATA		"lpc io_write 0002 3C"		N/A
- * DATA		"lpc io_write 0003 D2"		N/A
- * CHECKSUM	"lpc io_write 0101 D1"		N/A
- * ACK		"lpc io_read 0102"		0xA0
- *
- * LENGTH	"lpc io_read 0100"		0x04
- * DATA		"lpc io_read 0002"		0x3C
- * DATA		"lpc io_read 0000"		0x5A
- * DATA		"lpc io_read 0003"		0xD2
- * DATA		"lpc io_read 0001"		0x69
- * CHECKSUM	"lpc io_read 0101"		0xD1
- * ACK		"lpc io_write 0102 A0"		N/A
- *
- * ### Test #3 - Test checksum by giving bad data
- * 
- * State	Command				Expected Return Value
- *
- * LENGTH	"lpc io_write 0100 02"		N/A
- * DATA		"lpc io_write 0001 12"		N/A
- * DATA		"lpc io_write 0000 34"		N/A
- * CHECKSUM	"lpc io_write 0101 70"		N/A			(Give peripheral a bad checksum)
- * ACK		"lpc io_read 0102"		0xAF
- *
- * LENGTH	"lpc io_write 0100 02"		N/A
- * DATA		"lpc io_write 0001 12"		N/A
- * DATA		"lpc io_write 0000 34"		N/A
- * CHECKSUM	"lpc io_write 0101 46"		N/A
- * ACK		"lpc io_read 0102"		0xA0
- *
- * LENGTH	"lpc io_read 0100"		0x02
- * DATA		"lpc io_read 0001"		0x12
- * DATA		"lpc io_read 0000"		0x34
- * CHECKSUM	"lpc io_read 0101"		0x46
- * ACK		"lpc io_write 0102 AF"		N/A			(Claim that the peripheral gave bad data)
- *
- * LENGTH	"lpc io_read 0100"		0x02
- * DATA		"lpc io_read 0001"		0x12
- * DATA		"lpc io_read 0000"		0x34
- * CHECKSUM	"lpc io_read 0101"		0x46
- * ACK		"lpc io_write 0102 A0"		N/A
- *
- */
-
-// Note: All addresses referencing data are in the form of 00xx where xx is [0, 0xFF)
-
-#define MSG_MAX_LENGTH		(256)
-
-#define MSG_ADDR_OF_DATA	(0x0000)
-// ...
-#define MSG_ADDR_OF_LENGTH	(MSG_MAX_LENGTH + 0)
-#define MSG_ADDR_OF_CHECKSUM	(MSG_MAX_LENGTH + 1)
-#define MSG_ADDR_OF_ACK		(MSG_MAX_LENGTH + 2)
-
-typedef enum {
-	ACK_PASS = 0xA0,
-	ACK_FAIL = 0xAF
-} MSG_ACK;
-
-BOOL	usr_has_control = FALSE;
-
-MSG_ACK	msg_ack;
-UINT8	msg_length;
-UINT8	msg_checksum;
-UINT8	msg_data[MSG_MAX_LENGTH];
-
-/* ### Mater Driver Code: Send Msg to Peripheral ###
- *
- * $length = sizeof($msg)
- * lpc(IO_WRITE, MSG_ADDR_OF_LENGTH, $length)
- * while(true)
- * 		for($i = 0; $i < $length; $i++)
- * 			lpc(IO_WRITE, $i, $msg[$i])
- * 		lpc(IO_WRITE, MSG_ADDR_OF_CHECKSUM, checksum($msg))
- * 		$ack = lpc(IO_READ, MSG_ADDR_OF_ACK)
- * 		if($ack)
- * 			break
- *		else
- * 			continue
- */
-
-void LPC_HandleIOWrite(UINT16 address, UINT8 data)
-{
-	UINT16 tmp_checksum;
-	
-	if(usr_has_control) return;
-	
-	switch(address)
-	{
-		// #1
-		case MSG_ADDR_OF_LENGTH: {
-		
-			msg_ack = ACK_FAIL;
-			msg_length = data;
-			msg_checksum = 0;
-			
-			//DEBUG_SaveToBuffer(1);
-		
-		} break;
-		
-		// #3
-		case MSG_ADDR_OF_CHECKSUM: {
-			
-			msg_ack = (msg_checksum == data)
-				? ACK_PASS
-				: ACK_FAIL;
-			
-			//DEBUG_SaveToBuffer(3);
-		
-		} break;
-		
-		// #10
-		case MSG_ADDR_OF_ACK: {
-		
-			msg_ack = (MSG_ACK)data;
-			msg_checksum = 0; // Important: Otherwise checksum will always contain at least one bad byte
-			
-			//DEBUG_SaveToBuffer(10);
-		
-		} break;
-	
-		// #2
-		default: {
-		
-			if(address >= MSG_MAX_LENGTH) return;
-			
-			msg_data[address] = data;
-			
-			tmp_checksum = msg_checksum;
-			tmp_checksum += data;
-			tmp_checksum %= 256;
-			msg_checksum = tmp_checksum;
-			
-			//DEBUG_SaveToBuffer(2);
-		
-		} break;
-	}
-	
-	// ##### ##### >>>>>
-	
-	/* LPC TEST CODE... */
-	
-	//DEBUG_SaveToBuffer(0xAA);
-	//DEBUG_SaveToBuffer((address >> 8) & 0xFF);
-	//DEBUG_SaveToBuffer((address >> 0) & 0xFF);
-	
-	//DEBUG_SaveToBuffer(0xDD);
-	//DEBUG_SaveToBuffer((data >> 0) & 0xFF);
-}
-
-/* ### Master Driver Code: Receive Msg from Peripheral ###
- *
- * $length = lpc(IO_READ, MSG_ADDR_OF_LENGTH)
- * while(true)
- * 		for($i = 0; $i < $length; $i++)
- * 			$msg[$i] = lpc(IO_READ, $i)
- * 		$ack = (lpc(IO_READ, MSG_ADDR_OF_CHECKSUM) == checksum($msg))
- * 		lpc(IO_WRITE, ADDR_OF_ACK, $ack)
- *		if($ack)
- * 			break
- *		else
- * 			continue
- */
-
-BOOL LPC_HandleIORead(UINT16 address, UINT8 *data)
-{
-	UINT16 tmp_checksum;
-	
-	if(usr_has_control) return FALSE;
-	
-	switch(address)
-	{
-		// #7
-		case MSG_ADDR_OF_LENGTH: {
-		
-			msg_ack = ACK_FAIL;
-			(*data) = msg_length;
-			msg_checksum = 0;
-			
-			//DEBUG_SaveToBuffer(7);
-		
-		} break;
-		
-		// #9
-		case MSG_ADDR_OF_CHECKSUM: {
-		
-			(*data) = msg_checksum;
-			
-			//DEBUG_SaveToBuffer(9);
-		
-		} break;
-		
-		// #4
-		case MSG_ADDR_OF_ACK: {
-		
-			(*data) = (UINT8)msg_ack;
-			msg_checksum = 0; // Important: Otherwise checksum will always contain at least one bad byte
-			usr_has_control = (msg_ack == ACK_PASS);
-			
-			//DEBUG_SaveToBuffer(4);
-		
-		} break;
-		
-		// #8
-		default: {
-		
-			if(address >= MSG_MAX_LENGTH) return FALSE;
-			
-			(*data) = msg_data[address];
-			
-			tmp_checksum = msg_checksum;
-			tmp_checksum += msg_data[address];
-			tmp_checksum %= 256;
-			msg_checksum = tmp_checksum;
-			
-			//DEBUG_SaveToBuffer(8);
-		
-		} break;
-	}
-	
-	// ##### ##### >>>>>
-	
-	/* LPC TEST CODE... */
-	
-	//DEBUG_SaveToBuffer(0xAA);
-	//DEBUG_SaveToBuffer((address >> 8) & 0xFF);
-	//DEBUG_SaveToBuffer((address >> 0) & 0xFF);
-	
-	//DEBUG_SaveToBuffer(0xDD);
-	//DEBUG_SaveToBuffer(((*data) >> 0) & 0xFF);
-	
-	return TRUE;
-}
-
-// #5
-BOOL LPC_GetIOMessage(UINT8 *buffer, UINT8 *buffer_length)
-{
-	int i;
-	
-	if(usr_has_control)
-	{
-		//DEBUG_SaveToBuffer(5);
-		
-		for(i = 0; i < msg_length; i++)
-		{
-			buffer[i] = msg_data[i];
-		}
-		
-		(*buffer_length) = msg_length;
-		
-		return TRUE;
-	}
-	
-	return FALSE;
-}
-
-// #6
-BOOL LPC_SetIOMessage(UINT8 *buffer, UINT8 buffer_length)
-{
-	int i;
-	
-	if(usr_has_control)
-	{
-		//DEBUG_SaveToBuffer(6);
-		
-		msg_length = buffer_length;
-		
-		for(i = 0; i < msg_length; i++)
-		{
-			msg_data[i] = buffer[i];
-		}
-		
-		usr_has_control = FALSE;
-		
-		return TRUE;
-	}
-	
-	return FALSE;
-}
+#include "ptypes.h"
+#include "lpc.h"
+#include "crc.h"
+#include "lz.h"
+#include "debug.h"
+#include "interrupt.h"
+
+/* ### I/O Transmission Test Code ###
+ *
+ * Note: These tests assume that the data sent will be the same as received
+ *
+ * ### Test #1 - Simple tests that will not challenge checksum extraordinarily
+ *
+ * Single-Byte >>>
+ * 
+ * State	Command				Expected Return Value
+ *
+ * LENGTH	"lpc io_write 0100 01"		N/A
+ * DATA		"lpc io_write 0000 69"		N/A
+ * CHECKSUM	"lpc io_write 0101 69"		N/A
+ * ACK		"lpc io_read 0102"		0xA0
+ * 
+ * LENGTH	"lpc io_read 0100"		0x01
+ * DATA		"lpc io_read 0000"		0x69
+ * CHECKSUM	"lpc io_read 0101"		0x69
+ * ACK		"lpc io_write 0102 A0"		N/A
+ *
+ * Multi-Byte >>>
+ *
+ * LENGTH	"lpc io_write 0100 03"		N/A
+ * DATA		"lpc io_write 0000 69"		N/A
+ * DATA		"lpc io_write 0001 3C"		N/A
+ * DATA		"lpc io_write 0002 5A"		N/A
+ * CHECKSUM	"lpc io_write 0101 FF"		N/A
+ * ACK		"lpc io_read 0102"		0xA0
+ *
+ * LENGTH	"lpc io_read 0100"		0x03
+ * DATA		"lpc io_read 0002"		0x5A
+ * DATA		"lpc io_read 0000"		0x69
+ * DATA		"lpc io_read 0001"		0x3C
+ * CHECKSUM	"lpc io_read 0101"		0xFF
+ * ACK		"lpc io_write 0102 A0"		N/A
+ *
+ * ### Test #2 - Test checksum by causing the checksum to overflow
+ *
+ * State	Command				Expected Return Value
+ *
+ * LENGTH	"lpc io_write 0100 04"		N/A
+ * DATA		"lpc io_write 0000 5A"		N/A
+ * DATA		"lpc io_write 0001 69"		N/A
+ * DATA		"lpc io_write 0002 3C"		N/A
+ * DATA		"lpc io_write 0003 D2"		N/A
+ * CHECKSUM	"lpc io_write 0101 D1"		N/A
+ * ACK		"lpc io_read 0102"		0xA0
+ *
+ * LENGTH	"lpc io_read 0100"		0x04
+ * DATA		"lpc io_read 0002"		0x3C
+ * DATA		"lpc io_read 0000"		0x5A
+ * DATA		"lpc io_read 0003"		0xD2
+ * DATA		"lpc io_read 0001"		0x69
+ * CHECKSUM	"lpc io_read 0101"		0xD1
+ * ACK		"lpc io_write 0102 A0"		N/A
+ *
+ * ### Test #3 - Test checksum by giving bad data
+ * 
+ * State	Command				Expected Return Value
+ *
+ * LENGTH	"lpc io_write 0100 02"		N/A
+ * DATA		"lpc io_write 0001 12"		N/A
+ * DATA		"lpc io_write 0000 34"		N/A
+ * CHECKSUM	"lpc io_write 0101 70"		N/A			(Give peripheral a bad checksum)
+ * ACK		"lpc io_read 0102"		0xAF
+ *
+ * LENGTH	"lpc io_write 0100 02"		N/A
+ * DATA		"lpc io_write 0001 12"		N/A
+ * DATA		"lpc io_write 0000 34"		N/A
+ * CHECKSUM	"lpc io_write 0101 46"		N/A
+ * ACK		"lpc io_read 0102"		0xA0
+ *
+ * LENGTH	"lpc io_read 0100"		0x02
+ * DATA		"lpc io_read 0001"		0x12
+ * DATA		"lpc io_read 0000"		0x34
+ * CHECKSUM	"lpc io_read 0101"		0x46
+ * ACK		"lpc io_write 0102 AF"		N/A			(Claim that the peripheral gave bad data)
+ *
+ * LENGTH	"lpc io_read 0100"		0x02
+ * DATA		"lpc io_read 0001"		0x12
+ * DATA		"lpc io_read 0000"		0x34
+ * CHECKSUM	"lpc io_read 0101"		0x46
+ * ACK		"lpc io_write 0102 A0"		N/A
+ *
+ */
+
+// Note: All addresses referencing data are in the form of 00xx where xx is [0, 0xFF)
+// Messages longer than 255 bytes are moved in 256 byte pages, MSG_ADDR_OF_PAGE selects the page 00xx refers to
+
+#define MSG_MAX_LENGTH		(LPC_MESSAGE_LENGTH)
+
+#define MSG_ADDR_OF_DATA	(0x0000)
+// ...
+#define MSG_ADDR_OF_LENGTH	(MSG_MAX_LENGTH + 0)
+#define MSG_ADDR_OF_CHECKSUM	(MSG_MAX_LENGTH + 1)
+#define MSG_ADDR_OF_ACK		(MSG_MAX_LENGTH + 2)
+#define MSG_ADDR_OF_INTEGRITY	(MSG_MAX_LENGTH + 3)
+#define MSG_ADDR_OF_CRC		(MSG_MAX_LENGTH + 4)	// 4 byte window, least significant byte first
+#define MSG_ADDR_OF_LENGTH_HIGH	(MSG_MAX_LENGTH + 8)	// Bits 14:8 of the length, and MSG_LENGTH_COMPRESSED when writing
+#define MSG_ADDR_OF_PAGE	(MSG_MAX_LENGTH + 9)
+#define MSG_ADDR_OF_NAK		(MSG_MAX_LENGTH + 10)	// Bitmap of the blocks of the page that failed their check
+#define MSG_ADDR_OF_FIFO	(MSG_MAX_LENGTH + 11)	// Data port, reads and writes the data byte at the stream pointer and advances it
+#define MSG_ADDR_OF_FIFO_POINTER	(MSG_MAX_LENGTH + 12)	// Stream pointer, write 0 to rewind
+#define MSG_ADDR_OF_BLOCK_CHECK	(MSG_MAX_LENGTH + 16)	// 8 byte window, one check value per block
+
+#define MSG_LENGTH_COMPRESSED	(0x80)	// MSG_ADDR_OF_LENGTH_HIGH flag, the message is compressed, see lz.h
+
+#define MSG_BLOCKS		(LPC_MESSAGE_BLOCKS)	// Per page, one bit each in MSG_ADDR_OF_NAK
+#define MSG_BLOCK_LENGTH	(MSG_MAX_LENGTH / MSG_BLOCKS)
+
+#define MSG_ADDR_RANGE		(MSG_ADDR_OF_BLOCK_CHECK + MSG_BLOCKS)	// Addresses the protocol occupies from its base
+
+typedef enum {
+	ACK_PASS = 0xA0,
+	ACK_FAIL = 0xAF
+} MSG_ACK;
+
+/* ### Integrity Modes ###
+ *
+ * INTEGRITY_SUM: 8-bit additive checksum through MSG_ADDR_OF_CHECKSUM (default, the protocol as described above)
+ * INTEGRITY_CRC16: CRC-16-CCITT through the first 2 bytes of the MSG_ADDR_OF_CRC window
+ * INTEGRITY_CRC32: CRC-32 through all 4 bytes of the MSG_ADDR_OF_CRC window
+ *
+ * The host selects the mode by writing it to MSG_ADDR_OF_INTEGRITY. In the CRC modes the CRC written by the host is
+ * checked when its most significant byte is written, so the window has to be written in ascending address order.
+ * The CRC always covers the data bytes of the page as they are in the buffer. While the host moves them in one
+ * ascending pass it is updated per byte as they cross the bus (see crc.h), once a byte is skipped, moved again or
+ * out of order it is computed over the page when it is checked or read (up to 256 table lookups in that cycle).
+ */
+typedef enum {
+	INTEGRITY_SUM = 0,
+	INTEGRITY_CRC16 = 1,
+	INTEGRITY_CRC32 = 2
+} MSG_INTEGRITY;
+
+/* ### Message Queue ###
+ *
+ * Messages from the host (rx) and replies to the host (tx) are kept in rings of MSG_QUEUE_LENGTH slots.
+ * The bus side owns rx_head and tx_tail, the application side owns rx_tail and tx_head,
+ * so the host can send the next message while the application is still working on the previous one.
+ * Indices run freely and are masked when a slot is addressed.
+ *
+ * All of it lives in the instance (LPC_MESSAGES, see lpc.h) the bus side gets as its device context,
+ * and the application passes to the functions below.
+ */
+
+#define MSG_QUEUE_LENGTH	(LPC_MESSAGE_QUEUE_LENGTH)
+#define MSG_QUEUE_MASK		(MSG_QUEUE_LENGTH - 1)
+
+typedef LPC_MESSAGE_SLOT	MSG_SLOT;
+
+#define MSG_RX_DEPTH(msg)		((UINT8)((msg)->rx_head - (msg)->rx_tail))
+#define MSG_TX_DEPTH(msg)		((UINT8)((msg)->tx_head - (msg)->tx_tail))
+
+#define MSG_RX_SLOT(msg)		(&(msg)->rx_queue[(msg)->rx_head & MSG_QUEUE_MASK])
+#define MSG_TX_SLOT(msg)		(&(msg)->tx_queue[(msg)->tx_tail & MSG_QUEUE_MASK])
+
+#define MSG_PAGE_OFFSET(msg)	((UINT16)(msg)->page << 8)
+#define MSG_LAST_PAGE(length)	(((length) == 0) ? 0 : (((length) - 1) >> 8))
+#define MSG_IS_LARGE(slot)	((slot)->data != (slot)->buffer)
+
+#define MSG_CRC_WIDTH(msg)		(((msg)->integrity == INTEGRITY_CRC32) ? 4 : 2)
+#define MSG_CRC_STALE			(0xFFFF)	// crc_length once the data bytes were not moved in order
+
+__inline void MSG_ResetIntegrity(LPC_MESSAGES *msg)
+{
+	msg->checksum = 0;
+	msg->crc = (msg->integrity == INTEGRITY_CRC32) ? CRC32_INIT : CRC16_INIT;
+	msg->crc_length = 0;
+	msg->block_valid = 0;
+}
+
+// Data byte index of the page moved over the bus, the CRCs only fold it in if it is the next one in order
+__inline void MSG_UpdateIntegrity(LPC_MESSAGES *msg, UINT16 index, UINT8 data)
+{
+	UINT8 block = (UINT8)(index / MSG_BLOCK_LENGTH);
+	UINT8 position = (UINT8)(index % MSG_BLOCK_LENGTH);
+	
+	/* A block sent (or read) again starts over with its first byte */
+	if(position == 0)
+	{
+		msg->block_crc[block] = CRC8_INIT;
+		msg->block_length[block] = 0;
+		msg->block_valid |= (1 << block);
+	}
+	
+	if(position == msg->block_length[block])
+	{
+		msg->block_crc[block] = CRC8_UPDATE(msg->block_crc[block], data);
+		msg->block_length[block] += 1;
+	}
+	else
+	{
+		msg->block_valid &= ~(1 << block);
+	}
+	
+	if(msg->integrity == INTEGRITY_SUM)
+	{
+		msg->checksum += data;
+	}
+	else if(index != msg->crc_length)
+	{
+		msg->crc_length = MSG_CRC_STALE;
+	}
+	else
+	{
+		switch(msg->integrity)
+		{
+			case INTEGRITY_CRC16:	msg->crc = CRC16_UPDATE((UINT16)msg->crc, data); break;
+			case INTEGRITY_CRC32:	msg->crc = CRC32_UPDATE(msg->crc, data); break;
+		}
+		
+		msg->crc_length += 1;
+	}
+}
+
+// Bytes of the current page that belong to the message
+__inline UINT16 MSG_PageLength(LPC_MESSAGES *msg, MSG_SLOT *slot)
+{
+	UINT16 offset = MSG_PAGE_OFFSET(msg);
+	
+	if(offset >= slot->length) return 0;
+	
+	return ((slot->length - offset) > MSG_MAX_LENGTH) ? MSG_MAX_LENGTH : (slot->length - offset);
+}
+
+// CRC of the data bytes of the current page, taken from the buffer unless they were moved in one ascending pass
+__inline UINT32 MSG_GetCRC(LPC_MESSAGES *msg, MSG_SLOT *slot)
+{
+	UINT16 length = MSG_PageLength(msg, slot);
+	UINT8 *data = &slot->data[MSG_PAGE_OFFSET(msg)];
+	
+	if(msg->crc_length != length)
+	{
+		/* Kept for the other bytes of the CRC window, the next data byte moved makes it stale again */
+		msg->crc = (msg->integrity == INTEGRITY_CRC32) ? CRC32_FINAL(CRC32_Compute(data, length)) : CRC16_Compute(data, length);
+		msg->crc_length = length;
+	}
+	
+	return (msg->integrity == INTEGRITY_CRC32) ? CRC32_FINAL(msg->crc) : (msg->crc & 0xFFFF);
+}
+
+// One bit for every block of the current page that belongs to the message
+__inline UINT8 MSG_BlockMask(LPC_MESSAGES *msg, MSG_SLOT *slot)
+{
+	UINT16 blocks = (MSG_PageLength(msg, slot) + MSG_BLOCK_LENGTH - 1) / MSG_BLOCK_LENGTH;
+	
+	return (UINT8)((1 << blocks) - 1);
+}
+
+// CRC-8 of one block of the current page, folded in as its bytes were moved, taken from the buffer if they were not moved in order
+__inline UINT8 MSG_BlockCRC(LPC_MESSAGES *msg, MSG_SLOT *slot, UINT8 block)
+{
+	UINT16 length = MSG_PageLength(msg, slot);
+	UINT16 offset = (UINT16)block * MSG_BLOCK_LENGTH;
+	UINT16 bytes = (offset >= length) ? 0 : (((length - offset) > MSG_BLOCK_LENGTH) ? MSG_BLOCK_LENGTH : (length - offset));
+	
+	if(!(msg->block_valid & (1 << block)) || (msg->block_length[block] != bytes))
+	{
+		/* Up to MSG_BLOCK_LENGTH table lookups in this cycle, kept until a byte of the block is moved out of order */
+		msg->block_crc[block] = CRC8_Compute(&slot->data[MSG_PAGE_OFFSET(msg) + offset], bytes);
+		msg->block_length[block] = (UINT8)bytes;
+		msg->block_valid |= (1 << block);
+	}
+	
+	return msg->block_crc[block];
+}
+
+/* ### Mater Driver Code: Send Msg to Peripheral ###
+ *
+ * $length = sizeof($msg)
+ * lpc(IO_WRITE, MSG_ADDR_OF_LENGTH, $length)
+ * while(true)
+ * 		for($i = 0; $i < $length; $i++)
+ * 			lpc(IO_WRITE, $i, $msg[$i])
+ * 		lpc(IO_WRITE, MSG_ADDR_OF_CHECKSUM, checksum($msg))
+ * 		$ack = lpc(IO_READ, MSG_ADDR_OF_ACK)
+ * 		if($ack)
+ * 			break
+ *		else
+ * 			continue
+ *
+ * Note: Up to MSG_QUEUE_LENGTH messages may be sent before their replies are read,
+ * while every slot is in use the ACK read fails and the message has to be sent again.
+ */
+
+/* ### Master Driver Code: Large Messages ###
+ *
+ * Messages of 256 bytes or more are sent one 256 byte page at a time, each page is checked and acknowledged
+ * on its own, so a bad page is sent again instead of the whole message. The message is handed to the application
+ * when the last page is acknowledged. Replies are read back the same way, ACK_PASS on the last page releases them.
+ * Hosts that never write MSG_ADDR_OF_LENGTH_HIGH or MSG_ADDR_OF_PAGE use the protocol above unchanged.
+ *
+ * lpc(IO_WRITE, MSG_ADDR_OF_LENGTH_HIGH, $length >> 8)
+ * lpc(IO_WRITE, MSG_ADDR_OF_LENGTH, $length & 0xFF)
+ * for($page = 0; $page * 256 < $length; $page++)
+ * 		while(true)
+ * 			lpc(IO_WRITE, MSG_ADDR_OF_PAGE, $page)
+ * 			for($i = 0; $i < 256 && $page * 256 + $i < $length; $i++)
+ * 				lpc(IO_WRITE, $i, $msg[$page * 256 + $i])
+ * 			lpc(IO_WRITE, MSG_ADDR_OF_CHECKSUM, checksum($msg, $page))
+ * 			if(lpc(IO_READ, MSG_ADDR_OF_ACK))
+ * 				break
+ *
+ * $length = lpc(IO_READ, MSG_ADDR_OF_LENGTH) | (lpc(IO_READ, MSG_ADDR_OF_LENGTH_HIGH) << 8)
+ * for($page = 0; $page * 256 < $length; $page++)
+ * 		while(true)
+ * 			lpc(IO_WRITE, MSG_ADDR_OF_PAGE, $page)
+ * 			...
+ * 			$ack = (lpc(IO_READ, MSG_ADDR_OF_CHECKSUM) == checksum($msg, $page))
+ * 			lpc(IO_WRITE, ADDR_OF_ACK, $ack)
+ * 			if($ack)
+ * 				break
+ */
+
+/* ### Master Driver Code: Compressed Messages ###
+ *
+ * The host may compress a message with LZ_Compress (see lz.h) and send the compressed bytes instead, flagged by
+ * MSG_LENGTH_COMPRESSED in MSG_ADDR_OF_LENGTH_HIGH. Length, pages and integrity checks all refer to the compressed
+ * bytes, the message is expanded before the application sees it, so messages are limited to 32767 compressed bytes.
+ * The ACK read fails while the application has no expand buffer, the host then sends the message uncompressed.
+ *
+ * $packed = lz_compress($msg)
+ * if(sizeof($packed) < sizeof($msg))
+ * 		lpc(IO_WRITE, MSG_ADDR_OF_LENGTH_HIGH, MSG_LENGTH_COMPRESSED | (sizeof($packed) >> 8))
+ * 		lpc(IO_WRITE, MSG_ADDR_OF_LENGTH, sizeof($packed) & 0xFF)
+ * 		...
+ */
+
+/* ### Master Driver Code: Selective Retransmission ###
+ *
+ * Instead of one checksum for the whole message (or page) the host may send one check value (CRC-8, see crc.h)
+ * per MSG_BLOCK_LENGTH byte block. MSG_ADDR_OF_NAK then lists the blocks that failed, only those are sent again.
+ * The ACK read passes once every block of the message (page) has passed. Like the CRC modes the check values are
+ * updated per byte as it crosses the bus, a block is sent (or read) again from its first byte.
+ *
+ * lpc(IO_WRITE, MSG_ADDR_OF_LENGTH, $length)
+ * for($i = 0; $i < $length; $i++)
+ * 		lpc(IO_WRITE, $i, $msg[$i])
+ * for($b = 0; $b * 32 < $length; $b++)
+ * 		lpc(IO_WRITE, MSG_ADDR_OF_BLOCK_CHECK + $b, crc8($msg, $b))
+ * while($nak = lpc(IO_READ, MSG_ADDR_OF_NAK))
+ * 		foreach($b in $nak)
+ * 			for($i = $b * 32; $i < ($b + 1) * 32 && $i < $length; $i++)
+ * 				lpc(IO_WRITE, $i, $msg[$i])
+ * 			lpc(IO_WRITE, MSG_ADDR_OF_BLOCK_CHECK + $b, crc8($msg, $b))
+ * $ack = lpc(IO_READ, MSG_ADDR_OF_ACK)
+ *
+ * Receiving, reading MSG_ADDR_OF_BLOCK_CHECK + $b returns the check value of block $b of the reply (page),
+ * so the host only reads the bad blocks again.
+ */
+
+void MSG_HandleIOWrite(void *context, UINT16 address, UINT8 data)
+{
+	LPC_MESSAGES *msg = (LPC_MESSAGES *)context;
+	MSG_SLOT *slot = MSG_RX_SLOT(msg);
+	UINT16 length;
+	UINT16 offset;
+	UINT8 index;
+	BOOL compressed;
+	
+	/* The FIFO port stores the data byte at the stream pointer like a DMA transfer does, past the end of the page the
+	 * byte is dropped and the pointer stays, it never reaches the registers above the data window
+	 */
+	if(address == MSG_ADDR_OF_FIFO)
+	{
+		if(!msg->rx_filling) return;
+		if(msg->stream_index >= MSG_PageLength(msg, slot)) return;
+		
+		slot->data[MSG_PAGE_OFFSET(msg) + msg->stream_index] = data;
+		MSG_UpdateIntegrity(msg, msg->stream_index, data);
+		
+		msg->stream_index += 1;
+		
+		return;
+	}
+	
+	switch(address)
+	{
+		// #1
+		case MSG_ADDR_OF_LENGTH: {
+		
+			msg->ack = ACK_FAIL;
+			MSG_ResetIntegrity(msg);
+			msg->stream_index = 0;
+			msg->length_pending = FALSE; // A pending LENGTH read, if any, was aborted by the host
+			
+			/* An unfinished large message is abandoned */
+			if(msg->rx_filling && MSG_IS_LARGE(slot)) msg->large_rx_busy = FALSE;
+			
+			length = ((UINT16)(msg->length_high & ~MSG_LENGTH_COMPRESSED) << 8) | data;
+			compressed = ((msg->length_high & MSG_LENGTH_COMPRESSED) != 0);
+			msg->length_high = 0;
+			msg->page = 0;
+			msg->rx_pages = 0;
+			
+			/* With every slot (or the large buffer) in use the message is dropped and ACK reads fail, the host sends it again */
+			msg->rx_filling = (MSG_RX_DEPTH(msg) < MSG_QUEUE_LENGTH);
+			
+			/* Compressed messages are refused until the application registered an expand buffer */
+			if(compressed && (msg->expand == NULL)) msg->rx_filling = FALSE;
+			
+			if(msg->rx_filling && (length < MSG_MAX_LENGTH))
+			{
+				slot->data = slot->buffer;
+				slot->capacity = MSG_MAX_LENGTH;
+			}
+			else if(msg->rx_filling && (msg->large_rx != NULL) && !msg->large_rx_busy && (length <= msg->large_length))
+			{
+				msg->large_rx_busy = TRUE;
+				
+				slot->data = msg->large_rx;
+				slot->capacity = msg->large_length;
+			}
+			else
+			{
+				msg->rx_filling = FALSE;
+			}
+			
+			/* With the ring full the slot is the oldest message, the application may still be leasing it */
+			if(msg->rx_filling)
+			{
+				slot->length = length;
+				slot->compressed = compressed;
+				msg->nak = MSG_BlockMask(msg, slot);
+			}
+			else
+			{
+				msg->queue_stats.rx_full += 1;
+				msg->nak = 0xFF;
+			}
+			
+			DEBUG_TRACE_MESSAGE(DEBUG_EVENT_MSG_LENGTH, msg->rx_filling, address, length);
+		
+		} break;
+		
+		// #3
+		case MSG_ADDR_OF_CHECKSUM: {
+			
+			msg->ack = ((msg->integrity == INTEGRITY_SUM) && msg->rx_filling && (msg->checksum == data))
+				? ACK_PASS
+				: ACK_FAIL;
+			
+			DEBUG_TRACE_MESSAGE(DEBUG_EVENT_MSG_CHECK, (msg->ack == ACK_PASS), address, data);
+		
+		} break;
+		
+		// #3 (CRC)
+		case MSG_ADDR_OF_CRC + 0:
+		case MSG_ADDR_OF_CRC + 1:
+		case MSG_ADDR_OF_CRC + 2:
+		case MSG_ADDR_OF_CRC + 3: {
+			
+			index = (UINT8)(address - MSG_ADDR_OF_CRC);
+			
+			if(index == 0) msg->crc_expected = 0;
+			msg->crc_expected |= ((UINT32)data << (8 * index));
+			
+			if(index == (MSG_CRC_WIDTH(msg) - 1))
+			{
+				msg->ack = ((msg->integrity != INTEGRITY_SUM) && msg->rx_filling && (msg->crc_expected == MSG_GetCRC(msg, slot)))
+					? ACK_PASS
+					: ACK_FAIL;
+				
+				DEBUG_TRACE_MESSAGE(DEBUG_EVENT_MSG_CHECK, (msg->ack == ACK_PASS), address, msg->crc_expected);
+			}
+		
+		} break;
+		
+		// #3 (block)
+		case MSG_ADDR_OF_BLOCK_CHECK + 0:
+		case MSG_ADDR_OF_BLOCK_CHECK + 1:
+		case MSG_ADDR_OF_BLOCK_CHECK + 2:
+		case MSG_ADDR_OF_BLOCK_CHECK + 3:
+		case MSG_ADDR_OF_BLOCK_CHECK + 4:
+		case MSG_ADDR_OF_BLOCK_CHECK + 5:
+		case MSG_ADDR_OF_BLOCK_CHECK + 6:
+		case MSG_ADDR_OF_BLOCK_CHECK + 7: {
+			
+			if(!msg->rx_filling) return;
+			
+			index = (UINT8)(address - MSG_ADDR_OF_BLOCK_CHECK);
+			
+			if(MSG_BlockCRC(msg, slot, index) == data)
+			{
+				msg->nak &= ~(1 << index);
+			}
+			else
+			{
+				msg->nak |= (1 << index) & MSG_BlockMask(msg, slot);
+			}
+			
+			msg->ack = (msg->nak == 0)
+				? ACK_PASS
+				: ACK_FAIL;
+		
+		} break;
+		
+		case MSG_ADDR_OF_INTEGRITY: {
+			
+			if(data <= INTEGRITY_CRC32) msg->integrity = (MSG_INTEGRITY)data;
+			
+			MSG_ResetIntegrity(msg);
+		
+		} break;
+		
+		case MSG_ADDR_OF_LENGTH_HIGH: {
+			
+			msg->length_high = data;
+		
+		} break;
+		
+		case MSG_ADDR_OF_FIFO_POINTER: {
+			
+			msg->stream_index = data;
+		
+		} break;
+		
+		// #1 (page)
+		case MSG_ADDR_OF_PAGE: {
+			
+			msg->page = data;
+			msg->ack = ACK_FAIL;
+			MSG_ResetIntegrity(msg);
+			msg->stream_index = 0;
+			msg->nak = msg->rx_filling ? MSG_BlockMask(msg, slot) : 0xFF;
+		
+		} break;
+		
+		// #10
+		case MSG_ADDR_OF_ACK: {
+		
+			msg->ack = (MSG_ACK)data;
+			MSG_ResetIntegrity(msg); // Important: Otherwise checksum will always contain at least one bad byte
+			msg->stream_index = 0;
+			
+			if(msg->ack == ACK_PASS) LPC_COUNT(msg->port, replies_passed); else LPC_COUNT(msg->port, replies_failed);
+			
+			/* The host has the (last page of the) reply, free its slot */
+			if((msg->ack == ACK_PASS) && (MSG_TX_DEPTH(msg) != 0) && (msg->page == MSG_LAST_PAGE(MSG_TX_SLOT(msg)->length)))
+			{
+				if(MSG_IS_LARGE(MSG_TX_SLOT(msg))) msg->large_tx_busy = FALSE;
+				
+				msg->tx_tail += 1;
+			}
+			
+			DEBUG_TRACE_MESSAGE(DEBUG_EVENT_REPLY_ACK, msg->page, address, data);
+		
+		} break;
+	
+		// #2
+		default: {
+		
+			if(address >= MSG_MAX_LENGTH) return;
+			if(!msg->rx_filling) return;
+			
+			offset = MSG_PAGE_OFFSET(msg) + address;
+			
+			if(offset >= slot->capacity) return;
+			
+			slot->data[offset] = data;
+			
+			MSG_UpdateIntegrity(msg, address, data);
+		
+		} break;
+	}
+}
+
+/* ### Master Driver Code: Receive Msg from Peripheral ###
+ *
+ * Note: A LENGTH read while no reply is queued is left pending (long wait syncs)
+ * and completed by LPC_SetIOMessage, so the host does not have to poll for the reply.
+ * Replies are returned in the order the messages were sent, the ACK_PASS write releases the oldest one.
+ *
+ * $length = lpc(IO_READ, MSG_ADDR_OF_LENGTH)
+ * while(true)
+ * 		for($i = 0; $i < $length; $i++)
+ * 			$msg[$i] = lpc(IO_READ, $i)
+ * 		$ack = (lpc(IO_READ, MSG_ADDR_OF_CHECKSUM) == checksum($msg))
+ * 		lpc(IO_WRITE, ADDR_OF_ACK, $ack)
+ *		if($ack)
+ * 			break
+ *		else
+ * 			continue
+ */
+
+LPC_IO_READ_RESULT MSG_HandleIORead(void *context, UINT16 address, UINT8 *data)
+{
+	LPC_MESSAGES *msg = (LPC_MESSAGES *)context;
+	MSG_SLOT *slot;
+	UINT16 offset;
+	
+	/* Taken back if the host aborts the read before it got the data, see LPC_AbortIOMessageRead */
+	msg->undo_checksum = msg->checksum;
+	msg->undo_crc = msg->crc;
+	msg->undo_crc_length = msg->crc_length;
+	msg->undo_stream_index = msg->stream_index;
+	
+	/* The FIFO port returns the data byte at the stream pointer, past the end of the page the read is retried and the
+	 * pointer stays, it never reaches the registers above the data window
+	 */
+	if(address == MSG_ADDR_OF_FIFO)
+	{
+		slot = MSG_TX_SLOT(msg);
+		
+		if(MSG_TX_DEPTH(msg) == 0) return IO_READ_RETRY;
+		if(msg->stream_index >= MSG_PageLength(msg, slot)) return IO_READ_RETRY;
+		
+		(*data) = slot->data[MSG_PAGE_OFFSET(msg) + msg->stream_index];
+		MSG_UpdateIntegrity(msg, msg->stream_index, *data);
+		
+		msg->stream_index += 1;
+		
+		return IO_READ_READY;
+	}
+	
+	switch(address)
+	{
+		// #7
+		case MSG_ADDR_OF_LENGTH: {
+		
+			/* No reply queued yet, LPC_SetIOMessage completes the read */
+			if(MSG_TX_DEPTH(msg) == 0)
+			{
+				msg->length_pending = TRUE;
+				
+				return IO_READ_PENDING;
+			}
+			
+			msg->ack = ACK_FAIL;
+			(*data) = (UINT8)MSG_TX_SLOT(msg)->length;
+			MSG_ResetIntegrity(msg);
+			msg->stream_index = 0;
+			msg->page = 0;
+			
+		
+		} break;
+		
+		case MSG_ADDR_OF_LENGTH_HIGH: {
+		
+			if(MSG_TX_DEPTH(msg) == 0) return IO_READ_RETRY;
+			
+			(*data) = (UINT8)(MSG_TX_SLOT(msg)->length >> 8);
+			
+		
+		} break;
+		
+		case MSG_ADDR_OF_PAGE: {
+		
+			(*data) = msg->page;
+			
+		
+		} break;
+		
+		case MSG_ADDR_OF_NAK: {
+		
+			(*data) = msg->nak;
+			
+		
+		} break;
+		
+		case MSG_ADDR_OF_FIFO_POINTER: {
+		
+			(*data) = (UINT8)msg->stream_index;
+			
+		
+		} break;
+		
+		// #9 (block)
+		case MSG_ADDR_OF_BLOCK_CHECK + 0:
+		case MSG_ADDR_OF_BLOCK_CHECK + 1:
+		case MSG_ADDR_OF_BLOCK_CHECK + 2:
+		case MSG_ADDR_OF_BLOCK_CHECK + 3:
+		case MSG_ADDR_OF_BLOCK_CHECK + 4:
+		case MSG_ADDR_OF_BLOCK_CHECK + 5:
+		case MSG_ADDR_OF_BLOCK_CHECK + 6:
+		case MSG_ADDR_OF_BLOCK_CHECK + 7: {
+		
+			if(MSG_TX_DEPTH(msg) == 0) return IO_READ_RETRY;
+			
+			(*data) = MSG_BlockCRC(msg, MSG_TX_SLOT(msg), (UINT8)(address - MSG_ADDR_OF_BLOCK_CHECK));
+			
+		
+		} break;
+		
+		// #9
+		case MSG_ADDR_OF_CHECKSUM: {
+		
+			(*data) = msg->checksum;
+			
+		
+		} break;
+		
+		// #9 (CRC)
+		case MSG_ADDR_OF_CRC + 0:
+		case MSG_ADDR_OF_CRC + 1:
+		case MSG_ADDR_OF_CRC + 2:
+		case MSG_ADDR_OF_CRC + 3: {
+		
+			if(MSG_TX_DEPTH(msg) == 0) return IO_READ_RETRY;
+			
+			(*data) = (UINT8)(MSG_GetCRC(msg, MSG_TX_SLOT(msg)) >> (8 * (address - MSG_ADDR_OF_CRC)));
+			
+		
+		} break;
+		
+		case MSG_ADDR_OF_INTEGRITY: {
+		
+			(*data) = (UINT8)msg->integrity;
+			
+		
+		} break;
+		
+		// #4
+		case MSG_ADDR_OF_ACK: {
+		
+			(*data) = (UINT8)msg->ack;
+			MSG_ResetIntegrity(msg); // Important: Otherwise checksum will always contain at least one bad byte
+			msg->stream_index = 0;
+			
+			if(msg->ack != ACK_PASS) LPC_COUNT(msg->port, acks_failed);
+			
+			DEBUG_TRACE_MESSAGE(DEBUG_EVENT_MSG_ACK, msg->page, address, msg->ack);
+			
+			if((msg->ack == ACK_PASS) && msg->rx_filling)
+			{
+				/* Pages are accepted in order, acknowledging one again does not count */
+				if(msg->page == msg->rx_pages)
+				{
+					msg->rx_pages += 1;
+					
+					LPC_COUNT(msg->port, acks_passed);
+				}
+				
+				/* Hand the message to the application after its last page, once (the host may read ACK again) */
+				if(msg->rx_pages > MSG_LAST_PAGE(MSG_RX_SLOT(msg)->length))
+				{
+					DEBUG_TRACE_MESSAGE(DEBUG_EVENT_MSG_COMMIT, MSG_RX_DEPTH(msg) + 1, address, MSG_RX_SLOT(msg)->length);
+					
+					msg->rx_filling = FALSE;
+					msg->rx_head += 1;
+					
+					if(MSG_RX_DEPTH(msg) > msg->queue_stats.rx_depth_max) msg->queue_stats.rx_depth_max = MSG_RX_DEPTH(msg);
+				}
+			}
+			
+		
+		} break;
+		
+		// #8
+		default: {
+		
+			if(address >= MSG_MAX_LENGTH) return IO_READ_RETRY;
+			if(MSG_TX_DEPTH(msg) == 0) return IO_READ_RETRY;
+			
+			slot = MSG_TX_SLOT(msg);
+			offset = MSG_PAGE_OFFSET(msg) + address;
+			
+			if(offset >= slot->capacity) return IO_READ_RETRY;
+			
+			(*data) = slot->data[offset];
+			
+			MSG_UpdateIntegrity(msg, address, *data);
+			
+		
+		} break;
+	}
+	
+	return IO_READ_READY;
+}
+
+/* ### Master Driver Code: FIFO Port ###
+ *
+ * The data bytes (#2 and #8) may also be moved through the single address MSG_ADDR_OF_FIFO, which auto-increments,
+ * so the host can use string instructions (rep outsb / rep insb). Every LENGTH, PAGE or ACK access rewinds it to the first
+ * data byte, MSG_ADDR_OF_FIFO_POINTER moves it explicitly. The pointer stops at the end of the page: further writes are
+ * dropped and further reads retried (the host aborts them). The data window keeps working, the handshake is unchanged:
+ *
+ * lpc(IO_WRITE, MSG_ADDR_OF_LENGTH, $length)
+ * while(true)
+ * 		outsb(MSG_ADDR_OF_FIFO, $msg, $length)
+ * 		lpc(IO_WRITE, MSG_ADDR_OF_CHECKSUM, checksum($msg))
+ * 		if(lpc(IO_READ, MSG_ADDR_OF_ACK))
+ * 			break
+ *
+ * $length = lpc(IO_READ, MSG_ADDR_OF_LENGTH)
+ * insb(MSG_ADDR_OF_FIFO, $msg, $length)
+ * ...
+ */
+
+/* ### Master Driver Code: DMA ###
+ *
+ * The data bytes (#2 and #8) may also be moved by the host DMA controller on the claimed channel (see LPC_SetDMAChannel),
+ * the LENGTH, CHECKSUM and ACK handshake stays on I/O cycles:
+ *
+ * lpc(IO_WRITE, MSG_ADDR_OF_LENGTH, $length)
+ * dma(MEMORY_TO_DEVICE, $msg, $length)
+ * lpc(IO_WRITE, MSG_ADDR_OF_CHECKSUM, checksum($msg))
+ * ...
+ *
+ * Reading or writing MSG_ADDR_OF_LENGTH rewinds the DMA position to the first data byte,
+ * writing MSG_ADDR_OF_PAGE to the first data byte of the page (one DMA transfer per page).
+ */
+
+// #2 (DMA)
+BOOL LPC_HandleDMARead(LPC_MESSAGES *msg, UINT8 channel, UINT8 data, BOOL terminal)
+{
+	MSG_SLOT *slot = MSG_RX_SLOT(msg);
+	
+	if(!msg->rx_filling) return FALSE;
+	if(msg->stream_index >= MSG_PageLength(msg, slot)) return FALSE;
+	
+	slot->data[MSG_PAGE_OFFSET(msg) + msg->stream_index] = data;
+	MSG_UpdateIntegrity(msg, msg->stream_index, data);
+	
+	msg->stream_index += 1;
+	
+	/* Ask for more data until the page is complete or the host signals the terminal count */
+	return (msg->stream_index < MSG_PageLength(msg, slot)) && !terminal;
+}
+
+// #8 (DMA)
+BOOL LPC_HandleDMAWrite(LPC_MESSAGES *msg, UINT8 channel, UINT8 *data, BOOL terminal, BOOL *more)
+{
+	MSG_SLOT *slot = MSG_TX_SLOT(msg);
+	
+	if(MSG_TX_DEPTH(msg) == 0) return FALSE;
+	if(msg->stream_index >= MSG_PageLength(msg, slot)) return FALSE;
+	
+	(*data) = slot->data[MSG_PAGE_OFFSET(msg) + msg->stream_index];
+	MSG_UpdateIntegrity(msg, msg->stream_index, *data);
+	
+	msg->stream_index += 1;
+	
+	(*more) = (msg->stream_index < MSG_PageLength(msg, slot)) && !terminal;
+	
+	return TRUE;
+}
+
+/* ### Aborts and Resets ###
+ *
+ * The host aborted the last read after the handler above answered it: the data byte it read is taken out of the
+ * checksum (or CRC) and the FIFO port is moved back, so the host reads the byte again and the check still matches.
+ * A LENGTH read that was left pending is over, the reply no longer completes it. Reading ACK or LENGTH again is
+ * harmless, those are not taken back (a message acknowledged by an aborted ACK read stays committed).
+ */
+void LPC_AbortIOMessageRead(LPC_MESSAGES *msg, UINT16 address)
+{
+	msg->checksum = msg->undo_checksum;
+	msg->crc = msg->undo_crc;
+	msg->crc_length = msg->undo_crc_length;
+	msg->stream_index = msg->undo_stream_index;
+	
+	/* The block CRC of the byte cannot be taken back, it is computed from the buffer when it is read */
+	if(address < MSG_MAX_LENGTH) msg->block_valid &= ~(1 << (address / MSG_BLOCK_LENGTH));
+	if(address == MSG_ADDR_OF_FIFO) msg->block_valid &= ~(1 << (msg->stream_index / MSG_BLOCK_LENGTH));
+	
+	if(address == MSG_ADDR_OF_LENGTH) msg->length_pending = FALSE;
+}
+
+/* LRESET: the host lost every exchange in progress. The message being received is abandoned, the replies the host
+ * has not acknowledged are dropped and the integrity mode returns to INTEGRITY_SUM. Messages that were already
+ * committed stay queued for the application, it owns that end of the queue.
+ */
+void LPC_ResetIOMessages(LPC_MESSAGES *msg)
+{
+	if(msg->rx_filling && MSG_IS_LARGE(MSG_RX_SLOT(msg))) msg->large_rx_busy = FALSE;
+	
+	msg->rx_filling = FALSE;
+	msg->length_pending = FALSE;
+	
+	while(MSG_TX_DEPTH(msg) != 0)
+	{
+		if(MSG_IS_LARGE(MSG_TX_SLOT(msg))) msg->large_tx_busy = FALSE;
+		
+		msg->tx_tail += 1;
+	}
+	
+	msg->ack = ACK_FAIL;
+	msg->integrity = INTEGRITY_SUM;
+	MSG_ResetIntegrity(msg);
+	msg->crc_expected = 0;
+	msg->stream_index = 0;
+	msg->length_high = 0;
+	msg->page = 0;
+	msg->rx_pages = 0;
+	msg->nak = 0xFF;
+}
+
+BOOL LPC_RegisterIOMessages(LPC_CONTEXT *lpc, LPC_MESSAGES *msg, UINT16 base)
+{
+	if(!LPC_RegisterIODevice(lpc, base, MSG_ADDR_RANGE, MSG_HandleIORead, MSG_HandleIOWrite, msg)) return FALSE;
+	
+	/* Completes pending LENGTH reads and counts on the port, the port's DMA cycles move the data bytes */
+	msg->port = lpc;
+	lpc->messages = msg;
+	
+	return TRUE;
+}
+
+void LPC_SetIOLargeBuffers(LPC_MESSAGES *msg, UINT8 *receive, UINT8 *transmit, UINT16 length)
+{
+	msg->large_rx = receive;
+	msg->large_tx = transmit;
+	msg->large_length = length;
+}
+
+void LPC_SetIOExpandBuffer(LPC_MESSAGES *msg, UINT8 *buffer, UINT16 length)
+{
+	msg->expand = buffer;
+	msg->expand_capacity = (length == LPC_MESSAGE_EXPAND_ERROR) ? (length - 1) : length;
+	msg->expanded = FALSE;
+}
+
+// #5
+UINT8 *LPC_LeaseIOMessage(LPC_MESSAGES *msg, UINT16 *message_length)
+{
+	MSG_SLOT *slot;
+	UINT32 length;
+	
+	(*message_length) = 0;
+	
+	if(MSG_RX_DEPTH(msg) == 0) return NULL;
+	
+	slot = &msg->rx_queue[msg->rx_tail & MSG_QUEUE_MASK];
+	
+	if(slot->compressed)
+	{
+		if(!msg->expanded)
+		{
+			length = LZ_Expand(slot->data, slot->length, msg->expand, msg->expand_capacity);
+			
+			/* The stream passed the integrity check, so it was compressed wrongly (or expands beyond msg->expand) */
+			if(length == LZ_ERROR)
+			{
+				msg->queue_stats.expand_errors += 1;
+				
+				length = LPC_MESSAGE_EXPAND_ERROR;
+			}
+			
+			msg->expand_length = (UINT16)length;
+			msg->expanded = TRUE;
+		}
+		
+		(*message_length) = msg->expand_length;
+		
+		return (msg->expand_length == LPC_MESSAGE_EXPAND_ERROR) ? NULL : msg->expand;
+	}
+	
+	(*message_length) = slot->length;
+	
+	return slot->data;
+}
+
+// #6
+UINT8 *LPC_LeaseIOReply(LPC_MESSAGES *msg, UINT16 reply_length)
+{
+	MSG_SLOT *slot;
+	
+	if(MSG_RX_DEPTH(msg) == 0) return NULL;
+	
+	if(MSG_TX_DEPTH(msg) == MSG_QUEUE_LENGTH)
+	{
+		msg->queue_stats.tx_full += 1;
+		
+		return NULL;
+	}
+	
+	slot = &msg->tx_queue[msg->tx_head & MSG_QUEUE_MASK];
+	
+	if(reply_length < MSG_MAX_LENGTH)
+	{
+		slot->data = slot->buffer;
+		slot->capacity = MSG_MAX_LENGTH;
+	}
+	else if((msg->large_tx != NULL) && !msg->large_tx_busy && (reply_length <= msg->large_length))
+	{
+		slot->data = msg->large_tx;
+		slot->capacity = msg->large_length;
+	}
+	else
+	{
+		msg->queue_stats.tx_full += 1;
+		
+		return NULL;
+	}
+	
+	return slot->data;
+}
+
+// #6
+BOOL LPC_CommitIOReply(LPC_MESSAGES *msg, UINT16 reply_length)
+{
+	MSG_SLOT *message;
+	MSG_SLOT *slot;
+	INTERRUPT_MASK interrupt_states;
+	
+	if(MSG_RX_DEPTH(msg) == 0) return FALSE;
+	if(MSG_TX_DEPTH(msg) == MSG_QUEUE_LENGTH) return FALSE;
+	
+	message = &msg->rx_queue[msg->rx_tail & MSG_QUEUE_MASK];
+	slot = &msg->tx_queue[msg->tx_head & MSG_QUEUE_MASK];
+	
+	if(reply_length > slot->capacity) return FALSE;
+	
+	slot->length = reply_length;
+	
+	/* The rest is shared with the LCLK interrupt, an ABORT or LRESET (LPC_ResetIOMessages) must not land between
+	 * publishing the reply and completing a pending LENGTH read
+	 */
+	interrupt_states = GetInterruptRegister();
+	DisableInterruptRegister(INTR_GPIO);
+	
+	if(MSG_IS_LARGE(slot)) msg->large_tx_busy = TRUE;
+	if(MSG_IS_LARGE(message)) msg->large_rx_busy = FALSE;
+	
+	msg->expanded = FALSE;
+	
+	/* Publish the reply before releasing the message, the bus side only reads msg->tx_head */
+	msg->tx_head += 1;
+	msg->rx_tail += 1;
+	
+	if(MSG_TX_DEPTH(msg) > msg->queue_stats.tx_depth_max) msg->queue_stats.tx_depth_max = MSG_TX_DEPTH(msg);
+	
+	if(msg->length_pending)
+	{
+		msg->length_pending = FALSE;
+		
+		// #7 (pending)
+		msg->ack = ACK_FAIL;
+		MSG_ResetIntegrity(msg);
+		msg->stream_index = 0;
+		msg->page = 0;
+		
+		LPC_CompleteIORead(msg->port, (UINT8)MSG_TX_SLOT(msg)->length);
+	}
+	
+	EnableInterruptRegister(interrupt_states);
+	
+	return TRUE;
+}
+
+BOOL LPC_GetIOMessage(LPC_MESSAGES *msg, UINT8 *buffer, UINT8 *buffer_length)
+{
+	int i;
+	UINT16 length;
+	UINT8 *message = LPC_LeaseIOMessage(msg, &length);
+	
+	if(message == NULL) return FALSE;
+	if(length >= MSG_MAX_LENGTH) return FALSE; // Large messages are only available through LPC_LeaseIOMessage
+	
+	for(i = 0; i < length; i++)
+	{
+		buffer[i] = message[i];
+	}
+	
+	(*buffer_length) = (UINT8)length;
+	
+	return TRUE;
+}
+
+BOOL LPC_SetIOMessage(LPC_MESSAGES *msg, UINT8 *buffer, UINT8 buffer_length)
+{
+	int i;
+	UINT8 *reply = LPC_LeaseIOReply(msg, buffer_length);
+	
+	if(reply == NULL) return FALSE;
+	
+	for(i = 0; i < buffer_length; i++)
+	{
+		reply[i] = buffer[i];
+	}
+	
+	return LPC_CommitIOReply(msg, buffer_length);
+}
+
+void LPC_GetQueueStats(LPC_MESSAGES *msg, LPC_QUEUE_STATS *stats, BOOL clear)
+{
+	(*stats) = msg->queue_stats;
+	
+	stats->rx_depth = MSG_RX_DEPTH(msg);
+	stats->tx_depth = MSG_TX_DEPTH(msg);
+	
+	if(clear)
+	{
+		msg->queue_stats.rx_depth_max = 0;
+		msg->queue_stats.tx_depth_max = 0;
+		msg->queue_stats.rx_full = 0;
+		msg->queue_stats.tx_full = 0;
+		msg->queue_stats.expand_errors = 0;
+	}
+}
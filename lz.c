@@ -0,0 +1,120 @@
+#include "lz.h"
+
+UINT32 LZ_Compress(const UINT8 *input, UINT32 input_length, UINT8 *output, UINT32 output_capacity)
+{
+	UINT32 in = 0;
+	UINT32 out = 0;
+	UINT32 literal = 0;		// Start of the pending literal run
+	UINT32 candidate;
+	UINT32 length;
+	UINT32 best_length;
+	UINT32 best_offset;
+	UINT32 i;
+	
+	while(in <= input_length)
+	{
+		best_length = 0;
+		best_offset = 0;
+		
+		/* Longest match in the window, the most recent one wins a tie */
+		candidate = (in > LZ_SEARCH_WINDOW) ? (in - LZ_SEARCH_WINDOW) : 0;
+		
+		for(; (in < input_length) && (candidate < in); candidate++)
+		{
+			for(length = 0; (length < LZ_MATCH_MAX) && ((in + length) < input_length); length++)
+			{
+				if(input[candidate + length] != input[in + length]) break;
+			}
+			
+			if(length >= best_length)
+			{
+				best_length = length;
+				best_offset = in - candidate;
+			}
+		}
+		
+		/* Flush the literal run before a match, when it is full and at the end of the input */
+		if((best_length >= LZ_MATCH_MIN) || ((in - literal) == LZ_LITERAL_MAX) || ((in == input_length) && (in > literal)))
+		{
+			while(literal < in)
+			{
+				length = ((in - literal) > LZ_LITERAL_MAX) ? LZ_LITERAL_MAX : (in - literal);
+				
+				if((out + 1 + length) > output_capacity) return LZ_ERROR;
+				
+				output[out++] = (UINT8)(length - 1);
+				
+				for(i = 0; i < length; i++)
+				{
+					output[out++] = input[literal++];
+				}
+			}
+		}
+		
+		if(in == input_length) break;
+		
+		if(best_length >= LZ_MATCH_MIN)
+		{
+			if((out + 3) > output_capacity) return LZ_ERROR;
+			
+			output[out++] = (UINT8)(0x80 | (best_length - LZ_MATCH_MIN));
+			output[out++] = (UINT8)(best_offset >> 0);
+			output[out++] = (UINT8)(best_offset >> 8);
+			
+			in += best_length;
+			literal = in;
+		}
+		else
+		{
+			in += 1;
+		}
+	}
+	
+	return out;
+}
+
+UINT32 LZ_Expand(const UINT8 *input, UINT32 input_length, UINT8 *output, UINT32 output_capacity)
+{
+	UINT32 in = 0;
+	UINT32 out = 0;
+	UINT32 length;
+	UINT32 offset;
+	UINT8 control;
+	
+	while(in < input_length)
+	{
+		control = input[in++];
+		
+		if(control < 0x80)
+		{
+			length = (UINT32)control + 1;
+			
+			if(((in + length) > input_length) || ((out + length) > output_capacity)) return LZ_ERROR;
+			
+			while(length--)
+			{
+				output[out++] = input[in++];
+			}
+		}
+		else
+		{
+			length = (UINT32)(control & 0x7F) + LZ_MATCH_MIN;
+			
+			if((in + 2) > input_length) return LZ_ERROR;
+			
+			offset = (UINT32)input[in] | ((UINT32)input[in + 1] << 8);
+			in += 2;
+			
+			if((offset == 0) || (offset > out) || ((out + length) > output_capacity)) return LZ_ERROR;
+			
+			/* Byte by byte, the copy may overlap the bytes it produces */
+			while(length--)
+			{
+				output[out] = output[out - offset];
+				out++;
+			}
+		}
+	}
+	
+	return out;
+}
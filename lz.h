@@ -0,0 +1,24 @@
+#ifndef _LZ_H_
+#define _LZ_H_
+
+#include "ptypes.h"
+
+// Byte oriented LZ77 codec for message payloads, the expander needs no memory besides its output buffer.
+// The compressed stream is a sequence of tokens, each starting with a control byte c:
+// c < 0x80: c + 1 literal bytes follow,
+// c >= 0x80: copy (c & 0x7F) + 3 bytes from the offset (1-65535, least significant byte first) in the next 2 bytes
+//            back in the output, a copy may overlap itself, so offset 1 is a run of the previous byte.
+
+#define LZ_LITERAL_MAX		(128)
+#define LZ_MATCH_MIN		(3)
+#define LZ_MATCH_MAX		(LZ_MATCH_MIN + 0x7F)
+#define LZ_SEARCH_WINDOW	(1024)		// How far back LZ_Compress looks for matches
+
+#define LZ_ERROR		(0xFFFFFFFF)
+
+// Both return the number of bytes written to output, or LZ_ERROR if output is too small (or input is malformed).
+
+extern UINT32	LZ_Compress(const UINT8 *input, UINT32 input_length, UINT8 *output, UINT32 output_capacity);
+extern UINT32	LZ_Expand(const UINT8 *input, UINT32 input_length, UINT8 *output, UINT32 output_capacity);
+
+#endif